@@ -0,0 +1,94 @@
+#include "autofocus.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+#include <opencv2/imgproc.hpp>
+
+namespace tpxai {
+
+FocusMeter::FocusMeter(int max_roi_width, double roi_fraction)
+    : max_roi_width_{max_roi_width}, roi_fraction_{roi_fraction} {}
+
+double FocusMeter::Measure(const cv::Mat& frame) {
+  const cv::Size roi_size(static_cast<int>(frame.cols * roi_fraction_), static_cast<int>(frame.rows * roi_fraction_));
+  const cv::Rect roi((frame.cols - roi_size.width) / 2, (frame.rows - roi_size.height) / 2, roi_size.width,
+                     roi_size.height);
+
+  // downscale before the color conversion so that every following step touches only the small image
+  const double scale = std::min(1.0, static_cast<double>(max_roi_width_) / roi.width);
+  cv::resize(frame(roi), small_, cv::Size(), scale, scale, cv::INTER_AREA);
+  if (small_.channels() == 1) {
+    gray_ = small_;
+  } else {
+    cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+  }
+  cv::Laplacian(gray_, laplacian_, CV_16S);
+
+  cv::Scalar mean, stddev;
+  cv::meanStdDev(laplacian_, mean, stddev);
+  return stddev[0] * stddev[0];
+}
+
+Autofocus::Autofocus(dahua::DahuaPTZCamera& camera, FrameSource next_frame, AutofocusSettings settings)
+    : Autofocus(
+          [&camera, speed = settings.focus_speed](Direction direction, std::chrono::milliseconds pulse) {
+            if (direction == Direction::near) {
+              camera.SetFocusNear(speed, pulse);
+            } else {
+              camera.SetFocusFar(speed, pulse);
+            }
+          },
+          std::move(next_frame), settings) {}
+
+Autofocus::Autofocus(FocusMotor focus_motor, FrameSource next_frame, AutofocusSettings settings)
+    : focus_motor_{std::move(focus_motor)}, next_frame_{std::move(next_frame)}, settings_{settings} {}
+
+void Autofocus::Step(Direction direction, std::chrono::milliseconds pulse) { focus_motor_(direction, pulse); }
+
+double Autofocus::Measure() {
+  for (int i = 0; i < settings_.settle_frames; i++) {
+    next_frame_();
+  }
+  double sum = 0;
+  for (int i = 0; i < settings_.averaged_frames; i++) {
+    sum += meter_.Measure(next_frame_());
+  }
+  return sum / std::max(settings_.averaged_frames, 1);
+}
+
+AutofocusResult Autofocus::Run() {
+  const auto start = std::chrono::steady_clock::now();
+  AutofocusResult result;
+
+  double best_metric = result.initial_metric = Measure();
+  auto direction = Direction::far;
+  auto pulse = settings_.initial_pulse;
+
+  while (pulse >= settings_.min_pulse and result.iterations < settings_.max_iterations) {
+    Step(direction, pulse);
+    const auto metric = Measure();
+    result.iterations++;
+    VLOG(1) << "Autofocus iteration " << result.iterations << ": pulse " << pulse.count() << " ms, metric " << metric;
+
+    if (metric > best_metric * (1 + settings_.min_improvement)) {
+      best_metric = metric;
+      continue;
+    }
+    // passed the peak (or started in the wrong direction), return to the best known position and refine
+    direction = direction == Direction::near ? Direction::far : Direction::near;
+    Step(direction, pulse);
+    pulse /= 2;
+  }
+
+  result.converged = pulse < settings_.min_pulse;
+  result.final_metric = best_metric;
+  result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+  LOG(INFO) << "Autofocus " << (result.converged ? "converged" : "stopped") << " after " << result.iterations
+            << " iterations in " << result.duration.count() << " ms, metric " << result.initial_metric << " -> "
+            << result.final_metric;
+  return result;
+}
+
+} // namespace tpxai
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+#include "dahua_ptz_camera.h"
+
+namespace tpxai {
+
+// Sharpness of the central part of the frame computed as the variance of the Laplacian of its downscaled grayscale
+// copy. Intermediate buffers are reused between calls so that it can run on every frame.
+class FocusMeter {
+public:
+  explicit FocusMeter(int max_roi_width = 320, double roi_fraction = 0.5);
+
+  double Measure(const cv::Mat& frame);
+
+private:
+  int max_roi_width_;
+  double roi_fraction_;
+  cv::Mat small_;
+  cv::Mat gray_;
+  cv::Mat laplacian_;
+};
+
+struct AutofocusSettings {
+  std::uint16_t focus_speed = 1;
+  std::chrono::milliseconds initial_pulse{400};
+  std::chrono::milliseconds min_pulse{25};
+  int settle_frames = 3;     // frames skipped after each focus pulse, still buffered by the decoder
+  int averaged_frames = 2;   // frames averaged to reduce the metric noise
+  int max_iterations = 40;
+  double min_improvement = 0.02;
+};
+
+struct AutofocusResult {
+  bool converged = false;
+  int iterations = 0;
+  std::chrono::milliseconds duration{0};
+  double initial_metric = 0;
+  double final_metric = 0;
+};
+
+// Coarse-to-fine hill climb over the focus motor: pulses the focus in one direction while the sharpness grows, on
+// overshoot steps back, reverses and halves the pulse, and stops when the pulse gets shorter than the minimal one.
+class Autofocus {
+public:
+  enum class Direction { near, far };
+
+  using FrameSource = std::function<cv::Mat()>;
+  // runs the focus motor in the given direction for the pulse duration
+  using FocusMotor = std::function<void(Direction direction, std::chrono::milliseconds pulse)>;
+
+  // drives the focus of the camera at the focus speed of the settings
+  Autofocus(dahua::DahuaPTZCamera& camera, FrameSource next_frame, AutofocusSettings settings = {});
+  Autofocus(FocusMotor focus_motor, FrameSource next_frame, AutofocusSettings settings = {});
+
+  // Throws what the frame source or the focus motor throw, e.g. when the camera rejects a focus command.
+  AutofocusResult Run();
+
+private:
+  void Step(Direction direction, std::chrono::milliseconds pulse);
+  double Measure();
+
+  FocusMotor focus_motor_;
+  FrameSource next_frame_;
+  AutofocusSettings settings_;
+  FocusMeter meter_;
+};
+
+} // namespace tpxai
@@ -0,0 +1,195 @@
+#include "bearing_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tpxai {
+
+namespace {
+
+using geometry::DegreesToRadians;
+using geometry::RadiansToDegrees;
+
+double NormalizePan(double pan) {
+  pan = std::fmod(pan, 360.0);
+  return pan < 0 ? pan + 360 : pan;
+}
+
+double AngleFromCosine(double cosine) {
+  return RadiansToDegrees(std::acos(std::clamp(cosine, -1.0, 1.0)));
+}
+
+} // anonymous namespace
+
+BearingIndex::BearingIndex(double cell_size_degrees) {
+  if (not(cell_size_degrees > 0 and cell_size_degrees <= 90)) {
+    throw std::invalid_argument("bearing index cell size out of (0, 90] degrees");
+  }
+  const auto row_count = static_cast<std::size_t>(std::ceil(180 / cell_size_degrees));
+  row_height_ = 180.0 / static_cast<double>(row_count);
+  rows_.reserve(row_count);
+  std::size_t cell_count = 0;
+  for (std::size_t row = 0; row < row_count; ++row) {
+    // the widest circle of the row, the one closest to the equator, sets the cell count
+    const double low = -90 + static_cast<double>(row) * row_height_;
+    const double widest = std::min(std::abs(low), std::abs(low + row_height_));
+    const double widest_latitude = low < 0 and low + row_height_ > 0 ? 0.0 : widest;
+    const double circumference = 360 * std::cos(DegreesToRadians(widest_latitude));
+    const auto cells = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(circumference / row_height_)));
+    rows_.push_back({cell_count, cells, 360.0 / static_cast<double>(cells)});
+    cell_count += cells;
+  }
+  cells_.resize(cell_count);
+}
+
+std::size_t BearingIndex::CellOf(const Bearing& bearing) const {
+  const auto row_index = static_cast<std::size_t>(
+      std::clamp(std::floor((bearing.tilt + 90) / row_height_), 0.0, static_cast<double>(rows_.size() - 1)));
+  const auto& row = rows_[row_index];
+  const auto column = std::min(static_cast<std::size_t>(bearing.pan / row.cell_width), row.cell_count - 1);
+  return row.first_cell + column;
+}
+
+void BearingIndex::Insert(Id id, const Bearing& bearing) {
+  Remove(id);
+  const Bearing normalized{std::clamp(bearing.tilt, -90.0, 90.0), NormalizePan(bearing.pan)};
+  const auto cell = CellOf(normalized);
+  cells_[cell].push_back({id, geometry::PoseToDirection(normalized.tilt, normalized.pan), normalized});
+  locations_[id] = {cell, cells_[cell].size() - 1};
+}
+
+bool BearingIndex::Remove(Id id) {
+  const auto location = locations_.find(id);
+  if (location == locations_.end()) {
+    return false;
+  }
+  const auto [cell, position] = location->second;
+  auto& entries = cells_[cell];
+  // swap with the last entry of the cell, so that removing does not shift the others
+  if (position + 1 != entries.size()) {
+    entries[position] = std::move(entries.back());
+    locations_[entries[position].id].second = position;
+  }
+  entries.pop_back();
+  locations_.erase(location);
+  return true;
+}
+
+std::optional<Bearing> BearingIndex::Get(Id id) const {
+  const auto location = locations_.find(id);
+  if (location == locations_.end()) {
+    return std::nullopt;
+  }
+  return cells_[location->second.first][location->second.second].bearing;
+}
+
+template <typename Visit>
+void BearingIndex::VisitCap(const Bearing& center, double radius, Visit&& visit) const {
+  const double tilt = std::clamp(center.tilt, -90.0, 90.0);
+  const double pan = NormalizePan(center.pan);
+  const auto direction = geometry::PoseToDirection(tilt, pan);
+  const double min_cosine = radius >= 180 ? -1.0 : std::cos(DegreesToRadians(std::max(radius, 0.0)));
+
+  const double low = tilt - radius;
+  const double high = tilt + radius;
+  // Outside of a cap which does not contain a pole the pan differs from the center by at most the angle at which a
+  // meridian touches the cap.
+  const bool all_pans = low <= -90 or high >= 90;
+  const double pan_reach =
+      all_pans ? 180.0
+               : RadiansToDegrees(std::asin(std::min(
+                     1.0, std::sin(DegreesToRadians(radius)) / std::cos(DegreesToRadians(tilt)))));
+
+  const auto first_row = static_cast<std::size_t>(std::max(0.0, std::floor((low + 90) / row_height_)));
+  const auto last_row = static_cast<std::size_t>(
+      std::clamp(std::floor((high + 90) / row_height_), 0.0, static_cast<double>(rows_.size() - 1)));
+  for (auto row_index = first_row; row_index <= last_row; ++row_index) {
+    const auto& row = rows_[row_index];
+    const auto count = static_cast<long long>(row.cell_count);
+    long long first = 0;
+    long long last = count - 1;
+    if (pan_reach < 180) {
+      first = static_cast<long long>(std::floor((pan - pan_reach) / row.cell_width));
+      last = static_cast<long long>(std::floor((pan + pan_reach) / row.cell_width));
+      if (last - first + 1 >= count) {
+        first = 0;
+        last = count - 1;
+      }
+    }
+    for (auto column = first; column <= last; ++column) {
+      // the range may run over the seam at either end
+      const auto wrapped = static_cast<std::size_t>((column % count + count) % count);
+      for (const auto& entry : cells_[row.first_cell + wrapped]) {
+        const double cosine = direction.dot(entry.direction);
+        if (cosine >= min_cosine) {
+          visit(entry, cosine);
+        }
+      }
+    }
+  }
+}
+
+std::optional<BearingIndex::Neighbour> BearingIndex::Nearest(const Bearing& bearing, double max_distance) const {
+  // Grows the searched cap until it holds an entry: an entry found within a cap is the nearest, since every entry
+  // closer than it lies within the cap as well.
+  double radius = std::min(2 * row_height_, max_distance);
+  while (true) {
+    const Entry* nearest = nullptr;
+    double nearest_cosine = -2;
+    VisitCap(bearing, radius, [&](const Entry& entry, double cosine) {
+      if (cosine > nearest_cosine) {
+        nearest = &entry;
+        nearest_cosine = cosine;
+      }
+    });
+    if (nearest) {
+      return Neighbour{nearest->id, AngleFromCosine(nearest_cosine)};
+    }
+    if (radius >= max_distance or radius >= 180) {
+      return std::nullopt;
+    }
+    radius = std::min(2 * radius, max_distance);
+  }
+}
+
+std::vector<BearingIndex::Neighbour> BearingIndex::WithinRadius(const Bearing& bearing, double radius) const {
+  std::vector<std::pair<double, Id>> found;
+  VisitCap(bearing, radius, [&](const Entry& entry, double cosine) { found.emplace_back(-cosine, entry.id); });
+  std::sort(found.begin(), found.end());
+  std::vector<Neighbour> neighbours;
+  neighbours.reserve(found.size());
+  for (const auto& [negative_cosine, id] : found) {
+    neighbours.push_back({id, AngleFromCosine(-negative_cosine)});
+  }
+  return neighbours;
+}
+
+std::vector<BearingIndex::Visible> BearingIndex::InView(const cv::Matx33d& K, const cv::Size& frame_size,
+                                                        const Bearing& pose) const {
+  const geometry::Pinhole<double> intrinsics(K);
+  const geometry::PoseProjector<double> projector(intrinsics, pose.tilt, pose.pan);
+  // the frame is contained in the cap reaching its farthest corner
+  double radius = 0;
+  for (const auto& corner : {cv::Point2d(0, 0), cv::Point2d(frame_size.width, 0),
+                             cv::Point2d(0, frame_size.height), cv::Point2d(frame_size.width, frame_size.height)}) {
+    const auto ray = intrinsics.Unproject(corner.x, corner.y);
+    radius = std::max(radius, AngleFromCosine(1 / ray.norm()));
+  }
+
+  const geometry::Matrix3<double> world_to_camera = projector.GetCameraToWorld().transpose();
+  std::vector<Visible> visible;
+  VisitCap(pose, radius, [&](const Entry& entry, double) {
+    const geometry::Vector3<double> ray = world_to_camera * entry.direction;
+    if (ray[2] <= 0) {
+      return;
+    }
+    const cv::Point2d pixel(K(0, 0) * ray[0] / ray[2] + K(0, 2), K(1, 1) * ray[1] / ray[2] + K(1, 2));
+    if (pixel.x >= 0 and pixel.x < frame_size.width and pixel.y >= 0 and pixel.y < frame_size.height) {
+      visible.push_back({entry.id, pixel});
+    }
+  });
+  return visible;
+}
+
+} // namespace tpxai
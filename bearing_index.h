@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "geometry.h"
+
+namespace tpxai {
+
+// A direction from the camera, in degrees and signed like the PositionABS arguments, the pan in <0, 360).
+struct Bearing {
+  double tilt = 0;
+  double pan = 0;
+};
+
+// Spatial index of bearings, e.g. of saved presets or known objects, answering which of them is the closest to a
+// click, which lie within an angle of it and which are in the view of the camera.
+//
+// Bearings are bucketed in an iso-latitude grid of the unit sphere: rows of equal tilt height, each split into as
+// many pan cells as keep the cells roughly square, so all cells cover a similar area also near the poles. A query
+// visits only the cells overlapping the spherical cap around its center, wrapping the pan cell index modulo the row
+// length, so that 359.9 and 0.1 are neighbours. Distances are great-circle angles in degrees.
+//
+// Not thread-safe.
+class BearingIndex {
+public:
+  using Id = std::uint64_t;
+
+  struct Neighbour {
+    Id id;
+    double distance; // degrees
+  };
+
+  struct Visible {
+    Id id;
+    cv::Point2d pixel; // in the frame of the queried view
+  };
+
+  // the grid is sized for the typical query radius, smaller cells make the queries more selective but the grid
+  // larger
+  explicit BearingIndex(double cell_size_degrees = 2);
+
+  // Adds an entry or moves an existing one.
+  void Insert(Id id, const Bearing& bearing);
+  // Returns false if there is no such entry.
+  bool Remove(Id id);
+
+  std::optional<Bearing> Get(Id id) const;
+  std::size_t Size() const { return locations_.size(); }
+
+  // the closest entry not farther than max_distance
+  std::optional<Neighbour> Nearest(const Bearing& bearing, double max_distance = 180) const;
+
+  // entries not farther than the radius, closest first
+  std::vector<Neighbour> WithinRadius(const Bearing& bearing, double radius) const;
+
+  // Entries visible in a frame of the given size taken at the given pose with the given undistorted intrinsics,
+  // together with their pixels.
+  std::vector<Visible> InView(const cv::Matx33d& K, const cv::Size& frame_size, const Bearing& pose) const;
+
+private:
+  struct Entry {
+    Id id;
+    geometry::Vector3<double> direction;
+    Bearing bearing;
+  };
+
+  struct Row {
+    std::size_t first_cell; // in cells_
+    std::size_t cell_count;
+    double cell_width; // degrees of pan
+  };
+
+  std::size_t CellOf(const Bearing& bearing) const;
+
+  // Calls visit(entry, cosine) for all entries whose cosine of the angle from the center is at least cos(radius).
+  template <typename Visit>
+  void VisitCap(const Bearing& center, double radius, Visit&& visit) const;
+
+  double row_height_; // degrees of tilt
+  std::vector<Row> rows_;
+  std::vector<std::vector<Entry>> cells_;
+  std::unordered_map<Id, std::pair<std::size_t, std::size_t>> locations_; // cell and position in it
+};
+
+} // namespace tpxai
@@ -0,0 +1,144 @@
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bearing_index.h"
+#include "benchmark.h"
+#include "dahua_ptz_camera.h"
+
+// Query and update cost of the bearing index against a linear scan over the same bearings, for 1k, 10k and 100k
+// entries spread uniformly over the sphere.
+
+namespace {
+
+using tpxai::Bearing;
+using tpxai::BearingIndex;
+
+constexpr std::size_t query_count = 1000;
+constexpr double radius = 5;
+
+std::vector<Bearing> MakeBearings(std::size_t count, unsigned seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<double> z(-1, 1);
+  std::uniform_real_distribution<double> pan(0, 360);
+  std::vector<Bearing> bearings(count);
+  for (auto& bearing : bearings) {
+    bearing = {tpxai::geometry::RadiansToDegrees(std::asin(z(generator))), pan(generator)};
+  }
+  return bearings;
+}
+
+// What the index replaces: unit directions in a flat array, every query tests all of them.
+class LinearScan {
+public:
+  explicit LinearScan(const std::vector<Bearing>& bearings) {
+    directions_.reserve(bearings.size());
+    for (const auto& bearing : bearings) {
+      directions_.push_back(tpxai::geometry::PoseToDirection(bearing.tilt, bearing.pan));
+    }
+  }
+
+  std::size_t Nearest(const Bearing& bearing) const {
+    const auto direction = tpxai::geometry::PoseToDirection(bearing.tilt, bearing.pan);
+    std::size_t nearest = 0;
+    double nearest_cosine = -2;
+    for (std::size_t i = 0; i < directions_.size(); ++i) {
+      const double cosine = direction.dot(directions_[i]);
+      if (cosine > nearest_cosine) {
+        nearest = i;
+        nearest_cosine = cosine;
+      }
+    }
+    return nearest;
+  }
+
+  std::vector<std::size_t> WithinRadius(const Bearing& bearing, double degrees) const {
+    const auto direction = tpxai::geometry::PoseToDirection(bearing.tilt, bearing.pan);
+    const double min_cosine = std::cos(tpxai::geometry::DegreesToRadians(degrees));
+    std::vector<std::size_t> found;
+    for (std::size_t i = 0; i < directions_.size(); ++i) {
+      if (direction.dot(directions_[i]) >= min_cosine) {
+        found.push_back(i);
+      }
+    }
+    return found;
+  }
+
+  std::vector<std::size_t> InView(const cv::Matx33d& K, const cv::Size& frame_size, const Bearing& pose) const {
+    const tpxai::geometry::PoseProjector<double> projector(tpxai::geometry::Pinhole<double>(K), pose.tilt, pose.pan);
+    const tpxai::geometry::Matrix3<double> world_to_camera = projector.GetCameraToWorld().transpose();
+    std::vector<std::size_t> found;
+    for (std::size_t i = 0; i < directions_.size(); ++i) {
+      const tpxai::geometry::Vector3<double> ray = world_to_camera * directions_[i];
+      const double u = K(0, 0) * ray[0] / ray[2] + K(0, 2);
+      const double v = K(1, 1) * ray[1] / ray[2] + K(1, 2);
+      if (ray[2] > 0 and u >= 0 and u < frame_size.width and v >= 0 and v < frame_size.height) {
+        found.push_back(i);
+      }
+    }
+    return found;
+  }
+
+private:
+  std::vector<tpxai::geometry::Vector3<double>> directions_;
+};
+
+} // anonymous namespace
+
+int main() {
+  namespace benchmark = tpxai::benchmark;
+  using Calibration = tpxai::dahua::Calibration;
+  const cv::Matx33d K{Calibration::fx, 0., Calibration::cx, 0., Calibration::fy, Calibration::cy, 0., 0., 1.};
+  const cv::Size frame_size(Calibration::width, Calibration::height);
+  const auto queries = MakeBearings(query_count, 2);
+
+  for (const std::size_t size : {1000, 10000, 100000}) {
+    const auto bearings = MakeBearings(size, 1);
+    const LinearScan scan(bearings);
+    BearingIndex index;
+    for (std::size_t i = 0; i < bearings.size(); ++i) {
+      index.Insert(i, bearings[i]);
+    }
+    const auto prefix = std::to_string(size) + " entries, ";
+
+    benchmark::Report(prefix + "nearest, linear", benchmark::Measure(queries.size(), [&] {
+                        for (const auto& query : queries) {
+                          benchmark::DoNotOptimize(scan.Nearest(query));
+                        }
+                      }));
+    benchmark::Report(prefix + "nearest, index", benchmark::Measure(queries.size(), [&] {
+                        for (const auto& query : queries) {
+                          benchmark::DoNotOptimize(index.Nearest(query));
+                        }
+                      }));
+    benchmark::Report(prefix + "5 degree radius, linear", benchmark::Measure(queries.size(), [&] {
+                        for (const auto& query : queries) {
+                          benchmark::DoNotOptimize(scan.WithinRadius(query, radius));
+                        }
+                      }));
+    benchmark::Report(prefix + "5 degree radius, index", benchmark::Measure(queries.size(), [&] {
+                        for (const auto& query : queries) {
+                          benchmark::DoNotOptimize(index.WithinRadius(query, radius));
+                        }
+                      }));
+    benchmark::Report(prefix + "in view, linear", benchmark::Measure(queries.size(), [&] {
+                        for (const auto& query : queries) {
+                          benchmark::DoNotOptimize(scan.InView(K, frame_size, query));
+                        }
+                      }));
+    benchmark::Report(prefix + "in view, index", benchmark::Measure(queries.size(), [&] {
+                        for (const auto& query : queries) {
+                          benchmark::DoNotOptimize(index.InView(K, frame_size, query));
+                        }
+                      }));
+    // moves entries away and back, so that the index is the same for every repetition
+    benchmark::Report(prefix + "remove and insert, index", benchmark::Measure(2 * queries.size(), [&] {
+                        for (std::size_t i = 0; i < queries.size(); ++i) {
+                          index.Remove(i);
+                          index.Insert(i, bearings[i]);
+                        }
+                      }));
+  }
+  return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+
+namespace tpxai::benchmark {
+
+// A minimal harness for the benchmarks in this directory, which are plain executables so that they build wherever
+// the application does.
+
+// Keeps the compiler from discarding a result which is not used otherwise.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs the body, which performs the given number of operations, for several repetitions and returns the best time
+// per operation in nanoseconds. The best rather than the mean filters out preemption and cold caches.
+template <typename Body>
+double Measure(std::size_t operations, Body&& body, int repetitions = 5) {
+  double best = std::numeric_limits<double>::max();
+  for (int repetition = 0; repetition < repetitions; ++repetition) {
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count() / static_cast<double>(operations));
+  }
+  return best;
+}
+
+inline void Report(const std::string& name, double nanoseconds_per_operation) {
+  std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << nanoseconds_per_operation << " ns/op\n";
+}
+
+} // namespace tpxai::benchmark
@@ -0,0 +1,94 @@
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "benchmark.h"
+#include "dahua_ptz_camera.h"
+#include "geometry.h"
+#include "legacy_position_calculator.h"
+
+// Pixel to pose throughput of the geometry core against the calculation it replaced. Poses change every
+// detections_per_pose pixels, like the detections of one frame share the pose the frame was taken at.
+
+namespace {
+
+constexpr std::size_t sample_count = 1 << 16;
+constexpr std::size_t detections_per_pose = 16;
+
+struct Sample {
+  float tilt;
+  float pan;
+  int u;
+  int v;
+};
+
+std::vector<Sample> MakeSamples() {
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> tilt(-15, 90);
+  std::uniform_real_distribution<float> pan(0, 360);
+  std::uniform_int_distribution<int> u(0, tpxai::dahua::Calibration::width - 1);
+  std::uniform_int_distribution<int> v(0, tpxai::dahua::Calibration::height - 1);
+  std::vector<Sample> samples(sample_count);
+  for (std::size_t i = 0; i < samples.size(); i += detections_per_pose) {
+    const float sample_tilt = tilt(generator);
+    const float sample_pan = pan(generator);
+    for (std::size_t j = i; j < i + detections_per_pose; ++j) {
+      samples[j] = {sample_tilt, sample_pan, u(generator), v(generator)};
+    }
+  }
+  return samples;
+}
+
+template <typename Scalar, typename Intrinsics>
+void ProjectPerCall(const std::vector<Sample>& samples, const Intrinsics& intrinsics) {
+  for (const auto& sample : samples) {
+    const tpxai::geometry::PoseProjector<Scalar, Intrinsics> projector(intrinsics, sample.tilt, sample.pan);
+    tpxai::benchmark::DoNotOptimize(
+        projector.Target(static_cast<Scalar>(sample.u), static_cast<Scalar>(sample.v)));
+  }
+}
+
+template <typename Scalar, typename Intrinsics>
+void ProjectPerPose(const std::vector<Sample>& samples, const Intrinsics& intrinsics) {
+  for (std::size_t i = 0; i < samples.size(); i += detections_per_pose) {
+    const tpxai::geometry::PoseProjector<Scalar, Intrinsics> projector(intrinsics, samples[i].tilt, samples[i].pan);
+    for (std::size_t j = i; j < i + detections_per_pose; ++j) {
+      tpxai::benchmark::DoNotOptimize(
+          projector.Target(static_cast<Scalar>(samples[j].u), static_cast<Scalar>(samples[j].v)));
+    }
+  }
+}
+
+} // anonymous namespace
+
+int main() {
+  using namespace tpxai;
+  using Calibration = dahua::Calibration;
+  using Fixed = geometry::FixedPinhole<float, Calibration>;
+
+  const cv::Matx33d K{Calibration::fx, 0., Calibration::cx, 0., Calibration::fy, Calibration::cy, 0., 0., 1.};
+  const auto samples = MakeSamples();
+
+  benchmark::Report("legacy", benchmark::Measure(samples.size(), [&] {
+                      for (const auto& sample : samples) {
+                        benchmark::DoNotOptimize(legacy::CalculateAbsolutePosition({sample.u, sample.v}, K,
+                                                                                   {sample.tilt, sample.pan, 0}));
+                      }
+                    }));
+  benchmark::Report("float, rotation per pixel", benchmark::Measure(samples.size(), [&] {
+                      ProjectPerCall<float>(samples, geometry::Pinhole<float>(K));
+                    }));
+  benchmark::Report("double, rotation per pixel", benchmark::Measure(samples.size(), [&] {
+                      ProjectPerCall<double>(samples, geometry::Pinhole<double>(K));
+                    }));
+  benchmark::Report("float, rotation per pose", benchmark::Measure(samples.size(), [&] {
+                      ProjectPerPose<float>(samples, geometry::Pinhole<float>(K));
+                    }));
+  benchmark::Report("double, rotation per pose", benchmark::Measure(samples.size(), [&] {
+                      ProjectPerPose<double>(samples, geometry::Pinhole<double>(K));
+                    }));
+  benchmark::Report("float, rotation per pose, fixed intrinsics", benchmark::Measure(samples.size(), [&] {
+                      ProjectPerPose<float>(samples, Fixed{});
+                    }));
+  return 0;
+}
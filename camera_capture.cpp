@@ -0,0 +1,69 @@
+#include "camera_capture.h"
+
+#include <utility>
+
+#include <time.h>
+
+#include <glog/logging.h>
+
+#include "trace.h"
+
+namespace tpxai {
+
+std::chrono::nanoseconds GetThreadCPUTime() {
+  timespec time{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return std::chrono::seconds{time.tv_sec} + std::chrono::nanoseconds{time.tv_nsec};
+}
+
+CameraCapture::CameraCapture(dahua::DahuaPTZCamera& camera, FrameBus& bus)
+    : camera_{camera}, bus_{bus},
+      read_duration_{metrics::GetRegistry().GetHistogram("goto_point_frame_read_duration_seconds",
+                                                         "Time to receive and decode a frame of the stream")},
+      captured_frames_{metrics::GetRegistry().GetCounter("goto_point_captured_frames_total", "Decoded frames")},
+      thread_{&CameraCapture::Run, this} {}
+
+CameraCapture::~CameraCapture() {
+  stop_ = true;
+  thread_.join();
+}
+
+void CameraCapture::Run() {
+  trace::SetThreadName("capture");
+  std::uint64_t sequence = 0;
+  auto cpu_time = GetThreadCPUTime();
+  try {
+    while (not stop_) {
+      auto frame = std::make_shared<Frame>();
+      {
+        metrics::ScopedTimer timer(read_duration_);
+        frame->image = camera_.GetNextFrame();
+      }
+      captured_frames_.Add();
+      frame->sequence = sequence++;
+      frame->capture_time = std::chrono::steady_clock::now();
+      frame->position = camera_.GetCurrentPosition();
+      frame->zoom_multiple = camera_.GetCurrentZoom();
+      frame->camera_moving = camera_.IsMoving(frame->capture_time);
+      const auto pixels = frame->image.total();
+      {
+        trace::Span span("capture", "Publish");
+        bus_.Publish(std::move(frame));
+      }
+      const auto previous_cpu_time = std::exchange(cpu_time, GetThreadCPUTime());
+      cpu_time_ns_.fetch_add((cpu_time - previous_cpu_time).count(), std::memory_order_relaxed);
+      pixels_.fetch_add(pixels, std::memory_order_relaxed);
+      frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+  } catch (std::exception& e) {
+    LOG(ERROR) << "Camera capture stopped: " << e.what();
+  }
+  bus_.Close();
+}
+
+StreamLoad CameraCapture::GetLoad() const {
+  return {frames_.load(std::memory_order_relaxed), pixels_.load(std::memory_order_relaxed),
+          std::chrono::nanoseconds{cpu_time_ns_.load(std::memory_order_relaxed)}};
+}
+
+} // namespace tpxai
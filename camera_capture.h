@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "dahua_ptz_camera.h"
+#include "frame_bus.h"
+#include "metrics.h"
+
+namespace tpxai {
+
+// Totals since the capture started.
+struct StreamLoad {
+  std::uint64_t frames = 0;
+  std::uint64_t pixels = 0;
+  std::chrono::nanoseconds cpu_time{0}; // of the capture thread: receiving, decoding and publishing
+};
+
+// Of the calling thread, since it started.
+std::chrono::nanoseconds GetThreadCPUTime();
+
+// Decodes frames of the camera stream on a dedicated thread and publishes them, stamped with the camera state, to
+// the frame bus. The bus is closed when the stream fails or the capture is destroyed.
+class CameraCapture {
+public:
+  CameraCapture(dahua::DahuaPTZCamera& camera, FrameBus& bus);
+  ~CameraCapture();
+
+  CameraCapture(const CameraCapture&) = delete;
+  CameraCapture& operator=(const CameraCapture&) = delete;
+
+  StreamLoad GetLoad() const;
+
+private:
+  void Run();
+
+  dahua::DahuaPTZCamera& camera_;
+  FrameBus& bus_;
+  metrics::Histogram& read_duration_;
+  metrics::Counter& captured_frames_;
+  std::atomic<std::uint64_t> frames_{0};
+  std::atomic<std::uint64_t> pixels_{0};
+  std::atomic<std::int64_t> cpu_time_ns_{0};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+} // namespace tpxai
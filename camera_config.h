@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace tpxai {
+
+struct CameraConfig {
+  std::string name;
+  std::string host;
+  unsigned short port = 80;
+  std::string user;
+  std::string password;
+  std::uint16_t max_zoom = 32; // optical zoom range of the lens model
+};
+
+} // namespace tpxai
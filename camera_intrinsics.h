@@ -18,6 +18,29 @@ struct CameraIntrinsics {
   double fov_x(int width) const { return atan2(static_cast<double>(width), 2 * K(0, 0)); }
 
   double fov_y(int height) const { return atan2(static_cast<double>(height), 2 * K(1, 1)); }
+
+  // Intrinsics of the same lens at the given optical zoom, assuming the calibration was done at the widest setting
+  // and the principal point does not drift while zooming.
+  CameraIntrinsics ForZoom(double zoom_multiple) const {
+    CameraIntrinsics zoomed = *this;
+    const auto scale = zoom_multiple > 1 ? zoom_multiple : 1.0;
+    zoomed.K(0, 0) *= scale;
+    zoomed.K(1, 1) *= scale;
+    return zoomed;
+  }
+
+  // Intrinsics for frames of another resolution, assuming the camera scales the whole calibrated field of view to
+  // it, so the horizontal and vertical parameters scale independently when the aspect ratio changes.
+  CameraIntrinsics ForResolution(const cv::Size& calibration_size, const cv::Size& size) const {
+    CameraIntrinsics scaled = *this;
+    const double scale_x = static_cast<double>(size.width) / calibration_size.width;
+    const double scale_y = static_cast<double>(size.height) / calibration_size.height;
+    scaled.K(0, 0) *= scale_x;
+    scaled.K(0, 2) *= scale_x;
+    scaled.K(1, 1) *= scale_y;
+    scaled.K(1, 2) *= scale_y;
+    return scaled;
+  }
 };
 
 } // namespace tpxai
@@ -0,0 +1,103 @@
+#include "camera_startup.h"
+
+#include <future>
+
+#include <glog/logging.h>
+
+#include "http_interface.h"
+
+namespace tpxai {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::chrono::milliseconds ElapsedSince(Clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start);
+}
+
+void ProbeDevice(const CameraConfig& config, CameraStartupReport& report) {
+  const auto start = Clock::now();
+  dahua::HTTPInterface http_iface(config.user, config.password, config.host, config.port);
+  std::error_code error;
+  std::tie(error, report.device_type) = http_iface.GetDeviceType();
+  if (not error) {
+    std::tie(error, report.resolution) = http_iface.GetResolution();
+  }
+  if (not error) {
+    std::tie(error, report.frame_rate) = http_iface.GetFrameRate();
+  }
+  report.probe_error = error;
+  report.probe_duration = ElapsedSince(start);
+}
+
+} // anonymous namespace
+
+StartedCamera StartCamera(const CameraConfig& config, const StartupOptions& options) {
+  const auto start = Clock::now();
+  StartedCamera result;
+  result.config = config;
+  auto& report = result.report;
+  try {
+    auto camera = std::make_unique<dahua::DahuaPTZCamera>(config.user, config.password, config.host, config.port,
+                                                          options.stream_opening, config.max_zoom);
+
+    std::future<void> probe;
+    if (options.probe_device) {
+      probe = std::async(std::launch::async, ProbeDevice, std::cref(config), std::ref(report));
+    }
+
+    if (options.go_home) {
+      const auto home_start = Clock::now();
+      try {
+        camera->SetAbsolutePosition(PTZCameraPosition{0, 0});
+      } catch (std::system_error& e) {
+        report.home_error = e.code();
+      }
+      report.home_duration = ElapsedSince(home_start);
+    }
+
+    if (probe.valid()) {
+      probe.get();
+    }
+    if (options.stream_opening != dahua::StreamOpening::lazy) {
+      camera->WaitForStream();
+      report.stream_duration = camera->GetStreamOpenDuration();
+    }
+    result.camera = std::move(camera);
+  } catch (std::exception& e) {
+    result.error = e.what();
+  }
+  report.total_duration = ElapsedSince(start);
+
+  if (result.camera) {
+    LOG(INFO) << "Camera " << config.name << " (" << report.device_type << ", " << report.resolution.width << "x"
+              << report.resolution.height << "@" << report.frame_rate << ") started in "
+              << report.total_duration.count() << " ms: stream " << report.stream_duration.count() << " ms, probe "
+              << report.probe_duration.count() << " ms, home " << report.home_duration.count() << " ms";
+    LOG_IF(WARNING, report.probe_error) << "Camera " << config.name
+                                        << " probe failed: " << report.probe_error.message();
+    LOG_IF(WARNING, report.home_error) << "Camera " << config.name
+                                       << " home move failed: " << report.home_error.message();
+  } else {
+    LOG(ERROR) << "Camera " << config.name << " failed to start in " << report.total_duration.count()
+               << " ms: " << result.error;
+  }
+  return result;
+}
+
+std::vector<StartedCamera> StartCameras(const std::vector<CameraConfig>& configs, const StartupOptions& options) {
+  const auto start = Clock::now();
+  std::vector<std::future<StartedCamera>> startups;
+  for (const auto& config : configs) {
+    startups.push_back(std::async(std::launch::async, StartCamera, std::cref(config), std::cref(options)));
+  }
+  std::vector<StartedCamera> cameras;
+  for (auto& startup : startups) {
+    cameras.push_back(startup.get());
+  }
+  LOG(INFO) << configs.size() << " camera(s) started in " << ElapsedSince(start).count() << " ms";
+  return cameras;
+}
+
+} // namespace tpxai
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+#include "camera_config.h"
+#include "dahua_ptz_camera.h"
+
+namespace tpxai {
+
+struct StartupOptions {
+  dahua::StreamOpening stream_opening = dahua::StreamOpening::background;
+  bool probe_device = true;
+  bool go_home = true;
+};
+
+struct CameraStartupReport {
+  std::string device_type;
+  cv::Size resolution;
+  std::uint16_t frame_rate = 0;
+  std::error_code probe_error;
+  std::error_code home_error;
+  std::chrono::milliseconds stream_duration{0}; // zero when the stream opens lazily or not at all
+  std::chrono::milliseconds probe_duration{0};
+  std::chrono::milliseconds home_duration{0};
+  std::chrono::milliseconds total_duration{0};
+};
+
+struct StartedCamera {
+  CameraConfig config;
+  std::unique_ptr<dahua::DahuaPTZCamera> camera; // null when the camera failed to start
+  std::string error;
+  CameraStartupReport report;
+};
+
+// Brings a camera up with the stream opening, the device probing (type, resolution and frame rate over a separate
+// HTTP connection) and the move to the home position all running concurrently. A failed probe or home move is
+// reported but leaves the camera usable, a failed stream makes the whole startup fail.
+StartedCamera StartCamera(const CameraConfig& config, const StartupOptions& options = {});
+
+// Starts all cameras in parallel, so the total startup time is that of the slowest camera.
+std::vector<StartedCamera> StartCameras(const std::vector<CameraConfig>& configs, const StartupOptions& options = {});
+
+} // namespace tpxai
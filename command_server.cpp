@@ -0,0 +1,510 @@
+#include "command_server.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "position_calculator.h"
+#include "trace.h"
+
+namespace tpxai {
+
+namespace {
+
+template <typename T>
+bool ParseInteger(std::string_view text, T& value) {
+  const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return ec == std::errc() and ptr == text.data() + text.size();
+}
+
+std::vector<std::string_view> SplitFields(std::string_view line) {
+  std::vector<std::string_view> fields;
+  std::size_t start = line.find_first_not_of(" \t");
+  while (start != std::string_view::npos) {
+    const auto end = line.find_first_of(" \t", start);
+    fields.push_back(line.substr(start, end == std::string_view::npos ? end : end - start));
+    start = line.find_first_not_of(" \t", end);
+  }
+  return fields;
+}
+
+// longer lines are not commands but a misbehaving client
+constexpr std::size_t max_line_length = 4096;
+// answers queued for a client which does not read them
+constexpr std::size_t max_pending_output = 1 << 20;
+
+void Wake(int fd) {
+  const char byte = 0;
+  // a full pipe already wakes the poll thread
+  [[maybe_unused]] auto written = write(fd, &byte, 1);
+}
+
+bool ParseFloat(std::string_view text, float& value) {
+  const std::string copy(text);
+  char* end = nullptr;
+  value = std::strtof(copy.c_str(), &end);
+  return not copy.empty() and end == copy.c_str() + copy.size() and std::isfinite(value);
+}
+
+} // anonymous namespace
+
+std::pair<std::error_code, Command> ParseCommand(std::string_view line) {
+  const auto fields = SplitFields(line);
+
+  std::pair<std::error_code, Command> result;
+  auto& command = result.second;
+  auto invalid = [&result] {
+    result.first = std::make_error_code(std::errc::invalid_argument);
+    return result;
+  };
+
+  if (fields.size() < 3) {
+    return invalid();
+  }
+  command.id = fields[0];
+  command.camera = fields[1];
+  const auto verb = fields[2];
+  const auto arguments = fields.size() - 3;
+
+  if (verb == "click" and arguments == 2) {
+    command.type = Command::Type::click;
+    if (not ParseInteger(fields[3], command.point.x) or not ParseInteger(fields[4], command.point.y)) {
+      return invalid();
+    }
+  } else if (verb == "move" and (arguments == 2 or arguments == 3)) {
+    command.type = Command::Type::move;
+    if (not ParseFloat(fields[3], command.position.horizontal_angle) or
+        not ParseFloat(fields[4], command.position.vertical_angle)) {
+      return invalid();
+    }
+    if (arguments == 3) {
+      std::uint16_t zoom_multiple = 0;
+      if (not ParseInteger(fields[5], zoom_multiple)) {
+        return invalid();
+      }
+      command.zoom_multiple = zoom_multiple;
+    }
+  } else if (verb == "zoom" and arguments == 1) {
+    command.type = Command::Type::zoom;
+    std::uint16_t zoom_multiple = 0;
+    if (not ParseInteger(fields[3], zoom_multiple)) {
+      return invalid();
+    }
+    command.zoom_multiple = zoom_multiple;
+  } else if (verb == "focus" and (arguments == 2 or arguments == 3)) {
+    if (fields[3] == "near") {
+      command.type = Command::Type::focus_near;
+    } else if (fields[3] == "far") {
+      command.type = Command::Type::focus_far;
+    } else {
+      return invalid();
+    }
+    if (not ParseInteger(fields[4], command.speed)) {
+      return invalid();
+    }
+    if (arguments == 3) {
+      unsigned pulse_ms = 0;
+      if (not ParseInteger(fields[5], pulse_ms)) {
+        return invalid();
+      }
+      command.pulse_duration = std::chrono::milliseconds{pulse_ms};
+    }
+  } else {
+    return invalid();
+  }
+  return result;
+}
+
+std::vector<bool> SupersedeMoves(std::vector<Command>& commands) {
+  std::vector<bool> superseded(commands.size(), false);
+  for (std::size_t i = 0; i + 1 < commands.size(); i++) {
+    auto& next = commands[i + 1];
+    if (commands[i].type == Command::Type::move and next.type == Command::Type::move) {
+      superseded[i] = true;
+      if (not next.zoom_multiple) {
+        next.zoom_multiple = commands[i].zoom_multiple;
+      }
+    }
+  }
+  return superseded;
+}
+
+// A connected client. Its socket is non-blocking: answers which do not fit into the socket buffer are queued and
+// sent by the poll thread once the socket becomes writable.
+class CommandServer::Client {
+public:
+  Client(int fd, int wake_fd) : fd_{fd}, wake_fd_{wake_fd} {}
+  ~Client() { close(fd_); }
+
+  int GetFd() const { return fd_; }
+  // poll thread only
+  std::string& GetInputBuffer() { return input_; }
+  bool IsReadClosed() const { return read_closed_; }
+  void SetReadClosed() { read_closed_ = true; }
+
+  // May be called from any thread.
+  void Write(const std::string& data) {
+    {
+      std::lock_guard lock(mutex_);
+      if (closed_) {
+        return;
+      }
+      if (output_.size() + data.size() > max_pending_output) {
+        LOG(WARNING) << "Client does not read its answers, disconnecting it";
+        CloseLocked();
+        return;
+      }
+      output_ += data;
+      SendPendingLocked();
+      if (output_.empty()) {
+        return;
+      }
+    }
+    // the poll thread waits for the socket to become writable
+    Wake(wake_fd_);
+  }
+
+  // Sends queued answers once the socket is writable, poll thread only.
+  void Flush() {
+    std::lock_guard lock(mutex_);
+    SendPendingLocked();
+  }
+
+  bool HasPendingOutput() const {
+    std::lock_guard lock(mutex_);
+    return not output_.empty();
+  }
+
+  // Drops the queued answers and shuts the socket down, so that the poll thread sees the client hang up.
+  void Close() {
+    std::lock_guard lock(mutex_);
+    CloseLocked();
+  }
+
+private:
+  void CloseLocked() {
+    closed_ = true;
+    output_.clear();
+    shutdown(fd_, SHUT_RDWR);
+  }
+
+  void SendPendingLocked() {
+    while (not closed_ and not output_.empty()) {
+      const auto written = send(fd_, output_.data(), output_.size(), MSG_NOSIGNAL);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN and errno != EWOULDBLOCK) {
+          CloseLocked();
+        }
+        return;
+      }
+      output_.erase(0, static_cast<std::size_t>(written));
+    }
+  }
+
+  const int fd_;
+  const int wake_fd_;
+  std::string input_;
+  bool read_closed_ = false;
+  mutable std::mutex mutex_;
+  std::string output_;
+  bool closed_ = false;
+};
+
+class CommandServer::CameraWorker {
+public:
+  explicit CameraWorker(dahua::DahuaPTZCamera& camera) : camera_{camera}, thread_{&CameraWorker::Run, this} {}
+
+  ~CameraWorker() {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+    batches_available_.notify_one();
+    thread_.join();
+  }
+
+  void Submit(std::shared_ptr<Client> client, std::vector<Command> commands,
+              std::chrono::steady_clock::time_point received) {
+    {
+      std::lock_guard lock(mutex_);
+      batches_.push_back(Batch{std::move(client), std::move(commands), received});
+    }
+    batches_available_.notify_one();
+  }
+
+private:
+  struct Batch {
+    std::shared_ptr<Client> client;
+    std::vector<Command> commands;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  void Run() {
+    trace::SetThreadName("camera worker");
+    while (true) {
+      Batch batch;
+      {
+        std::unique_lock lock(mutex_);
+        batches_available_.wait(lock, [this] { return stop_ or not batches_.empty(); });
+        if (batches_.empty()) {
+          return;
+        }
+        batch = std::move(batches_.front());
+        batches_.pop_front();
+      }
+      Execute(batch);
+    }
+  }
+
+  void Execute(Batch& batch) {
+    std::string responses;
+    auto& commands = batch.commands;
+    const auto superseded = SupersedeMoves(commands);
+    for (std::size_t i = 0; i < commands.size(); i++) {
+      const auto& command = commands[i];
+      if (superseded[i]) {
+        responses += command.id + " OK superseded\n";
+        continue;
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      // overlaps the previous commands of the batch, so it goes on a track of its own
+      trace::RecordAsync("daemon", "queued", ++queued_commands_, batch.received, start);
+      std::string error;
+      try {
+        trace::Span span("daemon", "command");
+        Execute(command);
+      } catch (std::exception& e) {
+        error = e.what();
+      }
+      const auto end = std::chrono::steady_clock::now();
+
+      LOG(INFO) << "Command " << command.id << " for " << command.camera << ": socket to camera request "
+                << std::chrono::duration_cast<std::chrono::microseconds>(start - batch.received).count()
+                << " us, camera request "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() << " ms"
+                << (error.empty() ? "" : ", failed: ") << error;
+      responses += command.id + (error.empty() ? " OK\n" : " ERR " + error + "\n");
+    }
+    batch.client->Write(responses);
+  }
+
+  void Execute(const Command& command) {
+    switch (command.type) {
+      case Command::Type::click: {
+        const auto position = camera_.GetCurrentPosition();
+        const Eigen::Vector3f current{position.vertical_angle, position.horizontal_angle, 0};
+        const auto intrinsics = camera_.GetIntrinsics().ForZoom(camera_.GetCurrentZoom());
+        const Eigen::Vector3f target = CalculateAbsolutePosition(command.point, intrinsics.K, current);
+        camera_.SetAbsolutePosition(PTZCameraPosition{target[1], target[0]});
+        break;
+      }
+      case Command::Type::move:
+        if (command.zoom_multiple) {
+          camera_.SetAbsolutePosition(command.position, *command.zoom_multiple);
+        } else {
+          camera_.SetAbsolutePosition(command.position);
+        }
+        break;
+      case Command::Type::zoom:
+        camera_.SetZoom(*command.zoom_multiple);
+        break;
+      case Command::Type::focus_near:
+        camera_.SetFocusNear(command.speed, command.pulse_duration);
+        break;
+      case Command::Type::focus_far:
+        camera_.SetFocusFar(command.speed, command.pulse_duration);
+        break;
+    }
+  }
+
+  dahua::DahuaPTZCamera& camera_;
+  std::mutex mutex_;
+  std::condition_variable batches_available_;
+  std::deque<Batch> batches_;
+  bool stop_ = false;
+  std::uint64_t queued_commands_ = 0;
+  std::thread thread_;
+};
+
+CommandServer::CommandServer(std::string socket_path, std::map<std::string, dahua::DahuaPTZCamera*> cameras)
+    : socket_path_{std::move(socket_path)} {
+  for (auto& [name, camera] : cameras) {
+    workers_.emplace(name, std::make_unique<CameraWorker>(*camera));
+  }
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (socket_path_.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("socket path too long: " + socket_path_);
+  }
+  std::strcpy(address.sun_path, socket_path_.c_str());
+
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(), "socket");
+  }
+  unlink(socket_path_.c_str());
+  if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 or listen(listen_fd_, 16) != 0) {
+    const auto error = errno;
+    close(listen_fd_);
+    throw std::system_error(error, std::generic_category(), "bind " + socket_path_);
+  }
+  // non-blocking, so that waking the poll thread never blocks a worker
+  if (pipe2(wake_fds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+    const auto error = errno;
+    close(listen_fd_);
+    throw std::system_error(error, std::generic_category(), "pipe");
+  }
+  LOG(INFO) << "Listening for commands on " << socket_path_;
+}
+
+CommandServer::~CommandServer() {
+  close(listen_fd_);
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+  unlink(socket_path_.c_str());
+}
+
+void CommandServer::Stop() {
+  stopping_ = true;
+  Wake(wake_fds_[1]);
+}
+
+void CommandServer::Run() {
+  trace::SetThreadName("command server");
+  std::vector<std::shared_ptr<Client>> clients;
+  std::vector<pollfd> fds;
+  std::vector<std::size_t> polled_clients; // indices into clients of fds[2...]
+  while (true) {
+    fds.clear();
+    polled_clients.clear();
+    fds.push_back({wake_fds_[0], POLLIN, 0});
+    fds.push_back({listen_fd_, POLLIN, 0});
+    for (std::size_t i = 0; i < clients.size(); i++) {
+      short events = clients[i]->IsReadClosed() ? 0 : POLLIN;
+      if (clients[i]->HasPendingOutput()) {
+        events |= POLLOUT;
+      }
+      // a hung up socket would be reported on every poll even without events
+      if (events) {
+        fds.push_back({clients[i]->GetFd(), events, 0});
+        polled_clients.push_back(i);
+      }
+    }
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "poll");
+    }
+    if (fds[0].revents) {
+      char buffer[64];
+      while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {
+      }
+      if (stopping_) {
+        break;
+      }
+    }
+    for (std::size_t i = 0; i < polled_clients.size(); i++) {
+      auto& client = *clients[polled_clients[i]];
+      const auto revents = fds[i + 2].revents;
+      if (revents & POLLOUT) {
+        client.Flush();
+      }
+      if (client.IsReadClosed() or not(revents & (POLLIN | POLLHUP | POLLERR))) {
+        continue;
+      }
+      char buffer[64 * 1024];
+      const auto received = read(client.GetFd(), buffer, sizeof(buffer));
+      if (received < 0 and (errno == EAGAIN or errno == EWOULDBLOCK or errno == EINTR)) {
+        continue;
+      }
+      if (received <= 0) {
+        client.SetReadClosed();
+        continue;
+      }
+      client.GetInputBuffer().append(buffer, static_cast<std::size_t>(received));
+      OnReadable(clients[polled_clients[i]]);
+      if (client.GetInputBuffer().size() > max_line_length) {
+        LOG(WARNING) << "Client sent a line longer than " << max_line_length << " bytes, disconnecting it";
+        client.Close();
+        client.SetReadClosed();
+      }
+    }
+    // workers may still answer a half-closed client, it is dropped once they are done and its answers are sent
+    clients.erase(std::remove_if(clients.begin(), clients.end(),
+                                 [](const auto& client) {
+                                   return client->IsReadClosed() and client.use_count() == 1 and
+                                          not client->HasPendingOutput();
+                                 }),
+                  clients.end());
+    if (fds[1].revents & POLLIN) {
+      const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if (fd >= 0) {
+        clients.push_back(std::make_shared<Client>(fd, wake_fds_[1]));
+      }
+    }
+  }
+}
+
+void CommandServer::OnReadable(const std::shared_ptr<Client>& client) {
+  const auto received = std::chrono::steady_clock::now();
+  auto& input = client->GetInputBuffer();
+
+  std::map<CameraWorker*, std::vector<Command>> batches;
+  std::string errors;
+  std::size_t line_start = 0;
+  for (auto line_end = input.find('\n'); line_end != std::string::npos; line_end = input.find('\n', line_start)) {
+    std::string_view line(input.data() + line_start, line_end - line_start);
+    line_start = line_end + 1;
+    if (not line.empty() and line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    if (line.find_first_not_of(" \t") == std::string_view::npos) {
+      continue;
+    }
+
+    auto [error, command] = ParseCommand(line);
+    if (error) {
+      const auto id = line.substr(0, line.find_first_of(" \t"));
+      errors += std::string(id) + " ERR malformed command\n";
+      continue;
+    }
+    auto worker = workers_.find(command.camera);
+    if (worker == workers_.end()) {
+      errors += command.id + " ERR unknown camera\n";
+      continue;
+    }
+    batches[worker->second.get()].push_back(std::move(command));
+  }
+  input.erase(0, line_start);
+
+  if (not errors.empty()) {
+    client->Write(errors);
+  }
+  for (auto& [worker, commands] : batches) {
+    worker->Submit(client, std::move(commands), received);
+  }
+}
+
+} // namespace tpxai
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+#include "dahua_ptz_camera.h"
+
+namespace tpxai {
+
+// One line of the command socket protocol, fields separated by whitespace:
+//
+//   <id> <camera> click <x> <y>                     center on a full-resolution pixel of the current view
+//   <id> <camera> move <pan> <tilt> [<zoom>]        absolute position in degrees
+//   <id> <camera> zoom <multiple>
+//   <id> <camera> focus near|far <speed> [<pulse ms>]
+//
+// Every command is answered with "<id> OK" or "<id> ERR <reason>". Clients may pipeline any number of commands
+// without waiting for the answers; answers for one camera come in order.
+struct Command {
+  enum class Type { click, move, zoom, focus_near, focus_far };
+
+  std::string id;
+  std::string camera;
+  Type type = Type::click;
+  cv::Point point;
+  PTZCameraPosition position;
+  std::optional<std::uint16_t> zoom_multiple;
+  std::uint16_t speed = 1;
+  std::chrono::milliseconds pulse_duration{100};
+};
+
+std::pair<std::error_code, Command> ParseCommand(std::string_view line);
+
+// Marks every move of a batch which is directly followed by another move as superseded, i.e. to be answered without
+// being sent. A following move which keeps the current zoom takes over the zoom of the move it supersedes, so the
+// camera ends up where executing the whole batch would have left it.
+std::vector<bool> SupersedeMoves(std::vector<Command>& commands);
+
+// Accepts commands on a Unix domain socket and executes them on one worker thread per camera, so a slow or dead
+// camera never delays the others. All complete lines received in one read are handed to the workers as a single
+// batch; within a batch a move superseded by the following move of the same camera is answered without being sent.
+// Client sockets are non-blocking and answers are queued per client, so a client which does not read its answers
+// never stalls the server; it is disconnected once too many answers pile up, as is a client sending overlong lines.
+class CommandServer {
+public:
+  CommandServer(std::string socket_path, std::map<std::string, dahua::DahuaPTZCamera*> cameras);
+  ~CommandServer();
+
+  CommandServer(const CommandServer&) = delete;
+  CommandServer& operator=(const CommandServer&) = delete;
+
+  // Serves until Stop is called.
+  void Run();
+  void Stop();
+
+private:
+  class Client;
+  class CameraWorker;
+
+  void OnReadable(const std::shared_ptr<Client>& client);
+
+  std::string socket_path_;
+  int listen_fd_ = -1;
+  int wake_fds_[2] = {-1, -1};
+  std::atomic<bool> stopping_{false};
+  std::map<std::string, std::unique_ptr<CameraWorker>> workers_;
+};
+
+} // namespace tpxai
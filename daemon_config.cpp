@@ -0,0 +1,117 @@
+#include "daemon_config.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+namespace tpxai {
+
+namespace {
+
+[[noreturn]] void ThrowConfigError(int line_number, const std::string& message) {
+  throw std::runtime_error("config line " + std::to_string(line_number) + ": " + message);
+}
+
+} // anonymous namespace
+
+DaemonConfig ParseDaemonConfig(std::istream& input) {
+  DaemonConfig config;
+  CameraConfig* camera = nullptr;
+  std::string line;
+  for (int line_number = 1; std::getline(input, line); line_number++) {
+    boost::algorithm::trim(line);
+    if (line.empty() or line[0] == '#' or line[0] == ';') {
+      continue;
+    }
+
+    if (line.front() == '[') {
+      if (line.back() != ']') {
+        ThrowConfigError(line_number, "unterminated section");
+      }
+      auto section = line.substr(1, line.size() - 2);
+      boost::algorithm::trim(section);
+      if (not boost::algorithm::starts_with(section, "camera ")) {
+        ThrowConfigError(line_number, "unknown section " + section);
+      }
+      auto name = section.substr(std::strlen("camera "));
+      boost::algorithm::trim(name);
+      for (const auto& other : config.cameras) {
+        if (other.name == name) {
+          ThrowConfigError(line_number, "duplicated camera " + name);
+        }
+      }
+      camera = &config.cameras.emplace_back();
+      camera->name = std::move(name);
+      continue;
+    }
+
+    const auto separator = line.find('=');
+    if (separator == std::string::npos) {
+      ThrowConfigError(line_number, "expected key = value");
+    }
+    auto key = line.substr(0, separator);
+    auto value = line.substr(separator + 1);
+    boost::algorithm::trim(key);
+    boost::algorithm::trim(value);
+
+    if (not camera) {
+      if (key == "socket") {
+        config.socket_path = value;
+      } else if (key == "metrics_file") {
+        config.metrics_file = value;
+      } else if (key == "trace_file") {
+        config.trace_file = value;
+      } else {
+        ThrowConfigError(line_number, "unknown option " + key);
+      }
+    } else if (key == "host") {
+      camera->host = value;
+    } else if (key == "port") {
+      try {
+        const auto port = std::stoul(value);
+        if (port == 0 or port > 65535) {
+          throw std::out_of_range(value);
+        }
+        camera->port = static_cast<unsigned short>(port);
+      } catch (std::logic_error&) {
+        ThrowConfigError(line_number, "invalid port " + value);
+      }
+    } else if (key == "user") {
+      camera->user = value;
+    } else if (key == "password") {
+      camera->password = value;
+    } else if (key == "max_zoom") {
+      try {
+        const auto max_zoom = std::stoul(value);
+        if (max_zoom == 0 or max_zoom > 65535) {
+          throw std::out_of_range(value);
+        }
+        camera->max_zoom = static_cast<std::uint16_t>(max_zoom);
+      } catch (std::logic_error&) {
+        ThrowConfigError(line_number, "invalid max_zoom " + value);
+      }
+    } else {
+      ThrowConfigError(line_number, "unknown camera option " + key);
+    }
+  }
+
+  for (const auto& camera : config.cameras) {
+    if (camera.host.empty()) {
+      throw std::runtime_error("camera " + camera.name + " has no host");
+    }
+  }
+  return config;
+}
+
+DaemonConfig LoadDaemonConfig(const std::string& path) {
+  std::ifstream input(path);
+  if (not input) {
+    throw std::runtime_error("unable to open " + path);
+  }
+  return ParseDaemonConfig(input);
+}
+
+} // namespace tpxai
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "camera_config.h"
+
+namespace tpxai {
+
+struct DaemonConfig {
+  std::string socket_path = "/tmp/goto_point.sock";
+  std::string metrics_file; // Prometheus text file, not written when empty
+  std::string trace_file = "/tmp/goto_point_trace.json"; // written when tracing is switched off with SIGUSR1
+  std::vector<CameraConfig> cameras;
+};
+
+// Parses an INI-like configuration:
+//
+//   socket = /run/goto_point.sock
+//   metrics_file = /var/lib/node_exporter/goto_point.prom
+//   trace_file = /tmp/goto_point_trace.json
+//
+//   [camera front]
+//   host = 192.168.1.102
+//   port = 80
+//   user = admin
+//   password = secret
+//   max_zoom = 32
+//
+// Throws std::runtime_error pointing at the offending line.
+DaemonConfig ParseDaemonConfig(std::istream& input);
+DaemonConfig LoadDaemonConfig(const std::string& path);
+
+} // namespace tpxai
@@ -0,0 +1,99 @@
+#include <csignal>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "camera_startup.h"
+#include "command_server.h"
+#include "daemon_config.h"
+#include "dahua_ptz_camera.h"
+#include "metrics.h"
+#include "trace.h"
+
+namespace {
+
+void WriteTrace(const std::string& path) {
+  try {
+    tpxai::trace::WriteChromeTrace(path);
+    LOG(INFO) << "Trace written to " << path;
+  } catch (std::exception& e) {
+    LOG(ERROR) << e.what();
+  }
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) try {
+  google::InitGoogleLogging(argv[0]);
+  if (argc != 2) {
+    std::cerr << "usage: " << argv[0] << " <config file>" << std::endl;
+    return 2;
+  }
+  const auto config = tpxai::LoadDaemonConfig(argv[1]);
+  tpxai::trace::SetThreadName("main");
+
+  // handled by sigwait below, blocked before any thread is started so that none of them receives it
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  std::unique_ptr<tpxai::metrics::FileExporter> metrics_exporter;
+  if (not config.metrics_file.empty()) {
+    metrics_exporter = std::make_unique<tpxai::metrics::FileExporter>(tpxai::metrics::GetRegistry(),
+                                                                      config.metrics_file);
+  }
+
+  // the daemon only commands the heads, so the stream is opened only if a frame is ever requested
+  tpxai::StartupOptions startup_options;
+  startup_options.stream_opening = tpxai::dahua::StreamOpening::lazy;
+  auto cameras = tpxai::StartCameras(config.cameras, startup_options);
+
+  std::map<std::string, tpxai::dahua::DahuaPTZCamera*> cameras_by_name;
+  for (const auto& started : cameras) {
+    if (started.camera) {
+      cameras_by_name.emplace(started.config.name, started.camera.get());
+    }
+  }
+
+  tpxai::CommandServer server(config.socket_path, cameras_by_name);
+  std::thread server_thread([&server] {
+    try {
+      server.Run();
+    } catch (std::exception& e) {
+      LOG(ERROR) << "Command server failed: " << e.what();
+      kill(getpid(), SIGTERM);
+    }
+  });
+
+  int signal = 0;
+  // SIGUSR1 switches tracing on, the next one switches it off and writes the trace
+  while (sigwait(&signals, &signal) == 0 and signal == SIGUSR1) {
+    tpxai::trace::SetEnabled(not tpxai::trace::IsEnabled());
+    if (tpxai::trace::IsEnabled()) {
+      LOG(INFO) << "Tracing enabled";
+    } else {
+      WriteTrace(config.trace_file);
+    }
+  }
+  LOG(INFO) << "Stopping on signal " << signal;
+  server.Stop();
+  server_thread.join();
+  if (tpxai::trace::IsEnabled()) {
+    WriteTrace(config.trace_file);
+  }
+  return 0;
+} catch (std::exception& e) {
+  std::cerr << e.what() << std::endl;
+  return 1;
+} catch (...) {
+  std::cerr << "Unknown error" << std::endl;
+  return 1;
+}
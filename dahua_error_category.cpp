@@ -10,6 +10,8 @@ std::string DahuaErrorCategory::message(int condition) const {
       return "OK";
     case DahuaErrorCode::error:
       return "ERROR";
+    case DahuaErrorCode::camera_unreachable:
+      return "CAMERA UNREACHABLE";
     default:
       return "UNKNOWN ERROR";
   }
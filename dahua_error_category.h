@@ -6,7 +6,8 @@ namespace tpxai::dahua {
 
 enum class DahuaErrorCode {
   ok,
-  error
+  error,
+  camera_unreachable // the circuit breaker is open, the request has not been sent
 };
 
 std::error_code make_error_code(const DahuaErrorCode& e);
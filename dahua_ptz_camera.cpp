@@ -1,33 +1,85 @@
 #include "dahua_ptz_camera.h"
 
+#include <glog/logging.h>
+
+#include "jpeg_decoder.h"
+#include "trace.h"
+
 namespace tpxai::dahua {
 
 DahuaPTZCamera::DahuaPTZCamera(std::string user, std::string password,
                                std::string host, unsigned short port)
-    : http_iface_{std::move(user), std::move(password), std::move(host), port} {
+    : DahuaPTZCamera(std::move(user), std::move(password), std::move(host), port, StreamOpening::eager) {}
 
+DahuaPTZCamera::DahuaPTZCamera(std::string user, std::string password, std::string host, unsigned short port,
+                               StreamOpening stream_opening, std::uint16_t max_zoom)
+    : http_iface_{std::move(user), std::move(password), std::move(host), port}, max_zoom_{max_zoom} {
+  switch (stream_opening) {
+    case StreamOpening::eager:
+      OpenStream();
+      break;
+    case StreamOpening::background:
+      stream_ready_ = std::async(std::launch::async, &DahuaPTZCamera::OpenStream, this);
+      break;
+    case StreamOpening::lazy:
+      stream_ready_ = std::async(std::launch::deferred, &DahuaPTZCamera::OpenStream, this);
+      break;
+    case StreamOpening::none:
+      break;
+  }
+}
+
+void DahuaPTZCamera::OpenStream() {
+  const auto start = std::chrono::steady_clock::now();
   bool status = capture_.open(http_iface_.GetStreamingURL());
   if (not status) {
     throw std::runtime_error("unable to start camera capture");
   }
-  capture_.set(cv::CAP_PROP_FPS, 30);
-  capture_.set(cv::CAP_PROP_FRAME_WIDTH, 2592);
-  capture_.set(cv::CAP_PROP_FRAME_HEIGHT, 1520);
+  stream_open_duration_ =
+      std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void DahuaPTZCamera::WaitForStream() {
+  if (stream_ready_.valid()) {
+    stream_ready_.get();
+  }
+}
+
+std::chrono::milliseconds DahuaPTZCamera::GetStreamOpenDuration() const {
+  return std::chrono::milliseconds{stream_open_duration_};
+}
+
+void DahuaPTZCamera::SetMoveCallback(MoveCallback callback) {
+  std::lock_guard lock(command_mutex_);
+  move_callback_ = std::move(callback);
+}
+
+void DahuaPTZCamera::SetRequestObserver(HTTPInterface::RequestObserver observer) {
+  std::lock_guard lock(command_mutex_);
+  http_iface_.SetRequestObserver(std::move(observer));
 }
 
 void DahuaPTZCamera::SetZoom(std::uint16_t multiple) {
-  auto error = http_iface_.GoToABSPosition(current_position_, multiple);
+  trace::Span span("camera", "SetZoom");
+  std::lock_guard lock(command_mutex_);
+  const auto position = GetCurrentPosition();
+  const auto command_time = std::chrono::steady_clock::now();
+  auto error = http_iface_.GoToABSPosition(position, multiple);
   if (not error) {
-    current_zoom_multiple_ = multiple;
+    UpdateState(position, multiple, command_time);
   } else {
     throw std::system_error(error);
   }
 }
 
 void DahuaPTZCamera::SetAbsolutePosition(const PTZCameraPosition &position) {
-  auto error = http_iface_.GoToABSPosition(position, current_zoom_multiple_);
+  trace::Span span("camera", "SetAbsolutePosition");
+  std::lock_guard lock(command_mutex_);
+  const auto zoom_multiple = GetCurrentZoom();
+  const auto command_time = std::chrono::steady_clock::now();
+  auto error = http_iface_.GoToABSPosition(position, zoom_multiple);
   if (not error) {
-    current_position_ = position;
+    UpdateState(position, zoom_multiple, command_time);
   } else {
     throw std::system_error(error);
   }
@@ -35,43 +87,74 @@ void DahuaPTZCamera::SetAbsolutePosition(const PTZCameraPosition &position) {
 
 void DahuaPTZCamera::SetAbsolutePosition(const PTZCameraPosition &position,
                                          std::uint16_t zoom_multiple) {
+  trace::Span span("camera", "SetAbsolutePosition");
+  std::lock_guard lock(command_mutex_);
+  const auto command_time = std::chrono::steady_clock::now();
   auto error = http_iface_.GoToABSPosition(position, zoom_multiple);
   if (not error) {
-    current_position_ = position;
-    current_zoom_multiple_ = zoom_multiple;
+    UpdateState(position, zoom_multiple, command_time);
   } else {
     throw std::system_error(error);
   }
 }
 
-void DahuaPTZCamera::SetFocusNear(std::uint16_t multiple) {
-  auto error = http_iface_.SetFocusNear(multiple);
+void DahuaPTZCamera::SetFocusNear(std::uint16_t multiple, std::chrono::milliseconds pulse_duration) {
+  trace::Span span("camera", "SetFocusNear");
+  std::lock_guard lock(command_mutex_);
+  auto error = http_iface_.SetFocusNear(multiple, pulse_duration);
   if (error) {
     throw std::system_error(error);
   }
 }
 
-void DahuaPTZCamera::SetFocusFar(std::uint16_t multiple) {
-  auto error = http_iface_.SetFocusFar(multiple);
+void DahuaPTZCamera::SetFocusFar(std::uint16_t multiple, std::chrono::milliseconds pulse_duration) {
+  trace::Span span("camera", "SetFocusFar");
+  std::lock_guard lock(command_mutex_);
+  auto error = http_iface_.SetFocusFar(multiple, pulse_duration);
   if (error) {
     throw std::system_error(error);
   }
 }
 
+void DahuaPTZCamera::UpdateState(const PTZCameraPosition& position, std::uint16_t zoom_multiple,
+                                 std::chrono::steady_clock::time_point command_time) {
+  {
+    std::lock_guard lock(state_mutex_);
+    current_position_ = position;
+    current_zoom_multiple_ = zoom_multiple;
+    last_move_time_ = command_time;
+  }
+  // the window in which frames are stamped as taken while moving, a later move cuts it short
+  trace::RecordAsync("camera", "settling", ++move_count_, command_time, command_time + settle_time_);
+  if (move_callback_) {
+    move_callback_(position, zoom_multiple);
+  }
+}
+
 PTZCameraPosition DahuaPTZCamera::GetCurrentPosition() const {
+  std::lock_guard lock(state_mutex_);
   return current_position_;
 }
 
 std::uint16_t DahuaPTZCamera::GetCurrentZoom() const {
+  std::lock_guard lock(state_mutex_);
   return current_zoom_multiple_;
 }
 
+bool DahuaPTZCamera::IsMoving(std::chrono::steady_clock::time_point at) const {
+  std::lock_guard lock(state_mutex_);
+  return at >= last_move_time_ and at < last_move_time_ + settle_time_;
+}
+
+std::uint16_t DahuaPTZCamera::GetMaxZoom() const { return max_zoom_; }
+
 CameraIntrinsics DahuaPTZCamera::GetIntrinsics() const {
-  return {
+  static const cv::Size calibration_size{Calibration::width, Calibration::height};
+  static const CameraIntrinsics calibration{
     cv::Matx33d{
-        2338.9152623521627,  0.,                  1297.4678987212778,
-        0.,                  2338.5344212108994,  743.3445529777781,
-        0.,                  0.,                 1.
+        Calibration::fx, 0.,              Calibration::cx,
+        0.,              Calibration::fy, Calibration::cy,
+        0.,              0.,              1.
     },
     {
       0.03413359728013275,
@@ -80,14 +163,80 @@ CameraIntrinsics DahuaPTZCamera::GetIntrinsics() const {
       -0.0020291504344734992
     }
   };
+  const auto stream_resolution = [this] {
+    std::lock_guard lock(state_mutex_);
+    return stream_resolution_;
+  }();
+  if (stream_resolution.empty() or stream_resolution == calibration_size) {
+    return calibration;
+  }
+  return calibration.ForResolution(calibration_size, stream_resolution);
+}
+
+StreamConfig DahuaPTZCamera::GetStreamConfig() {
+  std::lock_guard lock(command_mutex_);
+  const auto [error, config] = http_iface_.GetStreamConfig();
+  if (error) {
+    throw std::system_error(error);
+  }
+  return config;
+}
+
+void DahuaPTZCamera::SetStreamConfig(const StreamConfig& config) {
+  trace::Span span("camera", "SetStreamConfig");
+  std::lock_guard lock(command_mutex_);
+  auto error = http_iface_.SetStreamConfig(config);
+  if (error) {
+    throw std::system_error(error);
+  }
+  stream_reconfigured_ = true;
 }
 
 cv::Mat DahuaPTZCamera::GetNextFrame() {
+  WaitForStream();
   cv::Mat frame;
-  capture_ >> frame;
+  {
+    // the wait for the next RTSP packets and their decode
+    trace::Span span("capture", "GetNextFrame");
+    capture_ >> frame;
+  }
+  if (frame.empty() and stream_reconfigured_.exchange(false)) {
+    LOG(INFO) << "Stream interrupted by the encoder reconfiguration, reopening";
+    OpenStream();
+    capture_ >> frame;
+  }
   if (frame.empty()) {
     throw std::runtime_error("unable to get next frame");
   }
+  // a streaming camera takes no snapshots, so only the capture thread writes the resolution and it is compared
+  // without the lock
+  if (frame.size() != stream_resolution_) {
+    std::lock_guard lock(state_mutex_);
+    stream_resolution_ = frame.size();
+  }
+  return frame;
+}
+
+cv::Mat DahuaPTZCamera::GetSnapshot(int min_width) {
+  std::string jpeg;
+  {
+    std::lock_guard lock(command_mutex_);
+    auto [error, response] = http_iface_.GetSnapshot();
+    if (error) {
+      throw std::system_error(error);
+    }
+    jpeg = std::move(response);
+  }
+  cv::Mat frame;
+  {
+    trace::Span span("capture", "DecodeJPEG");
+    frame = DecodeJPEG(jpeg, min_width);
+  }
+  if (frame.empty()) {
+    throw std::runtime_error("unable to decode snapshot");
+  }
+  std::lock_guard lock(state_mutex_);
+  stream_resolution_ = frame.size();
   return frame;
 }
 
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <string>
 
 #include <opencv2/opencv.hpp>
@@ -17,31 +22,97 @@ struct PTZCameraPosition {
 
 namespace dahua {
 
+// Pinhole parameters of the main stream at 2592x1520 and the widest zoom, usable as compile-time intrinsics with
+// geometry::FixedPinhole.
+struct Calibration {
+  static constexpr int width = 2592;
+  static constexpr int height = 1520;
+  static constexpr double fx = 2338.9152623521627;
+  static constexpr double fy = 2338.5344212108994;
+  static constexpr double cx = 1297.4678987212778;
+  static constexpr double cy = 743.3445529777781;
+};
+
+enum class StreamOpening {
+  eager,      // in the constructor
+  background, // on a separate thread started by the constructor
+  lazy,       // on the first GetNextFrame call
+  none        // never, frames are fetched with GetSnapshot
+};
+
+// Commands may be issued from several threads, they are serialized on the single HTTP connection. The position and
+// zoom getters never wait for a command in flight, so the capture thread can stamp frames while the camera moves.
 class DahuaPTZCamera {
 public:
+  using MoveCallback = std::function<void(const PTZCameraPosition&, std::uint16_t zoom_multiple)>;
+
   DahuaPTZCamera(std::string user, std::string password, std::string host,
                  unsigned short port);
+  // max_zoom is the optical zoom range of the lens model
+  DahuaPTZCamera(std::string user, std::string password, std::string host, unsigned short port,
+                 StreamOpening stream_opening, std::uint16_t max_zoom = 32);
+
+  // Called after every accepted move command, on the thread which issued it. Must not block.
+  void SetMoveCallback(MoveCallback callback);
+  // Called after every CGI request of a command, on the thread which issued it. Must not block.
+  void SetRequestObserver(HTTPInterface::RequestObserver observer);
 
   void SetZoom(std::uint16_t multiple);
 
   void SetAbsolutePosition(const PTZCameraPosition& position);
   void SetAbsolutePosition(const PTZCameraPosition& position, std::uint16_t zoom_multiple);
 
-  void SetFocusNear(std::uint16_t multiple);
-  void SetFocusFar(std::uint16_t multiple);
+  void SetFocusNear(std::uint16_t multiple,
+                    std::chrono::milliseconds pulse_duration = std::chrono::milliseconds{100});
+  void SetFocusFar(std::uint16_t multiple,
+                   std::chrono::milliseconds pulse_duration = std::chrono::milliseconds{100});
 
   PTZCameraPosition GetCurrentPosition() const;
   std::uint16_t GetCurrentZoom() const;
+  std::uint16_t GetMaxZoom() const;
 
+  // Whether the head may still be slewing at the given time, i.e. a move was commanded less than the settle time
+  // before it.
+  bool IsMoving(std::chrono::steady_clock::time_point at) const;
+
+  // Of the frames the stream currently delivers.
   CameraIntrinsics GetIntrinsics() const;
 
+  StreamConfig GetStreamConfig();
+  // The camera restarts its encoder, so the stream is reopened if it breaks off after the change.
+  void SetStreamConfig(const StreamConfig& config);
+
   cv::Mat GetNextFrame();
 
+  // Fetches a JPEG over the command connection, so it waits for a command in flight, and decodes it at the smallest
+  // scale at least min_width wide. The intrinsics follow the decoded size, as for stream frames.
+  cv::Mat GetSnapshot(int min_width = 0);
+
+  // Blocks until the stream is open, rethrowing the failure to open it. Opens a lazy stream.
+  void WaitForStream();
+  std::chrono::milliseconds GetStreamOpenDuration() const;
+
 private:
+  void OpenStream();
+
+  void UpdateState(const PTZCameraPosition& position, std::uint16_t zoom_multiple,
+                   std::chrono::steady_clock::time_point command_time);
+
   cv::VideoCapture capture_;
   HTTPInterface http_iface_;
+  std::future<void> stream_ready_;
+  std::atomic<std::chrono::milliseconds::rep> stream_open_duration_{0};
+  std::mutex command_mutex_;
+  mutable std::mutex state_mutex_;
   PTZCameraPosition current_position_;
   std::uint16_t current_zoom_multiple_ = 0;
+  std::chrono::steady_clock::time_point last_move_time_;
+  const std::uint16_t max_zoom_;
+  std::chrono::milliseconds settle_time_{1500};
+  std::uint64_t move_count_ = 0;
+  MoveCallback move_callback_;
+  cv::Size stream_resolution_; // of the last decoded frame, guarded by state_mutex_
+  std::atomic<bool> stream_reconfigured_{false};
 };
 
 }} // namespace tpxai::dahua
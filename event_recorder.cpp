@@ -0,0 +1,207 @@
+#include "event_recorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+
+#include <glog/logging.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace tpxai {
+
+namespace {
+
+std::string MakeRecordingPath(const std::string& directory, std::uint64_t recording) {
+  const auto now = std::time(nullptr);
+  std::tm local_time{};
+  localtime_r(&now, &local_time);
+  char timestamp[32];
+  std::strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", &local_time);
+  return directory + "/event_" + timestamp + "_" + std::to_string(recording) + ".mjpeg";
+}
+
+} // anonymous namespace
+
+EventRecorder::EventRecorder(EventRecorderSettings settings)
+    : settings_{std::move(settings)},
+      encode_params_{cv::IMWRITE_JPEG_QUALITY, settings_.jpeg_quality},
+      writer_{&EventRecorder::WriterLoop, this} {}
+
+EventRecorder::~EventRecorder() {
+  {
+    std::lock_guard lock(mutex_);
+    if (recording_active_) {
+      jobs_.push_back(WriteJob{recording_, {}, {}, true});
+    }
+    stop_ = true;
+  }
+  jobs_available_.notify_one();
+  writer_.join();
+}
+
+void EventRecorder::OnFrame(const Frame& frame) {
+  if (frame.image.empty()) {
+    return;
+  }
+  const cv::Mat* source = &frame.image;
+  if (frame.image.cols > settings_.frame_width) {
+    const double scale = static_cast<double>(settings_.frame_width) / frame.image.cols;
+    cv::resize(frame.image, resized_, cv::Size(), scale, scale, cv::INTER_AREA);
+    source = &resized_;
+  }
+  auto encoded = std::make_shared<EncodedFrame>();
+  encoded->capture_time = frame.capture_time;
+  cv::imencode(".jpg", *source, encoded->jpeg, encode_params_);
+  const auto capture_time = encoded->capture_time;
+
+  std::lock_guard lock(mutex_);
+  ring_bytes_ += encoded->jpeg.size();
+  ring_.push_back(encoded);
+  while (ring_.size() > 1 and
+         (ring_bytes_ > settings_.memory_limit or ring_.front()->capture_time < capture_time - settings_.pre_roll)) {
+    ring_bytes_ -= ring_.front()->jpeg.size();
+    ring_.pop_front();
+  }
+
+  if (not pending_trigger_.empty()) {
+    recording_end_ = capture_time + settings_.post_roll;
+    if (not recording_active_) {
+      recording_active_ = true;
+      recording_++;
+      const auto path = MakeRecordingPath(settings_.output_directory, recording_);
+      LOG(INFO) << "Recording event '" << pending_trigger_ << "' to " << path;
+      // the ring holds shared pointers, so the pre-roll is handed to the writer without copying the JPEGs
+      Enqueue(WriteJob{recording_, path, {ring_.begin(), ring_.end()}, false});
+      pending_trigger_.clear();
+      return;
+    }
+    pending_trigger_.clear();
+  }
+
+  if (recording_active_) {
+    if (capture_time <= recording_end_) {
+      Enqueue(WriteJob{recording_, {}, {std::move(encoded)}, false});
+    } else {
+      Enqueue(WriteJob{recording_, {}, {}, true});
+      recording_active_ = false;
+    }
+  }
+}
+
+void EventRecorder::Trigger(const std::string& reason) {
+  std::lock_guard lock(mutex_);
+  pending_trigger_ = reason.empty() ? "api" : reason;
+}
+
+void EventRecorder::Enqueue(WriteJob job) {
+  std::size_t bytes = 0;
+  for (const auto& frame : job.frames) {
+    bytes += frame->jpeg.size();
+  }
+  if (pending_bytes_ + bytes > settings_.max_pending_bytes) {
+    dropped_frames_ += job.frames.size();
+    LOG_EVERY_N(WARNING, 30) << "Event recorder cannot keep up with the disk, dropping frames";
+    job.frames.clear();
+    bytes = 0;
+  }
+  pending_bytes_ += bytes;
+  jobs_.push_back(std::move(job));
+  jobs_available_.notify_one();
+}
+
+void EventRecorder::WriterLoop() {
+  std::FILE* file = nullptr;
+  std::vector<unsigned char> block;
+  block.reserve(settings_.write_block_size);
+  std::uint64_t recording_bytes = 0;
+  std::uint64_t recording_frames = 0;
+
+  auto flush = [&] {
+    if (block.empty() or not file) {
+      block.clear();
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto written = std::fwrite(block.data(), 1, block.size(), file);
+    const auto duration = std::chrono::steady_clock::now() - start;
+    if (written != block.size()) {
+      LOG(ERROR) << "Event recording write failed";
+    }
+    std::lock_guard lock(mutex_);
+    written_bytes_ += written;
+    write_time_ += duration;
+    block.clear();
+  };
+
+  while (true) {
+    WriteJob job;
+    {
+      std::unique_lock lock(mutex_);
+      jobs_available_.wait(lock, [this] { return stop_ or not jobs_.empty(); });
+      if (jobs_.empty()) {
+        break;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    if (not job.path.empty()) {
+      file = std::fopen(job.path.c_str(), "wb");
+      if (not file) {
+        PLOG(ERROR) << "Unable to create " << job.path;
+      } else {
+        std::setvbuf(file, nullptr, _IONBF, 0);
+      }
+      recording_bytes = recording_frames = 0;
+    }
+
+    std::size_t job_bytes = 0;
+    for (const auto& frame : job.frames) {
+      job_bytes += frame->jpeg.size();
+      block.insert(block.end(), frame->jpeg.begin(), frame->jpeg.end());
+      if (block.size() >= settings_.write_block_size) {
+        flush();
+      }
+    }
+    recording_bytes += job_bytes;
+    recording_frames += job.frames.size();
+    {
+      std::lock_guard lock(mutex_);
+      pending_bytes_ -= job_bytes;
+    }
+
+    if (job.last) {
+      flush();
+      if (file) {
+        std::fclose(file);
+        file = nullptr;
+      }
+      std::lock_guard lock(mutex_);
+      recordings_++;
+      LOG(INFO) << "Event recording " << job.recording << " finished: " << recording_frames << " frames, "
+                << recording_bytes << " bytes, " << dropped_frames_ << " frames dropped so far, ring "
+                << ring_bytes_ << " bytes, write throughput "
+                << (write_time_.count() ? written_bytes_ * 1e3 / write_time_.count() : 0) << " MB/s";
+    }
+  }
+  flush();
+  if (file) {
+    std::fclose(file);
+  }
+}
+
+EventRecorderStats EventRecorder::GetStats() const {
+  std::lock_guard lock(mutex_);
+  EventRecorderStats stats;
+  stats.ring_bytes = ring_bytes_;
+  stats.ring_frames = ring_.size();
+  stats.pending_bytes = pending_bytes_;
+  stats.dropped_frames = dropped_frames_;
+  stats.written_bytes = written_bytes_;
+  stats.recordings = recordings_;
+  stats.write_throughput = write_time_.count() ? written_bytes_ * 1e9 / write_time_.count() : 0;
+  return stats;
+}
+
+} // namespace tpxai
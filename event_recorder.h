@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+
+namespace tpxai {
+
+struct EventRecorderSettings {
+  std::string output_directory = ".";
+  std::chrono::milliseconds pre_roll{5000};
+  std::chrono::milliseconds post_roll{5000};
+  int frame_width = 960; // recorded frames are downscaled to this width
+  int jpeg_quality = 80;
+  std::size_t memory_limit = 64 << 20;       // bytes of encoded frames kept in the pre-roll ring
+  std::size_t max_pending_bytes = 128 << 20; // bytes queued for the writer before frames are dropped
+  std::size_t write_block_size = 4 << 20;
+};
+
+struct EventRecorderStats {
+  std::size_t ring_bytes = 0;
+  std::size_t ring_frames = 0;
+  std::size_t pending_bytes = 0;
+  std::uint64_t dropped_frames = 0;
+  std::uint64_t written_bytes = 0;
+  std::uint64_t recordings = 0;
+  double write_throughput = 0; // bytes per second spent in write calls
+};
+
+// Keeps the last seconds of frames, JPEG-compressed and downscaled, in a bounded in-memory ring. A trigger flushes
+// that pre-roll and the following post-roll into an MJPEG file (play with `ffplay -f mjpeg`). Encoding runs on the
+// thread calling OnFrame, which should be a dedicated frame consumer, and all disk I/O runs on the recorder's own
+// writer thread in large sequential blocks, so neither the capture nor the UI ever waits for the disk. When the disk
+// cannot keep up, frames are dropped instead of growing the queue.
+class EventRecorder {
+public:
+  explicit EventRecorder(EventRecorderSettings settings = {});
+  ~EventRecorder();
+
+  EventRecorder(const EventRecorder&) = delete;
+  EventRecorder& operator=(const EventRecorder&) = delete;
+
+  void OnFrame(const Frame& frame);
+
+  // Thread-safe and non-blocking. A trigger during an ongoing recording extends its post-roll.
+  void Trigger(const std::string& reason);
+
+  EventRecorderStats GetStats() const;
+
+private:
+  struct EncodedFrame {
+    std::chrono::steady_clock::time_point capture_time;
+    std::vector<unsigned char> jpeg;
+  };
+  using SharedEncodedFrame = std::shared_ptr<const EncodedFrame>;
+
+  struct WriteJob {
+    std::uint64_t recording = 0;
+    std::string path;      // set for the first job of a recording
+    std::vector<SharedEncodedFrame> frames;
+    bool last = false;
+  };
+
+  void Enqueue(WriteJob job);
+  void WriterLoop();
+
+  const EventRecorderSettings settings_;
+  std::vector<int> encode_params_;
+  cv::Mat resized_;
+
+  mutable std::mutex mutex_;
+  std::deque<SharedEncodedFrame> ring_;
+  std::size_t ring_bytes_ = 0;
+  std::string pending_trigger_;
+  std::uint64_t recording_ = 0;
+  bool recording_active_ = false;
+  std::chrono::steady_clock::time_point recording_end_;
+  std::uint64_t dropped_frames_ = 0;
+
+  std::condition_variable jobs_available_;
+  std::deque<WriteJob> jobs_;
+  std::size_t pending_bytes_ = 0;
+  bool stop_ = false;
+  std::uint64_t written_bytes_ = 0;
+  std::uint64_t recordings_ = 0;
+  std::chrono::nanoseconds write_time_{0};
+
+  std::thread writer_;
+};
+
+} // namespace tpxai
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include <opencv2/core.hpp>
+
+#include "dahua_ptz_camera.h"
+
+namespace tpxai {
+
+// A decoded frame together with the state of the camera at capture time. Frames are shared between consumers
+// through SharedFrame, so the pixels must be treated as read-only: draw on a copy or on a derived image.
+struct Frame {
+  cv::Mat image;
+  std::uint64_t sequence = 0;
+  std::chrono::steady_clock::time_point capture_time;
+  PTZCameraPosition position;
+  std::uint16_t zoom_multiple = 0;
+  bool camera_moving = false;
+};
+
+using SharedFrame = std::shared_ptr<const Frame>;
+
+} // namespace tpxai
@@ -0,0 +1,154 @@
+#include "frame_bus.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+namespace tpxai {
+
+FrameSubscription::FrameSubscription(std::size_t capacity, BackpressurePolicy policy,
+                                     metrics::Counter* dropped_frames_counter)
+    : policy_{policy}, ring_(std::max<std::size_t>(capacity, 1)), dropped_frames_counter_{dropped_frames_counter} {}
+
+void FrameSubscription::CountDroppedFrame() {
+  dropped_frames_++;
+  if (dropped_frames_counter_) {
+    dropped_frames_counter_->Add();
+  }
+}
+
+void FrameSubscription::Push(const SharedFrame& frame) {
+  std::unique_lock lock(mutex_);
+  if (size_ == ring_.size()) {
+    switch (policy_) {
+      case BackpressurePolicy::drop_oldest:
+        ring_[head_].reset();
+        head_ = (head_ + 1) % ring_.size();
+        size_--;
+        CountDroppedFrame();
+        break;
+      case BackpressurePolicy::drop_newest:
+        CountDroppedFrame();
+        return;
+      case BackpressurePolicy::block:
+        not_full_.wait(lock, [this] { return size_ < ring_.size() or closed_; });
+        if (closed_) {
+          return;
+        }
+        break;
+    }
+  }
+  ring_[(head_ + size_) % ring_.size()] = frame;
+  size_++;
+  lock.unlock();
+  not_empty_.notify_one();
+}
+
+SharedFrame FrameSubscription::Pop() {
+  std::unique_lock lock(mutex_);
+  not_empty_.wait(lock, [this] { return size_ > 0 or closed_; });
+  return TakeFront(lock);
+}
+
+SharedFrame FrameSubscription::TryPop() {
+  std::unique_lock lock(mutex_);
+  return TakeFront(lock);
+}
+
+SharedFrame FrameSubscription::TakeFront(std::unique_lock<std::mutex>& lock) {
+  if (size_ == 0) {
+    return nullptr;
+  }
+  auto frame = std::move(ring_[head_]);
+  head_ = (head_ + 1) % ring_.size();
+  size_--;
+  lock.unlock();
+  not_full_.notify_one();
+  return frame;
+}
+
+void FrameSubscription::Close() {
+  {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+  }
+  not_empty_.notify_all();
+  not_full_.notify_all();
+}
+
+std::shared_ptr<FrameSubscription> FrameBus::Subscribe(std::size_t capacity, BackpressurePolicy policy,
+                                                       metrics::Counter* dropped_frames_counter) {
+  auto subscription = std::make_shared<FrameSubscription>(capacity, policy, dropped_frames_counter);
+  std::lock_guard lock(mutex_);
+  if (closed_) {
+    subscription->Close();
+    return subscription;
+  }
+  // subscribers are copied on write, so Publish only takes a reference to the current list
+  auto subscribers = std::make_shared<Subscribers>(*subscribers_);
+  subscribers->push_back(subscription);
+  subscribers_ = std::move(subscribers);
+  return subscription;
+}
+
+void FrameBus::Unsubscribe(const std::shared_ptr<FrameSubscription>& subscription) {
+  {
+    std::lock_guard lock(mutex_);
+    auto subscribers = std::make_shared<Subscribers>(*subscribers_);
+    subscribers->erase(std::remove(subscribers->begin(), subscribers->end(), subscription), subscribers->end());
+    subscribers_ = std::move(subscribers);
+  }
+  subscription->Close();
+}
+
+std::shared_ptr<const FrameBus::Subscribers> FrameBus::GetSubscribers() const {
+  std::lock_guard lock(mutex_);
+  return subscribers_;
+}
+
+void FrameBus::Publish(SharedFrame frame) {
+  DCHECK(frame);
+  const auto subscribers = GetSubscribers();
+  for (const auto& subscription : *subscribers) {
+    subscription->Push(frame);
+  }
+  published_frames_++;
+}
+
+void FrameBus::Close() {
+  std::shared_ptr<const Subscribers> subscribers;
+  {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    subscribers = subscribers_;
+  }
+  for (const auto& subscription : *subscribers) {
+    subscription->Close();
+  }
+}
+
+bool FrameBus::IsClosed() const {
+  std::lock_guard lock(mutex_);
+  return closed_;
+}
+
+FrameConsumer::FrameConsumer(FrameBus& bus, std::size_t capacity, BackpressurePolicy policy, Callback callback,
+                             metrics::Counter* dropped_frames_counter)
+    : bus_{bus}, subscription_{bus.Subscribe(capacity, policy, dropped_frames_counter)} {
+  thread_ = std::thread([subscription = subscription_, callback = std::move(callback)] {
+    while (auto frame = subscription->Pop()) {
+      try {
+        callback(frame);
+      } catch (std::exception& e) {
+        LOG(ERROR) << "Frame consumer failed: " << e.what();
+      }
+    }
+  });
+}
+
+FrameConsumer::~FrameConsumer() {
+  bus_.Unsubscribe(subscription_);
+  thread_.join();
+}
+
+} // namespace tpxai
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame.h"
+#include "metrics.h"
+
+namespace tpxai {
+
+enum class BackpressurePolicy {
+  drop_oldest, // a full queue discards its oldest frame, consumers always see the newest frames
+  drop_newest, // a full queue rejects the published frame, consumers see an unbroken but stale sequence
+  block        // a full queue stalls the publisher until the consumer catches up, see FrameBus
+};
+
+// Bounded queue of frames owned by a single consumer. The storage is allocated once, so pushing a frame copies no
+// image data; it takes the queue mutex, increments the reference count of the shared frame and notifies the consumer.
+class FrameSubscription {
+public:
+  // dropped frames are also added to the given counter, if any
+  FrameSubscription(std::size_t capacity, BackpressurePolicy policy,
+                    metrics::Counter* dropped_frames_counter = nullptr);
+
+  // Blocks until a frame is available. Returns nullptr once the subscription is closed and drained.
+  SharedFrame Pop();
+  SharedFrame TryPop();
+
+  BackpressurePolicy GetPolicy() const { return policy_; }
+  std::uint64_t GetDroppedFrames() const { return dropped_frames_; }
+
+private:
+  friend class FrameBus;
+
+  void Push(const SharedFrame& frame);
+  void Close();
+  void CountDroppedFrame();
+  SharedFrame TakeFront(std::unique_lock<std::mutex>& lock);
+
+  const BackpressurePolicy policy_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::vector<SharedFrame> ring_;
+  std::size_t head_ = 0;
+  std::size_t size_ = 0;
+  bool closed_ = false;
+  std::atomic<std::uint64_t> dropped_frames_{0};
+  metrics::Counter* const dropped_frames_counter_;
+};
+
+// Broadcasts every published frame to all subscribers. Each subscriber gets the same immutable frame, so the decode
+// happens once no matter how many consumers are attached. Publish pushes to the subscribers one after another on the
+// publishing thread, so a single slow subscriber with the block policy stalls Publish, and with it the capture thread
+// and every other consumer of the bus. The block policy is only meant for consumers which must see every frame and
+// keep up with the stream.
+class FrameBus {
+public:
+  std::shared_ptr<FrameSubscription> Subscribe(std::size_t capacity, BackpressurePolicy policy,
+                                               metrics::Counter* dropped_frames_counter = nullptr);
+  void Unsubscribe(const std::shared_ptr<FrameSubscription>& subscription);
+
+  void Publish(SharedFrame frame);
+
+  // Wakes all consumers, which receive nullptr after draining their queues.
+  void Close();
+  bool IsClosed() const;
+
+  std::uint64_t GetPublishedFrames() const { return published_frames_; }
+
+private:
+  using Subscribers = std::vector<std::shared_ptr<FrameSubscription>>;
+
+  std::shared_ptr<const Subscribers> GetSubscribers() const;
+
+  mutable std::mutex mutex_;
+  std::shared_ptr<const Subscribers> subscribers_ = std::make_shared<const Subscribers>();
+  bool closed_ = false;
+  std::atomic<std::uint64_t> published_frames_{0};
+};
+
+// Runs the given callback for every frame of its own subscription on a dedicated thread.
+class FrameConsumer {
+public:
+  using Callback = std::function<void(const SharedFrame&)>;
+
+  FrameConsumer(FrameBus& bus, std::size_t capacity, BackpressurePolicy policy, Callback callback,
+                metrics::Counter* dropped_frames_counter = nullptr);
+  ~FrameConsumer();
+
+  FrameConsumer(const FrameConsumer&) = delete;
+  FrameConsumer& operator=(const FrameConsumer&) = delete;
+
+  const FrameSubscription& GetSubscription() const { return *subscription_; }
+
+private:
+  FrameBus& bus_;
+  std::shared_ptr<FrameSubscription> subscription_;
+  std::thread thread_;
+};
+
+} // namespace tpxai
@@ -0,0 +1,85 @@
+#include "frame_undistorter.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <glog/logging.h>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace tpxai {
+
+namespace {
+
+bool SameCalibration(const CameraIntrinsics& lhs, const CameraIntrinsics& rhs) {
+  return std::equal(std::begin(lhs.K.val), std::end(lhs.K.val), std::begin(rhs.K.val)) and
+         lhs.distortion_coeffs == rhs.distortion_coeffs;
+}
+
+} // anonymous namespace
+
+FrameUndistorter::FrameUndistorter(std::size_t max_cached_maps)
+    : max_cached_maps_{std::max<std::size_t>(max_cached_maps, 1)} {}
+
+void FrameUndistorter::Undistort(const cv::Mat& frame, cv::Mat& output, const CameraIntrinsics& intrinsics,
+                                 std::uint16_t zoom_multiple, cv::Size output_size) {
+  if (output_size.empty()) {
+    output_size = frame.size();
+  }
+  const auto& maps = GetMaps(frame.size(), output_size, intrinsics, zoom_multiple);
+  cv::remap(frame, output, maps.map1, maps.map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+}
+
+cv::Mat FrameUndistorter::Undistort(const cv::Mat& frame, const CameraIntrinsics& intrinsics,
+                                    std::uint16_t zoom_multiple, cv::Size output_size) {
+  cv::Mat output;
+  Undistort(frame, output, intrinsics, zoom_multiple, output_size);
+  return output;
+}
+
+const FrameUndistorter::Maps& FrameUndistorter::GetMaps(const cv::Size& input_size, const cv::Size& output_size,
+                                                        const CameraIntrinsics& intrinsics,
+                                                        std::uint16_t zoom_multiple) {
+  if (not SameCalibration(calibration_, intrinsics)) {
+    cache_.clear();
+    calibration_ = intrinsics;
+  }
+
+  auto it = std::find_if(cache_.begin(), cache_.end(), [&](const Maps& maps) {
+    return maps.input_size == input_size and maps.output_size == output_size and maps.zoom_multiple == zoom_multiple;
+  });
+  if (it != cache_.end()) {
+    std::rotate(it, it + 1, cache_.end());
+    return cache_.back();
+  }
+
+  if (cache_.size() >= max_cached_maps_) {
+    cache_.erase(cache_.begin());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  Maps maps{input_size, output_size, zoom_multiple, {}, {}};
+
+  const auto zoomed = intrinsics.ForZoom(zoom_multiple);
+  const double scale_x = static_cast<double>(output_size.width) / input_size.width;
+  const double scale_y = static_cast<double>(output_size.height) / input_size.height;
+  cv::Matx33d output_K = zoomed.K;
+  output_K(0, 0) *= scale_x;
+  output_K(0, 2) *= scale_x;
+  output_K(1, 1) *= scale_y;
+  output_K(1, 2) *= scale_y;
+
+  cv::initUndistortRectifyMap(zoomed.K, zoomed.distortion_coeffs, cv::Matx33d::eye(), output_K, output_size, CV_16SC2,
+                              maps.map1, maps.map2);
+
+  LOG(INFO) << "Undistortion maps for " << input_size.width << "x" << input_size.height << " -> "
+            << output_size.width << "x" << output_size.height << " at zoom x" << zoom_multiple << " built in "
+            << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()
+            << " us";
+
+  built_maps_++;
+  cache_.push_back(std::move(maps));
+  return cache_.back();
+}
+
+} // namespace tpxai
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "camera_intrinsics.h"
+
+namespace tpxai {
+
+// Removes the lens distortion from frames using remap tables which are built once per input resolution, output
+// resolution and zoom level and cached until the calibration changes. The tables are kept in the compact fixed-point
+// CV_16SC2 + CV_16UC1 form which lets cv::remap run its vectorized, multithreaded path.
+//
+// When the output size is smaller than the input the downscaling is fused into the same remap pass: the output
+// camera matrix is the input one scaled by the size ratio, so a pixel of the output divided by that ratio is the
+// undistorted full-resolution pixel.
+//
+// The distortion is only calibrated at the widest zoom. Zoomed frames are undistorted with those coefficients and the
+// zoomed camera matrix, so the correction fades as the field of view narrows. That is close to the lens for moderate
+// zoom but does not model a distortion which changes its shape while zooming, e.g. turns into pincushion.
+class FrameUndistorter {
+public:
+  explicit FrameUndistorter(std::size_t max_cached_maps = 8);
+
+  void Undistort(const cv::Mat& frame, cv::Mat& output, const CameraIntrinsics& intrinsics,
+                 std::uint16_t zoom_multiple, cv::Size output_size = {});
+
+  cv::Mat Undistort(const cv::Mat& frame, const CameraIntrinsics& intrinsics, std::uint16_t zoom_multiple,
+                    cv::Size output_size = {});
+
+  // maps built so far, i.e. cache misses
+  std::uint64_t GetBuiltMaps() const { return built_maps_; }
+
+private:
+  struct Maps {
+    cv::Size input_size;
+    cv::Size output_size;
+    std::uint16_t zoom_multiple = 0;
+    cv::Mat map1; // fixed-point integer coordinates
+    cv::Mat map2; // interpolation table indices
+  };
+
+  const Maps& GetMaps(const cv::Size& input_size, const cv::Size& output_size, const CameraIntrinsics& intrinsics,
+                      std::uint16_t zoom_multiple);
+
+  std::size_t max_cached_maps_;
+  CameraIntrinsics calibration_;
+  std::vector<Maps> cache_; // most recently used last
+  std::uint64_t built_maps_ = 0;
+};
+
+} // namespace tpxai
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cmath>
+
+#include <Eigen/Core>
+#include <opencv2/core/matx.hpp>
+
+namespace tpxai::geometry {
+
+// The pan-tilt geometry of the head, header-only and templated on the scalar type: float is the fast path, double
+// the accurate one. Axes follow the camera frame: x to the right, y down, z along the optical axis. The tilt is a
+// rotation about x and the pan about y, both in degrees and signed like the PositionABS arguments.
+
+template <typename Scalar>
+constexpr Scalar pi = static_cast<Scalar>(3.14159265358979323846264338327950288L);
+
+template <typename Scalar>
+constexpr Scalar DegreesToRadians(Scalar degrees) noexcept {
+  return degrees * (pi<Scalar> / 180);
+}
+
+template <typename Scalar>
+constexpr Scalar RadiansToDegrees(Scalar radians) noexcept {
+  return radians * (180 / pi<Scalar>);
+}
+
+template <typename Scalar>
+using Vector2 = Eigen::Matrix<Scalar, 2, 1>;
+template <typename Scalar>
+using Vector3 = Eigen::Matrix<Scalar, 3, 1>;
+template <typename Scalar>
+using Matrix3 = Eigen::Matrix<Scalar, 3, 3>;
+
+// Pinhole intrinsics known at run time, e.g. scaled for the current zoom and stream resolution.
+template <typename Scalar>
+class Pinhole {
+public:
+  explicit Pinhole(const cv::Matx33d& K)
+      : inverse_fx_{static_cast<Scalar>(1 / K(0, 0))}, inverse_fy_{static_cast<Scalar>(1 / K(1, 1))},
+        cx_{static_cast<Scalar>(K(0, 2))}, cy_{static_cast<Scalar>(K(1, 2))} {}
+
+  // the ray through the pixel, on the z = 1 plane
+  Vector3<Scalar> Unproject(Scalar u, Scalar v) const { return {(u - cx_) * inverse_fx_, (v - cy_) * inverse_fy_, 1}; }
+
+private:
+  Scalar inverse_fx_;
+  Scalar inverse_fy_;
+  Scalar cx_;
+  Scalar cy_;
+};
+
+// Pinhole intrinsics fixed at compile time by a Calibration type with static constexpr double fx, fy, cx and cy, so
+// that unprojecting a pixel is two multiply-adds with constant operands. Only valid for the calibrated zoom and
+// resolution.
+template <typename Scalar, typename Calibration>
+class FixedPinhole {
+public:
+  static constexpr Scalar inverse_fx = static_cast<Scalar>(1 / Calibration::fx);
+  static constexpr Scalar inverse_fy = static_cast<Scalar>(1 / Calibration::fy);
+  static constexpr Scalar cx = static_cast<Scalar>(Calibration::cx);
+  static constexpr Scalar cy = static_cast<Scalar>(Calibration::cy);
+
+  static Vector3<Scalar> Unproject(Scalar u, Scalar v) { return {(u - cx) * inverse_fx, (v - cy) * inverse_fy, 1}; }
+};
+
+// Rotation from the frame of a camera at the given pose to the frame of the camera at the zero pose, i.e.
+// pan(-pan) * tilt(-tilt) written out so that only two sines and two cosines are evaluated.
+template <typename Scalar>
+Matrix3<Scalar> CameraToWorldRotation(Scalar tilt_degrees, Scalar pan_degrees) {
+  const Scalar tilt = DegreesToRadians(-tilt_degrees);
+  const Scalar pan = DegreesToRadians(-pan_degrees);
+  const Scalar st = std::sin(tilt);
+  const Scalar ct = std::cos(tilt);
+  const Scalar sp = std::sin(pan);
+  const Scalar cp = std::cos(pan);
+  Matrix3<Scalar> rotation;
+  rotation << cp, sp * st, sp * ct,
+              0, ct, -st,
+              -sp, cp * st, cp * ct;
+  return rotation;
+}
+
+// Tilt and pan in degrees, the pan in <0, 360), which point the optical axis along the given world direction.
+template <typename Scalar>
+Vector2<Scalar> DirectionToPose(const Vector3<Scalar>& direction) {
+  const Scalar tilt = std::atan2(direction[1], std::sqrt(direction[0] * direction[0] + direction[2] * direction[2]));
+  Scalar pan = -std::atan2(direction[0], direction[2]);
+  if (pan < 0) {
+    pan += 2 * pi<Scalar>;
+  }
+  return {RadiansToDegrees(tilt), RadiansToDegrees(pan)};
+}
+
+// The unit world direction of the optical axis at the given pose, the inverse of DirectionToPose.
+template <typename Scalar>
+Vector3<Scalar> PoseToDirection(Scalar tilt_degrees, Scalar pan_degrees) {
+  const Scalar tilt = DegreesToRadians(tilt_degrees);
+  const Scalar pan = DegreesToRadians(pan_degrees);
+  return {-std::cos(tilt) * std::sin(pan), std::sin(tilt), std::cos(tilt) * std::cos(pan)};
+}
+
+// Maps pixels of a frame taken at one pose to the poses which center them. The rotation is computed once per pose,
+// so mapping many pixels, e.g. the detections of a frame, costs a matrix-vector product and two arctangents each.
+template <typename Scalar, typename Intrinsics = Pinhole<Scalar>>
+class PoseProjector {
+public:
+  PoseProjector(Intrinsics intrinsics, Scalar tilt_degrees, Scalar pan_degrees)
+      : intrinsics_{intrinsics}, camera_to_world_{CameraToWorldRotation(tilt_degrees, pan_degrees)} {}
+
+  // tilt and pan in degrees
+  Vector2<Scalar> Target(Scalar u, Scalar v) const {
+    return DirectionToPose<Scalar>(camera_to_world_ * intrinsics_.Unproject(u, v));
+  }
+
+  const Matrix3<Scalar>& GetCameraToWorld() const { return camera_to_world_; }
+
+private:
+  Intrinsics intrinsics_;
+  Matrix3<Scalar> camera_to_world_;
+};
+
+} // namespace tpxai::geometry
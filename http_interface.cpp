@@ -1,8 +1,11 @@
 #include "http_interface.h"
 
+#include <algorithm>
 #include <charconv>
 #include <chrono>
+#include <cstring>
 #include <iomanip>
+#include <iterator>
 #include <limits>
 #include <sstream>
 #include <string_view>
@@ -17,15 +20,56 @@
 #include "curl_error_category.h"
 #include "dahua_error_category.h"
 #include "dahua_ptz_camera.h"
+#include "trace.h"
 
 namespace tpxai::dahua {
 
-HTTPInterface::HTTPInterface(std::string user, std::string password, std::string host, unsigned short port)
-    : user_password_{user + ":" + password}, host_{std::move(host)}, port_{port}, curl_{curl_easy_init(),
-                                                                                        &curl_easy_cleanup} {
+namespace {
+
+// curl_global_init is not thread safe, while cameras are started on several threads at once. Leaving it to the first
+// curl_easy_init would race, so it runs exactly once, guarded by the initialization of a function-local static, and
+// is undone with curl_global_cleanup at exit.
+class CURLGlobal {
+public:
+  CURLGlobal() { CHECK(curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK); }
+  ~CURLGlobal() { curl_global_cleanup(); }
+
+  CURLGlobal(const CURLGlobal&) = delete;
+  CURLGlobal& operator=(const CURLGlobal&) = delete;
+};
+
+CURL* CreateEasyHandle() {
+  static const CURLGlobal global;
+  return curl_easy_init();
+}
+
+} // anonymous namespace
+
+HTTPInterface::HTTPInterface(std::string user, std::string password, std::string host, unsigned short port,
+                             RequestPolicySettings policy)
+    : user_password_{user + ":" + password}, host_{std::move(host)}, port_{port},
+      curl_{CreateEasyHandle(), &curl_easy_cleanup}, policy_{policy}, latency_{policy.timeouts},
+      circuit_breaker_{policy.circuit_breaker}, rng_{std::random_device{}()},
+      position_abs_metrics_{RegisterRequestMetrics("PositionABS")},
+      focus_near_metrics_{RegisterRequestMetrics("FocusNear")}, focus_far_metrics_{RegisterRequestMetrics("FocusFar")},
+      encode_config_metrics_{RegisterRequestMetrics("getConfig")},
+      set_encode_config_metrics_{RegisterRequestMetrics("setConfig")},
+      device_type_metrics_{RegisterRequestMetrics("getDeviceType")},
+      snapshot_metrics_{RegisterRequestMetrics("snapshot")} {
   CHECK(curl_);
 }
 
+HTTPInterface::~HTTPInterface() {
+  {
+    std::lock_guard lock(probe_mutex_);
+    stopping_ = true;
+  }
+  probe_wakeup_.notify_all();
+  if (probe_thread_.joinable()) {
+    probe_thread_.join();
+  }
+}
+
 std::string HTTPInterface::GetStreamingURL() const {
   std::ostringstream ss;
   ss << "rtsp://" << user_password_ << "@" << host_ << ":" << port_ << "/cam/realmonitor?channel=1&subtype=0";
@@ -33,7 +77,8 @@ std::string HTTPInterface::GetStreamingURL() const {
 }
 
 std::error_code HTTPInterface::GoToABSPosition(const PTZCameraPosition& position, std::uint16_t zoom_multiple) {
-  const auto [error, response] = HTTPGetRequest(CreateGoToABSPositionURL(position, zoom_multiple));
+  const auto [error, response] = HTTPGetRequest(CreateGoToABSPositionURL(position, zoom_multiple), Retry::forbidden,
+                                                position_abs_metrics_);
   if (not error) {
     return make_error_code(response == "OK" ? DahuaErrorCode::ok : DahuaErrorCode::error);
   }
@@ -42,7 +87,8 @@ std::error_code HTTPInterface::GoToABSPosition(const PTZCameraPosition& position
 
 std::pair<std::error_code, cv::Size> HTTPInterface::GetResolution() {
   std::pair<std::error_code, cv::Size> result;
-  const auto [error, response] = HTTPGetRequest(CreateGetVideoEncodeConfigURL());
+  const auto [error, response] =
+      HTTPGetRequest(CreateGetVideoEncodeConfigURL(), Retry::allowed, encode_config_metrics_);
   if (error) {
     result.first = error;
     return result;
@@ -70,7 +116,8 @@ std::pair<std::error_code, cv::Size> HTTPInterface::GetResolution() {
 
 std::pair<std::error_code, std::uint16_t> HTTPInterface::GetFrameRate() {
   std::pair<std::error_code, std::uint16_t> result;
-  const auto [error, response] = HTTPGetRequest(CreateGetVideoEncodeConfigURL());
+  const auto [error, response] =
+      HTTPGetRequest(CreateGetVideoEncodeConfigURL(), Retry::allowed, encode_config_metrics_);
   if (error) {
     result.first = error;
   } else {
@@ -88,7 +135,7 @@ std::pair<std::error_code, std::uint16_t> HTTPInterface::GetFrameRate() {
 
 std::pair<std::error_code, std::string> HTTPInterface::GetDeviceType() {
   std::pair<std::error_code, std::string> result;
-  const auto [error, response] = HTTPGetRequest(CreateGetDeviceTypeURL());
+  const auto [error, response] = HTTPGetRequest(CreateGetDeviceTypeURL(), Retry::allowed, device_type_metrics_);
   if (error) {
     result.first = error;
   } else {
@@ -102,10 +149,63 @@ std::pair<std::error_code, std::string> HTTPInterface::GetDeviceType() {
   return result;
 }
 
+std::pair<std::error_code, StreamConfig> HTTPInterface::GetStreamConfig() {
+  std::pair<std::error_code, StreamConfig> result;
+  const auto [error, response] =
+      HTTPGetRequest(CreateGetVideoEncodeConfigURL(), Retry::allowed, encode_config_metrics_);
+  if (error) {
+    result.first = error;
+    return result;
+  }
+  static const char* const options[] = {
+      "table.Encode[0].MainFormat[0].Video.Width=", "table.Encode[0].MainFormat[0].Video.Height=",
+      "table.Encode[0].MainFormat[0].Video.FPS=", "table.Encode[0].MainFormat[0].Video.GOP="};
+  int values[std::size(options)] = {};
+  for (std::size_t i = 0; i < std::size(options); i++) {
+    const auto [error, option_value] = ExtractNumericOptionValueFromMultiline(response, options[i]);
+    if (error) {
+      result.first = error;
+      return result;
+    }
+    values[i] = option_value;
+  }
+  // the values come from the camera, a reply the tuner cannot use is an error rather than a broken invariant
+  constexpr int max_rate = std::numeric_limits<std::uint16_t>::max();
+  if (values[0] <= 0 or values[1] <= 0 or values[2] <= 0 or values[2] > max_rate or values[3] <= 0 or
+      values[3] > max_rate) {
+    LOG(ERROR) << "Invalid stream configuration " << values[0] << "x" << values[1] << "@" << values[2] << " GOP "
+               << values[3];
+    result.first = make_error_code(DahuaErrorCode::error);
+    return result;
+  }
+  result.second = {cv::Size(values[0], values[1]), static_cast<std::uint16_t>(values[2]),
+                   static_cast<std::uint16_t>(values[3])};
+  return result;
+}
+
+std::error_code HTTPInterface::SetStreamConfig(const StreamConfig& config) {
+  // setting the same values again is harmless
+  const auto [error, response] =
+      HTTPGetRequest(CreateSetVideoEncodeConfigURL(config), Retry::allowed, set_encode_config_metrics_);
+  if (not error) {
+    return make_error_code(response == "OK" ? DahuaErrorCode::ok : DahuaErrorCode::error);
+  }
+  return error;
+}
+
+std::pair<std::error_code, std::string> HTTPInterface::GetSnapshot() {
+  auto result = HTTPGetRequest(CreateSnapshotURL(), Retry::allowed, snapshot_metrics_, Body::binary);
+  // a refused snapshot is answered with a short text body instead of an image
+  if (not result.first and result.second.compare(0, 2, "\xFF\xD8") != 0) {
+    result.first = make_error_code(DahuaErrorCode::error);
+  }
+  return result;
+}
+
 std::error_code HTTPInterface::StartThenStopCommand(const std::string& start_cmd, std::chrono::milliseconds nap_time,
-                                                    const std::string& stop_cmd) {
+                                                    const std::string& stop_cmd, RequestMetrics& metrics) {
   {
-    auto [error, response] = HTTPGetRequest(start_cmd);
+    auto [error, response] = HTTPGetRequest(start_cmd, Retry::forbidden, metrics);
     if (error) {
       return error;
     }
@@ -114,21 +214,22 @@ std::error_code HTTPInterface::StartThenStopCommand(const std::string& start_cmd
     }
   }
   std::this_thread::sleep_for(nap_time);
-  auto [error, response] = HTTPGetRequest(stop_cmd);
+  // stopping twice is harmless while a lost stop would leave the motor running
+  auto [error, response] = HTTPGetRequest(stop_cmd, Retry::allowed, metrics);
   if (error) {
     return error;
   }
   return make_error_code(response == "OK" ? DahuaErrorCode::ok : DahuaErrorCode::error);
 }
 
-std::error_code HTTPInterface::SetFocusNear(std::uint16_t multiple) {
-  return StartThenStopCommand(CreateSetFocusNear(multiple, Action::start), std::chrono::milliseconds{100},
-                              CreateSetFocusNear(multiple, Action::stop));
+std::error_code HTTPInterface::SetFocusNear(std::uint16_t multiple, std::chrono::milliseconds pulse_duration) {
+  return StartThenStopCommand(CreateSetFocusNear(multiple, Action::start), pulse_duration,
+                              CreateSetFocusNear(multiple, Action::stop), focus_near_metrics_);
 }
 
-std::error_code HTTPInterface::SetFocusFar(std::uint16_t multiple) {
-  return StartThenStopCommand(CreateSetFocusFar(multiple, Action::start), std::chrono::milliseconds{100},
-                              CreateSetFocusFar(multiple, Action::stop));
+std::error_code HTTPInterface::SetFocusFar(std::uint16_t multiple, std::chrono::milliseconds pulse_duration) {
+  return StartThenStopCommand(CreateSetFocusFar(multiple, Action::start), pulse_duration,
+                              CreateSetFocusFar(multiple, Action::stop), focus_far_metrics_);
 }
 
 std::string HTTPInterface::CreateGoToABSPositionURL(const PTZCameraPosition& position,
@@ -146,12 +247,28 @@ std::string HTTPInterface::CreateGetVideoEncodeConfigURL() const {
   return ss.str();
 }
 
+std::string HTTPInterface::CreateSetVideoEncodeConfigURL(const StreamConfig& config) const {
+  std::ostringstream ss;
+  ss << "http://" << host_ << "/cgi-bin/configManager.cgi?action=setConfig"
+     << "&Encode[0].MainFormat[0].Video.Width=" << config.resolution.width
+     << "&Encode[0].MainFormat[0].Video.Height=" << config.resolution.height
+     << "&Encode[0].MainFormat[0].Video.FPS=" << config.frame_rate
+     << "&Encode[0].MainFormat[0].Video.GOP=" << config.gop;
+  return ss.str();
+}
+
 std::string HTTPInterface::CreateGetDeviceTypeURL() const {
   std::ostringstream ss;
   ss << "http://" << host_ << "/cgi-bin/magicBox.cgi?action=getDeviceType";
   return ss.str();
 }
 
+std::string HTTPInterface::CreateSnapshotURL() const {
+  std::ostringstream ss;
+  ss << "http://" << host_ << "/cgi-bin/snapshot.cgi?channel=1";
+  return ss.str();
+}
+
 std::string HTTPInterface::CreateSetFocusNear(std::uint16_t multiple, Action action) {
   std::ostringstream ss;
   ss << "http://" << host_ << "/cgi-bin/ptz.cgi?action=" << (action == Action::start ? "start" : "stop")
@@ -175,35 +292,181 @@ std::size_t CURLWriteCallback(void* chunk, std::size_t size, std::size_t nmemb,
   return nmemb;
 }
 
+// curl reports when each phase ended, the digest authentication round trip falls into the wait for the first byte
+void TraceRequestPhases(trace::Clock::time_point start, const RequestTiming& timing) {
+  if (not trace::IsEnabled()) {
+    return;
+  }
+  auto phase_start = start;
+  const auto trace_phase = [&phase_start, start](const char* name, std::chrono::microseconds end) {
+    if (start + end > phase_start) {
+      trace::RecordComplete("http", name, phase_start, start + end);
+      phase_start = start + end;
+    }
+  };
+  trace_phase("connect", timing.connect);
+  trace_phase("TLS", timing.tls);
+  trace_phase("wait for first byte", timing.first_byte);
+  trace_phase("receive", timing.total);
+}
+
 } // anonymous namespace
 
-std::pair<std::error_code, std::string> HTTPInterface::HTTPGetRequest(const std::string& url) {
-  std::string response_buffer;
-  // curl_easy_reset(curl_.get());
-  // curl_easy_setopt(curl_.get(), CURLOPT_VERBOSE, 1L);
-  curl_easy_setopt(curl_.get(), CURLOPT_ERRORBUFFER, error_buffer_.data());
-  curl_easy_setopt(curl_.get(), CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl_.get(), CURLOPT_PORT, port_);
-  curl_easy_setopt(curl_.get(), CURLOPT_HTTPGET, 1L);
-  curl_easy_setopt(curl_.get(), CURLOPT_HTTPAUTH, CURLAUTH_DIGEST);
-  curl_easy_setopt(curl_.get(), CURLOPT_USERPWD, user_password_.c_str());
-  curl_easy_setopt(curl_.get(), CURLOPT_WRITEFUNCTION, CURLWriteCallback);
-  curl_easy_setopt(curl_.get(), CURLOPT_WRITEDATA, &response_buffer);
-  curl_easy_setopt(curl_.get(), CURLOPT_TIMEOUT, std::chrono::seconds{5}.count());
-
-  error_buffer_[0] = '\0';
-  auto res = curl_easy_perform(curl_.get());
-  if (res != CURLE_OK) {
-    const auto len = std::strlen(error_buffer_.data());
-    if (len) {
+HTTPInterface::RequestMetrics HTTPInterface::RegisterRequestMetrics(const char* code) const {
+  auto& registry = metrics::GetRegistry();
+  const metrics::Labels labels{{"camera", host_}, {"code", code}};
+  return {code,
+          registry.GetHistogram("goto_point_http_request_duration_seconds",
+                                "Duration of camera CGI requests including retries", labels),
+          registry.GetCounter("goto_point_http_request_failures_total", "Failed camera CGI requests", labels)};
+}
+
+std::pair<std::error_code, std::string> HTTPInterface::HTTPGetRequest(const std::string& url, Retry retry,
+                                                                      RequestMetrics& metrics, Body body) {
+  trace::Span span("http", metrics.code);
+  const auto start = std::chrono::steady_clock::now();
+  RequestTiming timing;
+  auto result = HTTPGetRequestWithRetries(url, retry, body, timing);
+  const auto duration = std::chrono::steady_clock::now() - start;
+  metrics.latency.Record(duration);
+  if (result.first) {
+    metrics.failures.Add();
+  }
+  if (request_observer_) {
+    request_observer_(HTTPExchange{metrics.code, url, start, duration, timing, result.first, result.second,
+                                   body == Body::binary});
+  }
+  return result;
+}
+
+std::pair<std::error_code, std::string> HTTPInterface::HTTPGetRequestWithRetries(const std::string& url,
+                                                                                 Retry retry, Body body,
+                                                                                 RequestTiming& timing) {
+  const unsigned max_attempts = retry == Retry::allowed ? std::max(policy_.retries.max_attempts, 1u) : 1;
+  const bool tracked = body == Body::text;
+  for (unsigned attempt = 0;; ++attempt) {
+    if (not circuit_breaker_.AllowRequest()) {
+      return {make_error_code(DahuaErrorCode::camera_unreachable), {}};
+    }
+    // a binary transfer may take long, but a live camera accepts the connection as quickly as for any other request
+    auto timeouts = latency_.GetTimeouts();
+    if (not tracked) {
+      timeouts.total = policy_.timeouts.max_timeout;
+    }
+    std::string response_buffer;
+    timing = {};
+    const auto start = trace::Clock::now();
+    const auto res = Perform(curl_.get(), error_buffer_.data(), url, timeouts, response_buffer, timing);
+    trace::RecordComplete("http", "attempt", start, trace::Clock::now());
+    if (res == CURLE_OK) {
+      TraceRequestPhases(start, timing);
+      if (tracked) {
+        latency_.Record(timing);
+      }
+      if (circuit_breaker_.RecordSuccess()) {
+        LOG(INFO) << host_ << " is reachable again";
+      }
+      if (body == Body::text) {
+        boost::algorithm::trim(response_buffer);
+      }
+      return {{}, std::move(response_buffer)};
+    }
+
+    if (std::strlen(error_buffer_.data())) {
       LOG(ERROR) << error_buffer_.data();
     } else {
       LOG(ERROR) << curl_easy_strerror(res);
     }
-    return {make_error_code(res), {}};
+    if (not IsTransientFailure(res)) {
+      return {make_error_code(res), {}};
+    }
+    if (tracked and res == CURLE_OPERATION_TIMEDOUT) {
+      latency_.RecordTimeout(timeouts.total);
+    }
+    if (attempt + 1 >= max_attempts) {
+      // The breaker counts failed requests rather than attempts, so a request using up its retries does not open
+      // the circuit on its own. A binary request only counts when the camera did not even accept the connection,
+      // a slow transfer says nothing about its reachability.
+      curl_off_t connect_time = 0;
+      curl_easy_getinfo(curl_.get(), CURLINFO_CONNECT_TIME_T, &connect_time);
+      const bool counted = tracked or IsConnectFailure(res, connect_time > 0);
+      if (counted and circuit_breaker_.RecordFailure()) {
+        LOG(WARNING) << host_ << " is unreachable, requests fail fast until a background probe succeeds";
+        StartProbing();
+      }
+      return {make_error_code(res), {}};
+    }
+    const auto delay = BackoffDelay(policy_.retries, attempt, rng_);
+    LOG(WARNING) << "Retrying request to " << host_ << " in " << delay.count() << " ms";
+    std::this_thread::sleep_for(delay);
+  }
+}
+
+CURLcode HTTPInterface::Perform(CURL* curl, char* error_buffer, const std::string& url, const Timeouts& timeouts,
+                                std::string& response, RequestTiming& timing) const {
+  // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_buffer);
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_PORT, port_);
+  curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+  curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_DIGEST);
+  curl_easy_setopt(curl, CURLOPT_USERPWD, user_password_.c_str());
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CURLWriteCallback);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(timeouts.connect.count()));
+  curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(timeouts.total.count()));
+  // the timeouts may be well below a second, which curl can only honour without signals
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+  error_buffer[0] = '\0';
+  const auto res = curl_easy_perform(curl);
+  if (res == CURLE_OK) {
+    long new_connections = 0;
+    curl_off_t connect = 0, tls = 0, first_byte = 0, total = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &new_connections);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &first_byte);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+    timing.connect = std::chrono::microseconds{new_connections > 0 ? connect : 0};
+    timing.tls = std::chrono::microseconds{tls};
+    timing.first_byte = std::chrono::microseconds{first_byte};
+    timing.total = std::chrono::microseconds{total};
+  }
+  return res;
+}
+
+void HTTPInterface::StartProbing() {
+  // a previous probe has finished once the circuit could open again, joining it does not block
+  if (probe_thread_.joinable()) {
+    probe_thread_.join();
+  }
+  probe_thread_ = std::thread(&HTTPInterface::ProbeUntilReachable, this);
+}
+
+void HTTPInterface::ProbeUntilReachable() {
+  std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl{CreateEasyHandle(), &curl_easy_cleanup};
+  CHECK(curl);
+  std::array<char, CURL_ERROR_SIZE> error_buffer = {};
+  const Timeouts timeouts{policy_.timeouts.max_timeout, policy_.timeouts.max_timeout};
+  const auto url = CreateGetDeviceTypeURL();
+  for (unsigned probe = 0;; ++probe) {
+    {
+      std::unique_lock lock(probe_mutex_);
+      if (probe_wakeup_.wait_for(lock, circuit_breaker_.GetProbeDelay(probe), [this] { return stopping_; })) {
+        return;
+      }
+    }
+    std::string response;
+    RequestTiming timing;
+    const auto res = Perform(curl.get(), error_buffer.data(), url, timeouts, response, timing);
+    if (res == CURLE_OK) {
+      circuit_breaker_.RecordSuccess();
+      LOG(INFO) << host_ << " answered probe " << probe + 1 << ", circuit closed";
+      return;
+    }
+    VLOG(1) << host_ << " probe " << probe + 1 << " failed: " << curl_easy_strerror(res);
   }
-  boost::algorithm::trim(response_buffer);
-  return {{}, std::move(response_buffer)};
 }
 
 namespace {
@@ -2,51 +2,134 @@
 
 #include <array>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <random>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <utility>
 
 #include <opencv2/core/types.hpp>
 
 #include <curl/curl.h>
 
+#include "metrics.h"
+#include "request_policy.h"
+
 namespace tpxai {
 
 struct PTZCameraPosition;
 
 namespace dahua {
 
+// Encoding of the main stream.
+struct StreamConfig {
+  cv::Size resolution;
+  std::uint16_t frame_rate = 0;
+  std::uint16_t gop = 0; // frames between key frames
+};
+
+// A finished CGI request as seen by its caller, i.e. after all retries.
+struct HTTPExchange {
+  const char* code;
+  const std::string& url;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::steady_clock::duration duration;
+  RequestTiming timing; // of the last attempt, zero when no answer was received
+  std::error_code error;
+  const std::string& response;
+  bool binary_response = false; // e.g. a snapshot JPEG
+};
+
 class HTTPInterface {
 public:
-  HTTPInterface(std::string user, std::string password, std::string host, unsigned short port);
+  using RequestObserver = std::function<void(const HTTPExchange&)>;
+
+  HTTPInterface(std::string user, std::string password, std::string host, unsigned short port,
+                RequestPolicySettings policy = {});
+  ~HTTPInterface();
   std::string GetStreamingURL() const;
   std::error_code GoToABSPosition(const PTZCameraPosition& position, std::uint16_t zoom_multiple);
   std::pair<std::error_code, cv::Size> GetResolution();
   std::pair<std::error_code, std::uint16_t> GetFrameRate();
   std::pair<std::error_code, std::string> GetDeviceType();
-  std::error_code SetFocusNear(std::uint16_t multiple);
-  std::error_code SetFocusFar(std::uint16_t multiple);
+  std::pair<std::error_code, StreamConfig> GetStreamConfig();
+  std::error_code SetStreamConfig(const StreamConfig& config);
+  // a JPEG of the main stream, as encoded by the camera
+  std::pair<std::error_code, std::string> GetSnapshot();
+  std::error_code SetFocusNear(std::uint16_t multiple,
+                               std::chrono::milliseconds pulse_duration = std::chrono::milliseconds{100});
+  std::error_code SetFocusFar(std::uint16_t multiple,
+                              std::chrono::milliseconds pulse_duration = std::chrono::milliseconds{100});
+
+  Timeouts GetTimeouts() const { return latency_.GetTimeouts(); }
+  bool IsReachable() const { return circuit_breaker_.AllowRequest(); }
+
+  // Called after every request on the thread which issued it, e.g. to record a session. Must not block.
+  void SetRequestObserver(RequestObserver observer) { request_observer_ = std::move(observer); }
 
 private:
   enum class Action { start, stop };
+  // only requests which can be repeated without side effects are retried
+  enum class Retry { allowed, forbidden };
+  // Text responses are trimmed of surrounding whitespace, binary ones are passed on as received. A binary response
+  // takes as long as its transfer, so binary requests get the adaptive connect timeout but the maximal total one,
+  // their transfer times are kept out of the latency tracker, and only their connect failures count towards the
+  // circuit breaker.
+  enum class Body { text, binary };
+
+  // per camera and CGI code, registered up front so that requests only record
+  struct RequestMetrics {
+    const char* code; // also the name of the request spans in the trace
+    metrics::Histogram& latency;
+    metrics::Counter& failures;
+  };
+  RequestMetrics RegisterRequestMetrics(const char* code) const;
 
   std::string CreateGoToABSPositionURL(const PTZCameraPosition& position, std::uint16_t zoom_multiple) const;
   std::string CreateGetVideoEncodeConfigURL() const;
+  std::string CreateSetVideoEncodeConfigURL(const StreamConfig& config) const;
   std::string CreateGetDeviceTypeURL() const;
+  std::string CreateSnapshotURL() const;
   std::string CreateSetFocusNear(std::uint16_t multiple, Action action);
   std::string CreateSetFocusFar(std::uint16_t multiple, Action action);
 
   std::error_code StartThenStopCommand(const std::string& start_cmd, std::chrono::milliseconds nap_time,
-                                       const std::string& stop_cmd);
+                                       const std::string& stop_cmd, RequestMetrics& metrics);
 
-  std::pair<std::error_code, std::string> HTTPGetRequest(const std::string& url);
+  std::pair<std::error_code, std::string> HTTPGetRequest(const std::string& url, Retry retry,
+                                                         RequestMetrics& metrics, Body body = Body::text);
+  std::pair<std::error_code, std::string> HTTPGetRequestWithRetries(const std::string& url, Retry retry, Body body,
+                                                                    RequestTiming& timing);
+  CURLcode Perform(CURL* curl, char* error_buffer, const std::string& url, const Timeouts& timeouts,
+                   std::string& response, RequestTiming& timing) const;
+  void StartProbing();
+  void ProbeUntilReachable();
 
   std::string user_password_;
   std::string host_;
   unsigned short port_;
   std::unique_ptr<CURL, decltype(&curl_easy_cleanup)> curl_;
   std::array<char, CURL_ERROR_SIZE> error_buffer_ = {};
+  RequestPolicySettings policy_;
+  LatencyTracker latency_;
+  CircuitBreaker circuit_breaker_;
+  std::minstd_rand rng_;
+  std::thread probe_thread_;
+  std::mutex probe_mutex_;
+  std::condition_variable probe_wakeup_;
+  bool stopping_ = false;
+  RequestMetrics position_abs_metrics_;
+  RequestMetrics focus_near_metrics_;
+  RequestMetrics focus_far_metrics_;
+  RequestMetrics encode_config_metrics_;
+  RequestMetrics set_encode_config_metrics_;
+  RequestMetrics device_type_metrics_;
+  RequestMetrics snapshot_metrics_;
+  RequestObserver request_observer_;
 };
 
 std::pair<std::error_code, int> ExtractNumericOptionValueFromMultiline(std::string_view multiline, const char* option);
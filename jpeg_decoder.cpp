@@ -0,0 +1,98 @@
+#include "jpeg_decoder.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/imgcodecs.hpp>
+
+namespace tpxai {
+
+namespace {
+
+std::uint8_t Byte(std::string_view data, std::size_t offset) {
+  return static_cast<std::uint8_t>(data[offset]);
+}
+
+std::uint16_t BigEndian16(std::string_view data, std::size_t offset) {
+  return static_cast<std::uint16_t>(Byte(data, offset) << 8 | Byte(data, offset + 1));
+}
+
+bool IsStartOfFrame(std::uint8_t marker) {
+  // C4, C8 and CC share the range but are Huffman tables, a reserved marker and arithmetic coding conditioning
+  return marker >= 0xC0 and marker <= 0xCF and marker != 0xC4 and marker != 0xC8 and marker != 0xCC;
+}
+
+} // anonymous namespace
+
+std::optional<cv::Size> ReadJPEGSize(std::string_view jpeg) {
+  if (jpeg.size() < 4 or Byte(jpeg, 0) != 0xFF or Byte(jpeg, 1) != 0xD8) {
+    return std::nullopt;
+  }
+  std::size_t offset = 2;
+  while (offset + 4 <= jpeg.size()) {
+    if (Byte(jpeg, offset) != 0xFF) {
+      return std::nullopt;
+    }
+    const auto marker = Byte(jpeg, offset + 1);
+    if (marker == 0xFF) {
+      // fill byte before a marker
+      ++offset;
+      continue;
+    }
+    if (marker == 0x01 or (marker >= 0xD0 and marker <= 0xD7)) {
+      // markers without a segment
+      offset += 2;
+      continue;
+    }
+    if (marker == 0xDA or marker == 0xD9) {
+      // the entropy-coded data starts, or the image ends, without a frame header
+      return std::nullopt;
+    }
+    const auto length = BigEndian16(jpeg, offset + 2);
+    if (IsStartOfFrame(marker)) {
+      // length, sample precision, height, width
+      if (length < 7 or offset + 9 > jpeg.size()) {
+        return std::nullopt;
+      }
+      return cv::Size(BigEndian16(jpeg, offset + 7), BigEndian16(jpeg, offset + 5));
+    }
+    offset += 2 + length;
+  }
+  return std::nullopt;
+}
+
+int ChooseJPEGReduction(const cv::Size& size, int min_width) {
+  if (min_width <= 0) {
+    return 1;
+  }
+  int reduction = 1;
+  // libjpeg rounds the scaled size up
+  while (reduction < 8 and (size.width + 2 * reduction - 1) / (2 * reduction) >= min_width) {
+    reduction *= 2;
+  }
+  return reduction;
+}
+
+cv::Mat DecodeJPEG(std::string_view jpeg, int min_width) {
+  int flags = cv::IMREAD_COLOR;
+  if (const auto size = ReadJPEGSize(jpeg)) {
+    switch (ChooseJPEGReduction(*size, min_width)) {
+      case 2:
+        flags = cv::IMREAD_REDUCED_COLOR_2;
+        break;
+      case 4:
+        flags = cv::IMREAD_REDUCED_COLOR_4;
+        break;
+      case 8:
+        flags = cv::IMREAD_REDUCED_COLOR_8;
+        break;
+      default:
+        break;
+    }
+  }
+  // imdecode only reads the buffer
+  const cv::Mat encoded(1, static_cast<int>(jpeg.size()), CV_8UC1, const_cast<char*>(jpeg.data()));
+  return cv::imdecode(encoded, flags);
+}
+
+} // namespace tpxai
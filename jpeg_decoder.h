@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include <opencv2/core.hpp>
+
+namespace tpxai {
+
+// The image size from the frame header of a JPEG, read without decoding it. Empty for a truncated or non-JPEG
+// buffer.
+std::optional<cv::Size> ReadJPEGSize(std::string_view jpeg);
+
+// The largest of the 1/1, 1/2, 1/4 and 1/8 scales libjpeg decodes at directly, by skipping the high frequencies of
+// the DCT, which keeps the image at least min_width wide. 1 for min_width 0.
+int ChooseJPEGReduction(const cv::Size& size, int min_width);
+
+// Decodes a color JPEG at the reduction chosen for min_width, which saves most of the inverse DCT, upsampling and
+// color conversion work of the skipped pixels. Returns an empty image for an undecodable buffer.
+cv::Mat DecodeJPEG(std::string_view jpeg, int min_width = 0);
+
+} // namespace tpxai
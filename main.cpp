@@ -1,56 +1,339 @@
 #include <glog/logging.h>
 
+#include "autofocus.h"
+#include "camera_capture.h"
+#include "camera_startup.h"
 #include "dahua_ptz_camera.h"
+#include "event_recorder.h"
+#include "metrics.h"
+#include "motion_detector.h"
+#include "preview_display.h"
+#include "shm_frame_exporter.h"
 #include "position_calculator.h"
+#include "session_log.h"
+#include "snapshot_capture.h"
+#include "stream_tuner.h"
+#include "trace.h"
 
 namespace {
 
 struct MouseClickCallbackContext {
   tpxai::dahua::DahuaPTZCamera* ptz_camera = nullptr;
-  Eigen::Vector3f current_position; // Euler angles in degrees
+  tpxai::session::SessionRecorder* session = nullptr;
+  const tpxai::PreviewDisplay* display = nullptr;
+  cv::Size frame_size;
+  bool dragging = false;
+  cv::Point drag_start; // in preview coordinates
+  cv::Point drag_end;
 };
 
+// Removes the callbacks Run installs on the camera, which outlives the recorders they refer to, also when Run throws.
+class CameraCallbacksReset {
+public:
+  explicit CameraCallbacksReset(tpxai::dahua::DahuaPTZCamera& camera) : camera_{camera} {}
+  ~CameraCallbacksReset() {
+    camera_.SetMoveCallback(nullptr);
+    camera_.SetRequestObserver(nullptr);
+  }
+
+  CameraCallbacksReset(const CameraCallbacksReset&) = delete;
+  CameraCallbacksReset& operator=(const CameraCallbacksReset&) = delete;
+
+private:
+  tpxai::dahua::DahuaPTZCamera& camera_;
+};
+
+constexpr int min_drag_region_size = 16;
+constexpr std::size_t shm_export_slots = 4;
+
+tpxai::metrics::Counter* DroppedFrames(const char* consumer) {
+  return &tpxai::metrics::GetRegistry().GetCounter("goto_point_dropped_frames_total",
+                                                   "Frames dropped by a consumer that could not keep up",
+                                                   {{"consumer", consumer}});
+}
+
+// Euler angles in degrees, read from the camera as the motion auto-pointer may move it as well
+Eigen::Vector3f GetCurrentPosition(const tpxai::dahua::DahuaPTZCamera& ptz_camera) {
+  const auto position = ptz_camera.GetCurrentPosition();
+  return {position.vertical_angle, position.horizontal_angle, 0};
+}
+
+void GoToPoint(MouseClickCallbackContext& ctx, const cv::Point& point) {
+  tpxai::trace::Span span("ui", "GoToPoint");
+  const auto zoom = ctx.ptz_camera->GetCurrentZoom();
+  const auto intrinsics = ctx.ptz_camera->GetIntrinsics();
+  const Eigen::Vector3f current_position = GetCurrentPosition(*ctx.ptz_camera);
+  Eigen::Vector3f new_abs_position =
+      tpxai::CalculateAbsolutePosition(point, intrinsics.ForZoom(zoom).K, current_position);
+  VLOG(1) << "PTZ move: (" << current_position[0] << ", " << current_position[1] << ") -> ("
+          << new_abs_position[0] << ", " << new_abs_position[1] << ")";
+  if (ctx.session) {
+    ctx.session->RecordClick(cv::Rect(point, point), ctx.frame_size, intrinsics,
+                             tpxai::PTZCameraPosition{current_position[1], current_position[0]}, zoom,
+                             ctx.ptz_camera->GetMaxZoom(), tpxai::PTZTarget{new_abs_position, zoom});
+  }
+
+  ctx.ptz_camera->SetAbsolutePosition(tpxai::PTZCameraPosition{new_abs_position[1], new_abs_position[0]});
+}
+
+void GoToRegion(MouseClickCallbackContext& ctx, const cv::Rect& region) {
+  tpxai::trace::Span span("ui", "GoToRegion");
+  const Eigen::Vector3f current_position = GetCurrentPosition(*ctx.ptz_camera);
+  const auto zoom = ctx.ptz_camera->GetCurrentZoom();
+  const auto max_zoom = ctx.ptz_camera->GetMaxZoom();
+  const auto intrinsics = ctx.ptz_camera->GetIntrinsics();
+  const auto target =
+      tpxai::CalculateAbsolutePositionForRegion(region, intrinsics, ctx.frame_size, current_position, zoom, max_zoom);
+  const auto& new_abs_position = target.euler_angles_in_degrees;
+  VLOG(1) << "PTZ move: (" << current_position[0] << ", " << current_position[1] << ", x" << zoom << ") -> ("
+          << new_abs_position[0] << ", " << new_abs_position[1] << ", x" << target.zoom_multiple << ")";
+  if (ctx.session) {
+    ctx.session->RecordClick(region, ctx.frame_size, intrinsics,
+                             tpxai::PTZCameraPosition{current_position[1], current_position[0]}, zoom, max_zoom,
+                             target);
+  }
+
+  ctx.ptz_camera->SetAbsolutePosition(tpxai::PTZCameraPosition{new_abs_position[1], new_abs_position[0]},
+                                      target.zoom_multiple);
+}
+
 void OnMouseClickCallback(int event, int x, int y, int/* flags*/, void* userdata) {
-  if(event != cv::EVENT_LBUTTONDBLCLK) {
+  auto ctx = static_cast<MouseClickCallbackContext*>(userdata);
+  // called from within waitKey, so the presented preview is the one clicked at
+  const auto preview = ctx->display->GetPresented();
+  if (not preview) {
     return;
   }
-  auto ctx = static_cast<MouseClickCallbackContext*>(userdata);
+  ctx->frame_size = preview->frame_size;
+  switch (event) {
+    case cv::EVENT_LBUTTONDBLCLK:
+      ctx->dragging = false;
+      GoToPoint(*ctx, preview->ToFrame(cv::Point(x, y)));
+      break;
+    case cv::EVENT_LBUTTONDOWN:
+      ctx->dragging = true;
+      ctx->drag_start = ctx->drag_end = cv::Point(x, y);
+      break;
+    case cv::EVENT_MOUSEMOVE:
+      if (ctx->dragging) {
+        ctx->drag_end = cv::Point(x, y);
+      }
+      break;
+    case cv::EVENT_LBUTTONUP:
+      if (ctx->dragging) {
+        ctx->dragging = false;
+        const cv::Rect region(ctx->drag_start, cv::Point(x, y));
+        if (region.width >= min_drag_region_size and region.height >= min_drag_region_size) {
+          GoToRegion(*ctx, preview->ToFrame(region));
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
 
-  Eigen::Vector3f new_abs_position =
-      tpxai::CalculateAbsolutePosition(cv::Point(x, y), ctx->ptz_camera->GetIntrinsics().K, ctx->current_position);
-  std::cout << "PTZ move: (" << ctx->current_position[0] << ", "
-            << ctx->current_position[1] << ") -> (" << new_abs_position[0]
-            << ", " << new_abs_position[1] << ")" << std::endl;
+// frames are fetched as JPEG snapshots at this interval instead of streamed, when set
+std::optional<std::chrono::milliseconds> GetSnapshotInterval() {
+  const char* interval = std::getenv("GOTO_POINT_SNAPSHOT_INTERVAL_MS");
+  if (not interval) {
+    return std::nullopt;
+  }
+  return std::chrono::milliseconds{std::stoi(interval)};
+}
+
+std::string GetTracePath() {
+  const char* path = std::getenv("GOTO_POINT_TRACE_FILE");
+  return path ? path : "goto_point_trace.json";
+}
+
+void WriteTrace() {
+  const auto path = GetTracePath();
+  try {
+    tpxai::trace::WriteChromeTrace(path);
+    LOG(INFO) << "Trace written to " << path;
+  } catch (std::exception& e) {
+    LOG(ERROR) << e.what();
+  }
+}
 
-  ctx->ptz_camera->SetAbsolutePosition(tpxai::PTZCameraPosition{new_abs_position[1], new_abs_position[0]});
-  ctx->current_position = new_abs_position;
-  std::cout << "===========================================" << std::endl;
+void ToggleTracing() {
+  if (tpxai::trace::IsEnabled()) {
+    tpxai::trace::SetEnabled(false);
+    WriteTrace();
+  } else {
+    tpxai::trace::SetEnabled(true);
+    LOG(INFO) << "Tracing enabled";
+  }
+}
+
+// On full-resolution frames, the preview stalls meanwhile. A failure, e.g. a rejected focus command, is logged and
+// leaves the viewer running.
+void RunAutofocus(tpxai::FrameBus& frame_bus, tpxai::dahua::DahuaPTZCamera& ptz_camera) {
+  const auto frames = frame_bus.Subscribe(1, tpxai::BackpressurePolicy::drop_oldest);
+  // otherwise the bus would keep queuing frames for the abandoned subscription
+  struct Unsubscribe {
+    tpxai::FrameBus& bus;
+    const std::shared_ptr<tpxai::FrameSubscription>& subscription;
+    ~Unsubscribe() { bus.Unsubscribe(subscription); }
+  } unsubscribe{frame_bus, frames};
+  try {
+    tpxai::Autofocus(ptz_camera, [&frames] {
+      auto frame = frames->Pop();
+      if (not frame) {
+        throw std::runtime_error("camera capture stopped");
+      }
+      return frame->image;
+    }).Run();
+  } catch (std::exception& e) {
+    LOG(ERROR) << "Autofocus failed: " << e.what();
+  }
 }
 
 void Run(tpxai::dahua::DahuaPTZCamera& ptz_camera) {
-  auto current_pos = ptz_camera.GetCurrentPosition();
-  MouseClickCallbackContext clbk_ctx{
-      &ptz_camera,
-      {current_pos.vertical_angle, current_pos.horizontal_angle, 0},
-  };
+  MouseClickCallbackContext clbk_ctx;
+  clbk_ctx.ptz_camera = &ptz_camera;
+
+  tpxai::FrameBus frame_bus;
+  std::unique_ptr<tpxai::ShmFrameExporter> shm_exporter;
+  std::unique_ptr<tpxai::FrameConsumer> shm_export;
+  if (const char* shm_name = std::getenv("GOTO_POINT_SHM_EXPORT")) {
+    shm_export = std::make_unique<tpxai::FrameConsumer>(
+        frame_bus, 2, tpxai::BackpressurePolicy::drop_oldest,
+        [&shm_exporter, name = std::string(shm_name)](const tpxai::SharedFrame& frame) {
+          // the stream tuner may raise the resolution at runtime, readers have to reattach to the new segment
+          const auto image_bytes = frame->image.total() * frame->image.elemSize();
+          if (not shm_exporter or image_bytes > shm_exporter->GetMaxImageBytes()) {
+            // the old segment is unlinked before the new one is created under the same name
+            shm_exporter.reset();
+            shm_exporter = std::make_unique<tpxai::ShmFrameExporter>(name, shm_export_slots, image_bytes);
+          }
+          shm_exporter->Export(*frame);
+        },
+        DroppedFrames("shm_export"));
+  }
+  std::unique_ptr<tpxai::EventRecorder> recorder;
+  std::unique_ptr<tpxai::FrameConsumer> recording;
+  if (const char* record_dir = std::getenv("GOTO_POINT_RECORD_DIR")) {
+    tpxai::EventRecorderSettings settings;
+    settings.output_directory = record_dir;
+    recorder = std::make_unique<tpxai::EventRecorder>(settings);
+    recording = std::make_unique<tpxai::FrameConsumer>(
+        frame_bus, 8, tpxai::BackpressurePolicy::drop_oldest,
+        [&recorder](const tpxai::SharedFrame& frame) { recorder->OnFrame(*frame); }, DroppedFrames("recorder"));
+  }
+  std::unique_ptr<tpxai::session::SessionRecorder> session;
+  std::unique_ptr<tpxai::FrameConsumer> session_recording;
+  // declared after the recorders, so the callbacks are removed before the recorders are destroyed
+  const CameraCallbacksReset callbacks_reset(ptz_camera);
+  if (const char* session_log = std::getenv("GOTO_POINT_SESSION_LOG")) {
+    tpxai::session::SessionRecorderSettings settings;
+    const char* record_images = std::getenv("GOTO_POINT_SESSION_IMAGES");
+    settings.record_images = record_images and std::string(record_images) == "1";
+    session = std::make_unique<tpxai::session::SessionRecorder>(session_log, settings);
+    session->RecordIntrinsics(ptz_camera.GetIntrinsics());
+    session_recording = std::make_unique<tpxai::FrameConsumer>(
+        frame_bus, 8, tpxai::BackpressurePolicy::drop_oldest,
+        [&session](const tpxai::SharedFrame& frame) { session->RecordFrame(*frame); }, DroppedFrames("session"));
+    ptz_camera.SetRequestObserver(
+        [&session](const tpxai::dahua::HTTPExchange& exchange) { session->RecordHTTP(exchange); });
+    clbk_ctx.session = session.get();
+  }
+  if (recorder or session) {
+    ptz_camera.SetMoveCallback(
+        [&recorder, &session](const tpxai::PTZCameraPosition& position, std::uint16_t zoom_multiple) {
+          if (recorder) {
+            recorder->Trigger("move");
+          }
+          if (session) {
+            session->RecordPose(position, zoom_multiple);
+          }
+        });
+  }
+  tpxai::PreviewSettings preview_settings;
+  if (const char* preview_width = std::getenv("GOTO_POINT_PREVIEW_WIDTH")) {
+    preview_settings.max_width = std::stoi(preview_width);
+  }
+  std::unique_ptr<tpxai::CameraCapture> capture;
+  std::unique_ptr<tpxai::SnapshotScheduler> snapshot_scheduler;
+  std::unique_ptr<tpxai::SnapshotCapture> snapshot_capture;
+  if (const auto snapshot_interval = GetSnapshotInterval()) {
+    snapshot_scheduler = std::make_unique<tpxai::SnapshotScheduler>(1);
+    // decoded no larger than the preview needs
+    snapshot_capture = std::make_unique<tpxai::SnapshotCapture>(
+        ptz_camera, frame_bus, *snapshot_scheduler, tpxai::SnapshotSettings{*snapshot_interval,
+                                                                            preview_settings.max_width});
+  } else {
+    capture = std::make_unique<tpxai::CameraCapture>(ptz_camera, frame_bus);
+  }
+  std::unique_ptr<tpxai::StreamTuner> stream_tuner;
+  if (const char* cpu_budget = std::getenv("GOTO_POINT_STREAM_CPU_BUDGET"); cpu_budget and capture) {
+    tpxai::StreamTunerSettings settings;
+    settings.cpu_budget = std::stod(cpu_budget);
+    stream_tuner = std::make_unique<tpxai::StreamTuner>(settings);
+    stream_tuner->AddCamera(ptz_camera, *capture);
+  }
+  std::unique_ptr<tpxai::FrameConsumer> motion_pointing;
 
   cv::namedWindow("dahua", cv::WINDOW_AUTOSIZE);
+  tpxai::PreviewDisplay display(frame_bus, ptz_camera, "dahua", preview_settings);
+  clbk_ctx.display = &display;
   cv::setMouseCallback("dahua", OnMouseClickCallback, &clbk_ctx);
 
-  for(int key = 0; key != 'q'; key = cv::waitKey(1)) {
-    auto next_frame = ptz_camera.GetNextFrame();
-    cv::circle(next_frame, ptz_camera.GetIntrinsics().center(), 10,
-               cv::viz::Color::red(), cv::FILLED);
-    cv::imshow("dahua", next_frame);
+  for (int key = 0; key != 'q';) {
+    if (frame_bus.IsClosed()) {
+      throw std::runtime_error("camera capture stopped");
+    }
+    if (key == 'f') {
+      RunAutofocus(frame_bus, ptz_camera);
+    } else if (key == 't') {
+      ToggleTracing();
+    } else if (key == 'r' and recorder) {
+      recorder->Trigger("key");
+    } else if (key == 'm') {
+      if (motion_pointing) {
+        motion_pointing.reset();
+      } else {
+        motion_pointing = std::make_unique<tpxai::FrameConsumer>(
+            frame_bus, 1, tpxai::BackpressurePolicy::drop_oldest,
+            [pointer = std::make_shared<tpxai::MotionAutoPointer>(ptz_camera)](const tpxai::SharedFrame& frame) {
+              pointer->OnFrame(*frame);
+            },
+            DroppedFrames("motion_pointing"));
+      }
+      LOG(INFO) << "Motion auto-pointing " << (motion_pointing ? "enabled" : "disabled");
+    }
+    key = display.Present(clbk_ctx.dragging ? std::optional(cv::Rect(clbk_ctx.drag_start, clbk_ctx.drag_end))
+                                            : std::nullopt);
   }
 }
 
 } // anonymous namespace
 
 int main() try {
-  tpxai::dahua::DahuaPTZCamera ptz_camera("admin", "DUPAdupa..", "192.168.1.102", 80);
-  ptz_camera.SetAbsolutePosition(tpxai::PTZCameraPosition{0, 0});
-  Run(ptz_camera);
+  tpxai::trace::SetThreadName("main");
+  if (std::getenv("GOTO_POINT_TRACE_FILE")) {
+    tpxai::trace::SetEnabled(true);
+  }
+  std::unique_ptr<tpxai::metrics::FileExporter> metrics_exporter;
+  if (const char* metrics_file = std::getenv("GOTO_POINT_METRICS_FILE")) {
+    metrics_exporter = std::make_unique<tpxai::metrics::FileExporter>(tpxai::metrics::GetRegistry(), metrics_file);
+  }
+  tpxai::StartupOptions startup_options;
+  if (GetSnapshotInterval()) {
+    startup_options.stream_opening = tpxai::dahua::StreamOpening::none;
+  }
+  auto started = tpxai::StartCamera({"dahua", "192.168.1.102", 80, "admin", "DUPAdupa.."}, startup_options);
+  if (not started.camera) {
+    throw std::runtime_error(started.error);
+  }
+  if (started.report.home_error) {
+    throw std::system_error(started.report.home_error);
+  }
+  Run(*started.camera);
+  if (tpxai::trace::IsEnabled()) {
+    WriteTrace();
+  }
   return 0;
 } catch (std::exception& e) {
   std::cerr << e.what() << std::endl;
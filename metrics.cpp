@@ -0,0 +1,241 @@
+#include "metrics.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <system_error>
+
+#include <glog/logging.h>
+
+namespace tpxai::metrics {
+
+std::uint64_t Counter::GetValue() const {
+  std::uint64_t value = 0;
+  for (const auto& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+std::size_t Histogram::GetBucket(std::uint64_t nanoseconds) {
+  if (nanoseconds < sub_bucket_count) {
+    return nanoseconds;
+  }
+  const unsigned exponent = 63 - __builtin_clzll(nanoseconds);
+  if (exponent > max_exponent) {
+    return bucket_count - 1;
+  }
+  const auto sub_bucket = (nanoseconds >> (exponent - sub_bucket_bits)) & (sub_bucket_count - 1);
+  return (exponent - sub_bucket_bits + 1) * sub_bucket_count + sub_bucket;
+}
+
+std::uint64_t Histogram::GetBucketUpperBound(std::size_t bucket) {
+  if (bucket < sub_bucket_count) {
+    return bucket + 1;
+  }
+  const auto exponent = bucket / sub_bucket_count + sub_bucket_bits - 1;
+  const auto sub_bucket = bucket % sub_bucket_count;
+  return (sub_bucket_count + sub_bucket + 1) << (exponent - sub_bucket_bits);
+}
+
+Histogram::Snapshot Histogram::GetSnapshot() const {
+  Snapshot snapshot;
+  std::uint64_t sum = 0;
+  for (const auto& shard : shards_) {
+    for (std::size_t i = 0; i < bucket_count; i++) {
+      snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+    sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  snapshot.count = std::accumulate(snapshot.buckets.begin(), snapshot.buckets.end(), std::uint64_t{0});
+  snapshot.sum = std::chrono::nanoseconds{sum};
+  return snapshot;
+}
+
+std::chrono::nanoseconds Histogram::Snapshot::GetPercentile(double quantile) const {
+  if (count == 0) {
+    return std::chrono::nanoseconds{0};
+  }
+  const auto rank = std::max<std::uint64_t>(1, std::ceil(std::clamp(quantile, 0.0, 1.0) * count));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return std::chrono::nanoseconds{GetBucketUpperBound(i)};
+    }
+  }
+  return std::chrono::nanoseconds{GetBucketUpperBound(bucket_count - 1)};
+}
+
+std::uint64_t Histogram::Snapshot::CountBelow(std::uint64_t nanoseconds) const {
+  std::uint64_t below = 0;
+  for (std::size_t i = 0; i < bucket_count and GetBucketUpperBound(i) <= nanoseconds; i++) {
+    below += buckets[i];
+  }
+  return below;
+}
+
+template <typename Metric>
+Metric& Registry::Get(std::vector<Entry<Metric>>& entries, const std::string& name, const std::string& help,
+                      const Labels& labels) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : entries) {
+    if (entry.name == name and entry.labels == labels) {
+      return *entry.metric;
+    }
+  }
+  entries.push_back({name, help, labels, std::make_unique<Metric>()});
+  return *entries.back().metric;
+}
+
+Counter& Registry::GetCounter(const std::string& name, const std::string& help, const Labels& labels) {
+  return Get(counters_, name, help, labels);
+}
+
+Histogram& Registry::GetHistogram(const std::string& name, const std::string& help, const Labels& labels) {
+  return Get(histograms_, name, help, labels);
+}
+
+namespace {
+
+void WriteLabels(std::ostream& output, const Labels& labels, const char* le = nullptr) {
+  if (labels.empty() and not le) {
+    return;
+  }
+  output << '{';
+  const char* separator = "";
+  for (const auto& [key, value] : labels) {
+    output << separator << key << "=\"";
+    for (const char c : value) {
+      if (c == '\\' or c == '"') {
+        output << '\\' << c;
+      } else if (c == '\n') {
+        output << "\\n";
+      } else {
+        output << c;
+      }
+    }
+    output << '"';
+    separator = ",";
+  }
+  if (le) {
+    output << separator << "le=\"" << le << '"';
+  }
+  output << '}';
+}
+
+// the entries of a metric family have to be grouped under a single HELP and TYPE line
+template <typename Entry>
+std::vector<const Entry*> SortedByName(const std::vector<Entry>& entries) {
+  std::vector<const Entry*> sorted;
+  for (const auto& entry : entries) {
+    sorted.push_back(&entry);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), [](auto lhs, auto rhs) { return lhs->name < rhs->name; });
+  return sorted;
+}
+
+template <typename Entry>
+bool StartsFamily(const std::vector<const Entry*>& sorted, std::size_t i) {
+  return i == 0 or sorted[i - 1]->name != sorted[i]->name;
+}
+
+constexpr unsigned min_exported_exponent = 10; // 1.024 us
+constexpr unsigned max_exported_exponent = 36; // 68.7 s
+
+} // anonymous namespace
+
+void Registry::WritePrometheusText(std::ostream& output) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto counters = SortedByName(counters_);
+  for (std::size_t i = 0; i < counters.size(); i++) {
+    if (StartsFamily(counters, i)) {
+      output << "# HELP " << counters[i]->name << ' ' << counters[i]->help << '\n';
+      output << "# TYPE " << counters[i]->name << " counter\n";
+    }
+    output << counters[i]->name;
+    WriteLabels(output, counters[i]->labels);
+    output << ' ' << counters[i]->metric->GetValue() << '\n';
+  }
+
+  const auto histograms = SortedByName(histograms_);
+  for (std::size_t i = 0; i < histograms.size(); i++) {
+    const auto& entry = *histograms[i];
+    if (StartsFamily(histograms, i)) {
+      output << "# HELP " << entry.name << ' ' << entry.help << '\n';
+      output << "# TYPE " << entry.name << " histogram\n";
+    }
+    const auto snapshot = entry.metric->GetSnapshot();
+    char le[32];
+    for (unsigned exponent = min_exported_exponent; exponent <= max_exported_exponent; exponent++) {
+      const auto bound = std::uint64_t{1} << exponent;
+      std::snprintf(le, sizeof(le), "%.9g", bound * 1e-9);
+      output << entry.name << "_bucket";
+      WriteLabels(output, entry.labels, le);
+      output << ' ' << snapshot.CountBelow(bound) << '\n';
+    }
+    output << entry.name << "_bucket";
+    WriteLabels(output, entry.labels, "+Inf");
+    output << ' ' << snapshot.count << '\n';
+    output << entry.name << "_sum";
+    WriteLabels(output, entry.labels);
+    std::snprintf(le, sizeof(le), "%.9g", std::chrono::duration<double>(snapshot.sum).count());
+    output << ' ' << le << '\n';
+    output << entry.name << "_count";
+    WriteLabels(output, entry.labels);
+    output << ' ' << snapshot.count << '\n';
+  }
+}
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+FileExporter::FileExporter(const Registry& registry, std::string path, std::chrono::milliseconds interval)
+    : registry_{registry}, path_{std::move(path)}, interval_{interval}, thread_{&FileExporter::Run, this} {}
+
+FileExporter::~FileExporter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wakeup_.notify_all();
+  thread_.join();
+  try {
+    WriteNow();
+  } catch (std::exception& e) {
+    LOG(ERROR) << "Writing metrics failed: " << e.what();
+  }
+}
+
+void FileExporter::WriteNow() const {
+  const auto temporary_path = path_ + ".tmp";
+  {
+    std::ofstream output(temporary_path, std::ios::trunc);
+    registry_.WritePrometheusText(output);
+    output.close();
+    if (not output) {
+      throw std::system_error(errno, std::generic_category(), "writing " + temporary_path);
+    }
+  }
+  if (std::rename(temporary_path.c_str(), path_.c_str()) != 0) {
+    throw std::system_error(errno, std::generic_category(), "renaming " + temporary_path);
+  }
+}
+
+void FileExporter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (not wakeup_.wait_for(lock, interval_, [this] { return stop_; })) {
+    try {
+      WriteNow();
+    } catch (std::exception& e) {
+      LOG(ERROR) << "Writing metrics failed: " << e.what();
+    }
+  }
+}
+
+} // namespace tpxai::metrics
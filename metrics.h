@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tpxai::metrics {
+
+// Every metric is split into shards, each thread updates the shard picked on its first recording. Shards are merged
+// only when the metrics are read, so recording is a single uncontended relaxed atomic add which never allocates.
+constexpr std::size_t shard_count = 8;
+
+inline std::size_t GetThreadShard() {
+  static std::atomic<std::size_t> next_shard{0};
+  thread_local const std::size_t shard = next_shard++ % shard_count;
+  return shard;
+}
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+class Counter {
+public:
+  void Add(std::uint64_t value = 1) {
+    shards_[GetThreadShard()].value.fetch_add(value, std::memory_order_relaxed);
+  }
+  std::uint64_t GetValue() const;
+
+private:
+  struct alignas(64) Shard {
+    std::atomic<std::uint64_t> value{0};
+  };
+  std::array<Shard, shard_count> shards_;
+};
+
+// Log-linear histogram of durations: values below 8 ns have buckets of their own, above that every power of two is
+// split into 8 linear sub-buckets, which bounds the relative error by 12.5%. Covers up to 2^48 ns (about 3 days).
+class Histogram {
+public:
+  static constexpr unsigned sub_bucket_bits = 3;
+  static constexpr unsigned sub_bucket_count = 1u << sub_bucket_bits;
+  static constexpr unsigned max_exponent = 47;
+  static constexpr std::size_t bucket_count = (max_exponent - sub_bucket_bits + 2) * sub_bucket_count;
+
+  static std::size_t GetBucket(std::uint64_t nanoseconds);
+  // smallest value which does not fit the bucket anymore
+  static std::uint64_t GetBucketUpperBound(std::size_t bucket);
+
+  void Record(std::chrono::nanoseconds duration) {
+    const auto value = static_cast<std::uint64_t>(std::max<std::int64_t>(duration.count(), 0));
+    auto& shard = shards_[GetThreadShard()];
+    shard.buckets[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  struct Snapshot {
+    std::array<std::uint64_t, bucket_count> buckets = {};
+    std::uint64_t count = 0;
+    std::chrono::nanoseconds sum{0};
+
+    // upper bound of the bucket holding the given quantile, zero when empty
+    std::chrono::nanoseconds GetPercentile(double quantile) const;
+    // number of values below the given bound, exact when the bound is a power of two
+    std::uint64_t CountBelow(std::uint64_t nanoseconds) const;
+  };
+  Snapshot GetSnapshot() const;
+
+private:
+  struct alignas(64) Shard {
+    std::array<std::atomic<std::uint64_t>, bucket_count> buckets = {};
+    std::atomic<std::uint64_t> sum{0};
+  };
+  std::array<Shard, shard_count> shards_;
+};
+
+// Records the lifetime of the scope into a histogram.
+class ScopedTimer {
+public:
+  explicit ScopedTimer(Histogram& histogram)
+      : histogram_{histogram}, start_{std::chrono::steady_clock::now()} {}
+  ~ScopedTimer() { histogram_.Record(std::chrono::steady_clock::now() - start_); }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+  Histogram& histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Owns all metrics. Registration takes a lock and allocates, so it belongs in constructors. The returned references
+// stay valid for the lifetime of the registry and are what the hot paths record into. Registering the same name and
+// labels twice returns the same metric.
+class Registry {
+public:
+  Counter& GetCounter(const std::string& name, const std::string& help, const Labels& labels = {});
+  Histogram& GetHistogram(const std::string& name, const std::string& help, const Labels& labels = {});
+
+  // Prometheus text exposition format. Durations are exported in seconds with a bucket per power of two from 2^10 ns
+  // (about 1 us) to 2^36 ns (about 69 s).
+  void WritePrometheusText(std::ostream& output) const;
+
+private:
+  template <typename Metric>
+  struct Entry {
+    std::string name;
+    std::string help;
+    Labels labels;
+    std::unique_ptr<Metric> metric;
+  };
+
+  template <typename Metric>
+  Metric& Get(std::vector<Entry<Metric>>& entries, const std::string& name, const std::string& help,
+              const Labels& labels);
+
+  mutable std::mutex mutex_;
+  std::vector<Entry<Counter>> counters_;
+  std::vector<Entry<Histogram>> histograms_;
+};
+
+// The process wide registry the application components record into.
+Registry& GetRegistry();
+
+// Periodically writes the registry to a file in the Prometheus text format, e.g. for node_exporter's textfile
+// collector. The file is replaced atomically, so a scraper never sees a partial one.
+class FileExporter {
+public:
+  FileExporter(const Registry& registry, std::string path,
+               std::chrono::milliseconds interval = std::chrono::milliseconds{10000});
+  ~FileExporter();
+
+  FileExporter(const FileExporter&) = delete;
+  FileExporter& operator=(const FileExporter&) = delete;
+
+  void WriteNow() const;
+
+private:
+  void Run();
+
+  const Registry& registry_;
+  const std::string path_;
+  const std::chrono::milliseconds interval_;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+} // namespace tpxai::metrics
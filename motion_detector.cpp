@@ -0,0 +1,117 @@
+#include "motion_detector.h"
+
+#include <vector>
+
+#include <glog/logging.h>
+#include <opencv2/calib3d.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "position_calculator.h"
+
+namespace tpxai {
+
+MotionDetector::MotionDetector(MotionDetectorSettings settings)
+    : settings_{settings}, dilate_kernel_{cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3))} {}
+
+void MotionDetector::Reset() { background_frames_ = 0; }
+
+std::optional<MotionDetection> MotionDetector::Process(const Frame& frame) {
+  if (frame.camera_moving or frame.image.empty()) {
+    Reset();
+    return std::nullopt;
+  }
+  if (background_frames_ > 0 and
+      (frame.image.size() != background_frame_size_ or frame.zoom_multiple != background_zoom_ or
+       frame.position.horizontal_angle != background_position_.horizontal_angle or
+       frame.position.vertical_angle != background_position_.vertical_angle)) {
+    Reset();
+  }
+
+  const double scale = static_cast<double>(settings_.analysis_width) / frame.image.cols;
+  cv::resize(frame.image, small_, cv::Size(), scale, scale, cv::INTER_AREA);
+  if (small_.channels() == 1) {
+    small_.copyTo(gray_);
+  } else {
+    cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+  }
+
+  if (background_frames_ == 0) {
+    gray_.convertTo(background_, CV_32F);
+    background_position_ = frame.position;
+    background_zoom_ = frame.zoom_multiple;
+    background_frame_size_ = frame.image.size();
+    background_frames_ = 1;
+    return std::nullopt;
+  }
+
+  std::optional<MotionDetection> result;
+  if (background_frames_ >= settings_.warmup_frames) {
+    background_.convertTo(rounded_background_, CV_8U);
+    cv::absdiff(gray_, rounded_background_, difference_);
+    cv::threshold(difference_, mask_, settings_.difference_threshold, 255, cv::THRESH_BINARY);
+    cv::dilate(mask_, mask_, dilate_kernel_);
+
+    const int labels = cv::connectedComponentsWithStats(mask_, labels_, stats_, centroids_, 8, CV_32S);
+    int largest = 0;
+    int largest_area = settings_.min_blob_area - 1;
+    for (int label = 1; label < labels; label++) { // label 0 is the background
+      const auto area = stats_.at<int>(label, cv::CC_STAT_AREA);
+      if (area > largest_area) {
+        largest = label;
+        largest_area = area;
+      }
+    }
+    if (largest > 0) {
+      const double inverse_scale = 1.0 / scale;
+      MotionDetection detection;
+      detection.centroid = cv::Point2f(static_cast<float>(centroids_.at<double>(largest, 0) * inverse_scale),
+                                       static_cast<float>(centroids_.at<double>(largest, 1) * inverse_scale));
+      detection.bounding_box = cv::Rect(static_cast<int>(stats_.at<int>(largest, cv::CC_STAT_LEFT) * inverse_scale),
+                                        static_cast<int>(stats_.at<int>(largest, cv::CC_STAT_TOP) * inverse_scale),
+                                        static_cast<int>(stats_.at<int>(largest, cv::CC_STAT_WIDTH) * inverse_scale),
+                                        static_cast<int>(stats_.at<int>(largest, cv::CC_STAT_HEIGHT) * inverse_scale));
+      detection.area = largest_area;
+      result = detection;
+    }
+  }
+
+  cv::accumulateWeighted(gray_, background_, settings_.background_rate);
+  background_frames_++;
+  return result;
+}
+
+MotionAutoPointer::MotionAutoPointer(dahua::DahuaPTZCamera& camera, MotionDetectorSettings settings,
+                                     std::chrono::milliseconds cooldown)
+    : camera_{camera}, detector_{settings}, cooldown_{cooldown} {}
+
+void MotionAutoPointer::OnFrame(const Frame& frame) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto detection = detector_.Process(frame);
+  VLOG(2) << "Motion detection took "
+          << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()
+          << " us";
+
+  if (not detection or frame.capture_time < last_move_time_ + cooldown_) {
+    return;
+  }
+
+  const auto intrinsics = camera_.GetIntrinsics().ForZoom(frame.zoom_multiple);
+  // the blob was found in the distorted frame, the position calculator assumes an ideal pinhole
+  const std::vector<cv::Point2d> centroid{cv::Point2d(detection->centroid.x, detection->centroid.y)};
+  std::vector<cv::Point2d> undistorted;
+  cv::undistortPoints(centroid, undistorted, intrinsics.K, intrinsics.distortion_coeffs, cv::Matx33d::eye(),
+                      intrinsics.K);
+  const Eigen::Vector3f current_position{frame.position.vertical_angle, frame.position.horizontal_angle, 0};
+  const Eigen::Vector3f new_position =
+      CalculateAbsolutePosition(cv::Point(undistorted.front()), intrinsics.K, current_position);
+
+  LOG(INFO) << "Motion of " << detection->area << " px at (" << detection->centroid.x << ", "
+            << detection->centroid.y << "), PTZ move: (" << current_position[0] << ", " << current_position[1]
+            << ") -> (" << new_position[0] << ", " << new_position[1] << ")";
+
+  last_move_time_ = std::chrono::steady_clock::now();
+  camera_.SetAbsolutePosition(PTZCameraPosition{new_position[1], new_position[0]});
+  detector_.Reset();
+}
+
+} // namespace tpxai
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+#include <opencv2/core.hpp>
+
+#include "dahua_ptz_camera.h"
+#include "frame.h"
+
+namespace tpxai {
+
+struct MotionDetectorSettings {
+  int analysis_width = 160;       // frames are downscaled to this width before any processing
+  double background_rate = 0.05;  // weight of the current frame in the running-average background
+  int difference_threshold = 25;  // gray level difference from the background that counts as motion
+  int min_blob_area = 12;         // in downscaled pixels
+  int warmup_frames = 10;         // frames needed to build the background after a reset
+};
+
+struct MotionDetection {
+  cv::Point2f centroid; // full-resolution pixel coordinates
+  cv::Rect bounding_box; // full-resolution pixel coordinates
+  int area = 0;          // downscaled pixels
+};
+
+// Frame differencing against a running-average background on a small grayscale copy of the frame. All per-pixel
+// steps (resize, color conversion, averaging, absolute difference, threshold) use OpenCV's vectorized kernels and
+// preallocated buffers. Frames captured while the camera slews reset the background instead of being analyzed, and so
+// does a change of the pose, zoom or frame size, e.g. when the stream tuner switches the resolution.
+class MotionDetector {
+public:
+  explicit MotionDetector(MotionDetectorSettings settings = {});
+
+  // Returns the largest moving blob.
+  std::optional<MotionDetection> Process(const Frame& frame);
+
+  void Reset();
+
+private:
+  MotionDetectorSettings settings_;
+  int background_frames_ = 0;
+  PTZCameraPosition background_position_;
+  std::uint16_t background_zoom_ = 0;
+  cv::Size background_frame_size_;
+  cv::Mat small_;
+  cv::Mat gray_;
+  // in floating point, an 8-bit average would get stuck as soon as the weighted change of a pixel rounds to zero
+  cv::Mat background_;
+  cv::Mat rounded_background_;
+  cv::Mat difference_;
+  cv::Mat mask_;
+  cv::Mat dilate_kernel_;
+  cv::Mat labels_;
+  cv::Mat stats_;
+  cv::Mat centroids_;
+};
+
+// Points the camera at the largest moving blob. After each move it waits for the camera to settle and for the
+// detector to rebuild its background, and it never moves more often than the cooldown allows.
+class MotionAutoPointer {
+public:
+  MotionAutoPointer(dahua::DahuaPTZCamera& camera, MotionDetectorSettings settings = {},
+                    std::chrono::milliseconds cooldown = std::chrono::milliseconds{3000});
+
+  void OnFrame(const Frame& frame);
+
+private:
+  dahua::DahuaPTZCamera& camera_;
+  MotionDetector detector_;
+  std::chrono::milliseconds cooldown_;
+  std::chrono::steady_clock::time_point last_move_time_;
+};
+
+} // namespace tpxai
@@ -4,16 +4,26 @@
 #include <opencv2/opencv.hpp>
 
 #include "dahua_ptz_camera.h"
+#include "geometry.h"
 
 namespace tpxai {
 
-inline Eigen::Vector3f DegreesToRadians(Eigen::Vector3f degrees) noexcept { return degrees * CV_PI / 180; }
-
-constexpr float DegreesToRadians(float degrees) noexcept { return degrees * CV_PI / 180; }
-
-inline Eigen::Vector3f RadiansToDegrees(Eigen::Vector3f radians) noexcept { return radians * 180 / CV_PI; }
-
+// The pose, as Euler angles in degrees (tilt, pan, 0), which centers the given pixel of a frame taken at the current
+// pose. Runs the float path of the geometry core, use geometry::PoseProjector directly to map many pixels of one pose
+// or for double precision.
 Eigen::Vector3f CalculateAbsolutePosition(const cv::Point& point, const cv::Matx33d& K,
                                           const Eigen::Vector3f& current_euler_angles_in_degrees);
 
+struct PTZTarget {
+  Eigen::Vector3f euler_angles_in_degrees;
+  std::uint16_t zoom_multiple = 1;
+};
+
+// Solves pan, tilt and zoom at once so that the given region of the current frame fills the view after a single
+// PositionABS command. The zoom multiple is rounded down so that the whole region stays visible.
+PTZTarget CalculateAbsolutePositionForRegion(const cv::Rect& region, const CameraIntrinsics& intrinsics,
+                                             const cv::Size& frame_size,
+                                             const Eigen::Vector3f& current_euler_angles_in_degrees,
+                                             std::uint16_t current_zoom_multiple, std::uint16_t max_zoom_multiple);
+
 } // namespace tpxai
@@ -0,0 +1,102 @@
+#include "preview_display.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <opencv2/highgui.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "trace.h"
+
+namespace tpxai {
+
+cv::Point Preview::ToFrame(const cv::Point& point) const {
+  return {point.x * frame_size.width / image.cols, point.y * frame_size.height / image.rows};
+}
+
+cv::Rect Preview::ToFrame(const cv::Rect& region) const {
+  return {ToFrame(region.tl()), ToFrame(region.br())};
+}
+
+PreviewDisplay::PreviewDisplay(FrameBus& bus, const dahua::DahuaPTZCamera& camera, std::string window,
+                               PreviewSettings settings)
+    : camera_{camera}, window_{std::move(window)}, settings_{settings},
+      render_duration_{metrics::GetRegistry().GetHistogram(
+          "goto_point_preview_render_duration_seconds", "Time to undistort, downscale and annotate a preview")},
+      frame_to_glass_{metrics::GetRegistry().GetHistogram("goto_point_frame_age_at_display_seconds",
+                                                          "Time from decoding a frame to painting it in the preview")},
+      skipped_presents_{metrics::GetRegistry().GetCounter(
+          "goto_point_skipped_presents_total", "Rendered previews replaced by a newer one before being presented")},
+      next_present_{std::chrono::steady_clock::now()},
+      renderer_{bus, 1, BackpressurePolicy::drop_oldest, [this](const SharedFrame& frame) { Render(frame); },
+                &metrics::GetRegistry().GetCounter("goto_point_dropped_frames_total",
+                                                   "Frames dropped by a consumer that could not keep up",
+                                                   {{"consumer", "preview"}})} {}
+
+void PreviewDisplay::Render(const SharedFrame& frame) {
+  trace::Span span("display", "Render");
+  metrics::ScopedTimer timer(render_duration_);
+  auto preview = std::make_shared<Preview>();
+  preview->frame_size = frame->image.size();
+  preview->sequence = frame->sequence;
+  preview->capture_time = frame->capture_time;
+
+  const double scale = std::min(1.0, static_cast<double>(settings_.max_width) / frame->image.cols);
+  const cv::Size size(static_cast<int>(std::lround(frame->image.cols * scale)),
+                      static_cast<int>(std::lround(frame->image.rows * scale)));
+  const auto intrinsics = camera_.GetIntrinsics();
+  undistorter_.Undistort(frame->image, preview->image, intrinsics, frame->zoom_multiple, size);
+  const cv::Point center(static_cast<int>(std::lround(intrinsics.center().x * scale)),
+                         static_cast<int>(std::lround(intrinsics.center().y * scale)));
+  cv::circle(preview->image, center, 5, cv::viz::Color::red(), cv::FILLED);
+
+  std::lock_guard lock(mutex_);
+  if (newest_) {
+    skipped_presents_.Add();
+  }
+  newest_ = std::move(preview);
+}
+
+int PreviewDisplay::Present(const std::optional<cv::Rect>& region) {
+  std::shared_ptr<const Preview> preview;
+  {
+    std::lock_guard lock(mutex_);
+    preview = std::move(newest_);
+  }
+  if (preview) {
+    presented_ = preview;
+  }
+  // while a region is dragged it is redrawn on every present, also without a new frame
+  if (presented_ and (preview or region or outlined_shown_)) {
+    trace::Span span("display", "imshow");
+    if (region) {
+      presented_->image.copyTo(outlined_);
+      cv::rectangle(outlined_, *region, cv::viz::Color::red(), 2);
+      cv::imshow(window_, outlined_);
+    } else {
+      cv::imshow(window_, presented_->image);
+    }
+    outlined_shown_ = region.has_value();
+  }
+  int key = -1;
+  {
+    trace::Span span("display", "waitKey");
+    // repaints the window
+    key = cv::waitKey(1);
+  }
+  const auto now = std::chrono::steady_clock::now();
+  if (preview) {
+    frame_to_glass_.Record(now - preview->capture_time);
+  }
+
+  // a late present moves the schedule instead of being followed by a burst of catch-up presents
+  next_present_ = std::max(next_present_ + settings_.present_interval, now);
+  const auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(next_present_ - now);
+  if (key < 0 and idle.count() > 0) {
+    key = cv::waitKey(static_cast<int>(idle.count()));
+  }
+  return key;
+}
+
+} // namespace tpxai
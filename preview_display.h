@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+#include "dahua_ptz_camera.h"
+#include "frame_bus.h"
+#include "frame_undistorter.h"
+#include "metrics.h"
+
+namespace tpxai {
+
+struct PreviewSettings {
+  int max_width = 1280;                           // frames are downscaled to fit, in the undistortion pass
+  std::chrono::milliseconds present_interval{16}; // roughly the refresh rate of a 60 Hz monitor
+};
+
+// A frame rendered for the window: undistorted, downscaled and with the principal point marked.
+struct Preview {
+  cv::Mat image;
+  cv::Size frame_size; // of the full-resolution frame
+  std::uint64_t sequence = 0;
+  std::chrono::steady_clock::time_point capture_time;
+
+  // from preview to undistorted full-resolution pixels
+  cv::Point ToFrame(const cv::Point& point) const;
+  cv::Rect ToFrame(const cv::Rect& region) const;
+};
+
+// Splits the preview in two stages so that neither the decoder nor the UI waits for the other: a render thread takes
+// the newest frame from the bus and renders it at window resolution, and the UI thread presents the newest rendered
+// preview at a fixed pace, handling window events in between. Previews which are replaced before being presented
+// are counted as skipped, the time from decoding a frame to painting it as its frame-to-glass latency.
+class PreviewDisplay {
+public:
+  PreviewDisplay(FrameBus& bus, const dahua::DahuaPTZCamera& camera, std::string window,
+                 PreviewSettings settings = {});
+
+  PreviewDisplay(const PreviewDisplay&) = delete;
+  PreviewDisplay& operator=(const PreviewDisplay&) = delete;
+
+  // To be called in a loop on the thread owning the window. Shows the newest preview, if one was rendered since the
+  // last call, with the given region outlined and handles window events until the next present is due. Returns the
+  // code of a pressed key or -1, like cv::waitKey.
+  int Present(const std::optional<cv::Rect>& region = std::nullopt);
+
+  // The preview shown in the window, null before the first one. Only valid on the presenting thread.
+  const Preview* GetPresented() const { return presented_.get(); }
+
+private:
+  void Render(const SharedFrame& frame);
+
+  const dahua::DahuaPTZCamera& camera_;
+  const std::string window_;
+  const PreviewSettings settings_;
+  metrics::Histogram& render_duration_;
+  metrics::Histogram& frame_to_glass_;
+  metrics::Counter& skipped_presents_;
+  FrameUndistorter undistorter_; // render thread only
+  std::mutex mutex_;
+  std::shared_ptr<const Preview> newest_; // rendered but not presented yet
+  std::shared_ptr<const Preview> presented_;
+  cv::Mat outlined_;
+  bool outlined_shown_ = false;
+  std::chrono::steady_clock::time_point next_present_;
+  FrameConsumer renderer_; // last, so its thread stops before the rest is destroyed
+};
+
+} // namespace tpxai
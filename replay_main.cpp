@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <glog/logging.h>
+
+#include "frame_bus.h"
+#include "metrics.h"
+#include "motion_detector.h"
+#include "session_replay.h"
+
+namespace {
+
+double ToMilliseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void PrintPercentiles(const char* name, const tpxai::metrics::Histogram& histogram) {
+  const auto snapshot = histogram.GetSnapshot();
+  std::cout << std::left << std::setw(28) << name << std::right << " count " << std::setw(8) << snapshot.count
+            << "  p50 " << std::setw(9) << ToMilliseconds(snapshot.GetPercentile(0.5)) << " ms  p99 " << std::setw(9)
+            << ToMilliseconds(snapshot.GetPercentile(0.99)) << " ms\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) try {
+  if (argc < 2 or argc > 3 or (argc == 3 and std::strcmp(argv[2], "--fast") != 0)) {
+    std::cerr << "Usage: " << argv[0] << " <session log> [--fast]" << std::endl;
+    return 2;
+  }
+  const auto speed = argc == 3 ? tpxai::session::ReplaySpeed::fastest : tpxai::session::ReplaySpeed::recorded;
+  const tpxai::session::SessionLog log(argv[1]);
+
+  tpxai::session::ReplayStats stats;
+  tpxai::metrics::Histogram motion_duration;
+  tpxai::FrameBus bus;
+  {
+    // as fast as possible the consumer sets the pace, at recorded speed it drops frames like it would live
+    tpxai::FrameConsumer motion_detection(
+        bus, 1,
+        speed == tpxai::session::ReplaySpeed::fastest ? tpxai::BackpressurePolicy::block
+                                                      : tpxai::BackpressurePolicy::drop_oldest,
+        [&motion_duration, detector = std::make_shared<tpxai::MotionDetector>()](const tpxai::SharedFrame& frame) {
+          tpxai::metrics::ScopedTimer timer(motion_duration);
+          detector->Process(*frame);
+        });
+    tpxai::session::SessionReplay(log, bus, speed).Run(stats);
+    bus.Close();
+    const auto replay_seconds = std::chrono::duration<double>(stats.replay_duration).count();
+    std::cout << "records                      " << log.GetRecords().size() << "\n"
+              << "recorded duration            " << std::chrono::duration<double>(stats.recorded_duration).count()
+              << " s\n"
+              << "replay duration              " << replay_seconds << " s\n"
+              << "frames                       " << stats.frames << " (" << stats.frames / replay_seconds
+              << " fps)\n"
+              << "motion detection drops       " << motion_detection.GetSubscription().GetDroppedFrames() << "\n"
+              << "clicks                       " << stats.clicks << " (" << stats.click_mismatches
+              << " recalculated differently)\n"
+              << "HTTP requests                " << stats.http_requests << " (" << stats.http_failures
+              << " failed)\n";
+  }
+  PrintPercentiles("motion detection", motion_duration);
+  PrintPercentiles("position calculation", stats.calculation_duration);
+  for (const auto& [code, duration] : stats.http_duration) {
+    PrintPercentiles(("HTTP " + code).c_str(), duration);
+  }
+  return stats.click_mismatches == 0 ? 0 : 1;
+} catch (std::exception& e) {
+  std::cerr << e.what() << std::endl;
+  return 1;
+} catch (...) {
+  std::cerr << "Unknown error" << std::endl;
+  return 1;
+}
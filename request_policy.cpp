@@ -0,0 +1,133 @@
+#include "request_policy.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glog/logging.h>
+
+namespace tpxai::dahua {
+
+LatencyWindow::LatencyWindow(std::size_t capacity) : samples_(capacity) {
+  CHECK(capacity > 0);
+  sorted_.reserve(capacity);
+}
+
+void LatencyWindow::Add(std::chrono::microseconds sample) {
+  samples_[next_] = sample;
+  next_ = (next_ + 1) % samples_.size();
+  count_ = std::min(count_ + 1, samples_.size());
+}
+
+std::chrono::microseconds LatencyWindow::GetPercentile(double quantile) const {
+  if (count_ == 0) {
+    return std::chrono::microseconds{0};
+  }
+  sorted_.assign(samples_.begin(), samples_.begin() + count_);
+  const auto rank = static_cast<std::size_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * count_));
+  const auto nth = sorted_.begin() + (rank == 0 ? 0 : rank - 1);
+  std::nth_element(sorted_.begin(), nth, sorted_.end());
+  return *nth;
+}
+
+LatencyTracker::LatencyTracker(TimeoutSettings settings) : settings_{settings} {}
+
+void LatencyTracker::Record(const RequestTiming& timing) {
+  if (timing.connect.count() > 0) {
+    connect_.Add(timing.connect);
+  }
+  if (timing.tls.count() > 0) {
+    tls_.Add(timing.tls);
+  }
+  first_byte_.Add(timing.first_byte);
+  total_.Add(timing.total);
+}
+
+void LatencyTracker::RecordTimeout(std::chrono::milliseconds timeout) {
+  total_.Add(timeout);
+}
+
+Timeouts LatencyTracker::GetTimeouts() const {
+  const auto total = Derive(total_, settings_.min_timeout);
+  return {std::min(Derive(connect_, settings_.min_connect_timeout), total), total};
+}
+
+std::chrono::milliseconds LatencyTracker::Derive(const LatencyWindow& window,
+                                                 std::chrono::milliseconds min_timeout) const {
+  if (window.GetSampleCount() < settings_.min_samples) {
+    return settings_.max_timeout;
+  }
+  const auto percentile = std::chrono::duration<double, std::milli>(window.GetPercentile(settings_.quantile));
+  const std::chrono::milliseconds timeout{static_cast<long>(std::ceil(percentile.count() * settings_.multiplier))};
+  return std::clamp(timeout, min_timeout, settings_.max_timeout);
+}
+
+std::chrono::milliseconds BackoffDelay(const RetrySettings& settings, unsigned attempt, std::minstd_rand& rng) {
+  const auto cap = std::min(settings.base_backoff * (1L << std::min(attempt, 16u)), settings.max_backoff);
+  std::uniform_int_distribution<long> jitter(0, cap.count() / 2);
+  return cap - cap / 2 + std::chrono::milliseconds{jitter(rng)};
+}
+
+bool IsTransientFailure(CURLcode code) {
+  switch (code) {
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+    case CURLE_OPERATION_TIMEDOUT:
+    case CURLE_SEND_ERROR:
+    case CURLE_RECV_ERROR:
+    case CURLE_GOT_NOTHING:
+    case CURLE_PARTIAL_FILE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool IsConnectFailure(CURLcode code, bool connected) {
+  switch (code) {
+    case CURLE_COULDNT_RESOLVE_HOST:
+    case CURLE_COULDNT_CONNECT:
+      return true;
+    case CURLE_OPERATION_TIMEDOUT:
+      return not connected;
+    default:
+      return false;
+  }
+}
+
+CircuitBreaker::CircuitBreaker(CircuitBreakerSettings settings) : settings_{settings} {
+  CHECK(settings_.failure_threshold > 0);
+}
+
+bool CircuitBreaker::AllowRequest() const {
+  std::lock_guard lock(mutex_);
+  return not open_;
+}
+
+bool CircuitBreaker::RecordFailure() {
+  std::lock_guard lock(mutex_);
+  ++consecutive_failures_;
+  if (not open_ and consecutive_failures_ >= settings_.failure_threshold) {
+    open_ = true;
+    return true;
+  }
+  return false;
+}
+
+bool CircuitBreaker::RecordSuccess() {
+  std::lock_guard lock(mutex_);
+  consecutive_failures_ = 0;
+  const bool was_open = open_;
+  open_ = false;
+  return was_open;
+}
+
+std::chrono::milliseconds CircuitBreaker::GetProbeDelay(unsigned probe) const {
+  return std::min(settings_.probe_interval * (1L << std::min(probe, 16u)), settings_.max_probe_interval);
+}
+
+unsigned CircuitBreaker::GetConsecutiveFailures() const {
+  std::lock_guard lock(mutex_);
+  return consecutive_failures_;
+}
+
+} // namespace tpxai::dahua
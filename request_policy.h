@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <curl/curl.h>
+
+namespace tpxai::dahua {
+
+// Cumulative times since the start of a single HTTP exchange, as reported by curl
+struct RequestTiming {
+  std::chrono::microseconds connect{0}; // zero when an already open connection was reused
+  std::chrono::microseconds tls{0};     // zero for plain HTTP
+  std::chrono::microseconds first_byte{0};
+  std::chrono::microseconds total{0};
+};
+
+// Sliding window over the most recent latency samples of a single phase
+class LatencyWindow {
+public:
+  explicit LatencyWindow(std::size_t capacity = 128);
+
+  void Add(std::chrono::microseconds sample);
+  std::size_t GetSampleCount() const { return count_; }
+  // nearest-rank percentile, quantile in [0, 1], zero while the window is empty
+  std::chrono::microseconds GetPercentile(double quantile) const;
+
+private:
+  std::vector<std::chrono::microseconds> samples_;
+  std::size_t next_ = 0;
+  std::size_t count_ = 0;
+  mutable std::vector<std::chrono::microseconds> sorted_;
+};
+
+struct TimeoutSettings {
+  double quantile = 0.99;
+  double multiplier = 3.0;
+  std::size_t min_samples = 16; // below that the maximal timeouts apply
+  std::chrono::milliseconds min_connect_timeout{100};
+  std::chrono::milliseconds min_timeout{250};
+  std::chrono::milliseconds max_timeout{5000};
+};
+
+struct Timeouts {
+  std::chrono::milliseconds connect;
+  std::chrono::milliseconds total;
+};
+
+// Tracks the latency distribution of the requests sent to one camera and derives the timeouts from its high
+// percentile, so a dead camera is given up on quickly while a slow one still gets enough time to answer.
+class LatencyTracker {
+public:
+  explicit LatencyTracker(TimeoutSettings settings = {});
+
+  void Record(const RequestTiming& timing);
+  // A timed out request took at least the timeout, feeding it back widens the timeouts of a camera that slows down.
+  void RecordTimeout(std::chrono::milliseconds timeout);
+  Timeouts GetTimeouts() const;
+
+  const LatencyWindow& GetConnectLatency() const { return connect_; }
+  const LatencyWindow& GetTLSLatency() const { return tls_; }
+  const LatencyWindow& GetFirstByteLatency() const { return first_byte_; }
+  const LatencyWindow& GetTotalLatency() const { return total_; }
+
+private:
+  std::chrono::milliseconds Derive(const LatencyWindow& window, std::chrono::milliseconds min_timeout) const;
+
+  TimeoutSettings settings_;
+  LatencyWindow connect_;
+  LatencyWindow tls_;
+  LatencyWindow first_byte_;
+  LatencyWindow total_;
+};
+
+struct RetrySettings {
+  unsigned max_attempts = 3;
+  std::chrono::milliseconds base_backoff{50};
+  std::chrono::milliseconds max_backoff{800};
+};
+
+// Exponential backoff with equal jitter: half of the capped delay is fixed, the other half is random, so retries of
+// several callers spread out but never fire immediately.
+std::chrono::milliseconds BackoffDelay(const RetrySettings& settings, unsigned attempt, std::minstd_rand& rng);
+
+// Transport failures which say nothing about the request itself and may succeed when repeated
+bool IsTransientFailure(CURLcode code);
+
+// Failures before a connection to the camera was established, they say the camera is unreachable however long the
+// request would have taken. connected tells whether curl had a connection when the request failed.
+bool IsConnectFailure(CURLcode code, bool connected);
+
+struct CircuitBreakerSettings {
+  // consecutive requests failing transiently, each after all its attempts, that open the circuit
+  unsigned failure_threshold = 3;
+  std::chrono::milliseconds probe_interval{500};
+  std::chrono::milliseconds max_probe_interval{10000};
+};
+
+// Opens after a run of requests which failed transiently. While open requests fail fast and only background probes reach the
+// camera, the first successful one closes the circuit again. Thread safe, as the probes run on their own thread.
+class CircuitBreaker {
+public:
+  explicit CircuitBreaker(CircuitBreakerSettings settings = {});
+
+  bool AllowRequest() const;
+  // true when this failure has opened the circuit
+  bool RecordFailure();
+  // true when this success has closed the circuit
+  bool RecordSuccess();
+  // delay before the given probe (counted from zero since the circuit opened), doubling up to the maximal interval
+  std::chrono::milliseconds GetProbeDelay(unsigned probe) const;
+  unsigned GetConsecutiveFailures() const;
+
+private:
+  CircuitBreakerSettings settings_;
+  mutable std::mutex mutex_;
+  unsigned consecutive_failures_ = 0;
+  bool open_ = false;
+};
+
+struct RequestPolicySettings {
+  TimeoutSettings timeouts;
+  RetrySettings retries;
+  CircuitBreakerSettings circuit_breaker;
+};
+
+} // namespace tpxai::dahua
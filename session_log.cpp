@@ -0,0 +1,284 @@
+#include "session_log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "curl_error_category.h"
+#include "dahua_error_category.h"
+
+namespace tpxai::session {
+
+namespace {
+
+constexpr std::size_t record_alignment = 8;
+constexpr std::size_t stdio_buffer_size = 1 << 20;
+
+std::size_t Padded(std::size_t size) {
+  return (size + record_alignment - 1) / record_alignment * record_alignment;
+}
+
+template <typename Duration>
+std::int64_t ToNanoseconds(Duration duration) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+ErrorCategory ToErrorCategory(const std::error_code& error) {
+  if (not error) {
+    return ErrorCategory::none;
+  }
+  if (error.category() == dahua::make_error_code(CURLE_OK).category()) {
+    return ErrorCategory::curl;
+  }
+  if (error.category() == dahua::make_error_code(dahua::DahuaErrorCode::ok).category()) {
+    return ErrorCategory::dahua;
+  }
+  return ErrorCategory::other;
+}
+
+// of the variable size data behind the payload struct, which must fit in the record
+std::size_t GetTailSize(RecordType type, const unsigned char* payload) {
+  switch (type) {
+    case RecordType::frame:
+      return reinterpret_cast<const FrameRecord*>(payload)->image_size;
+    case RecordType::http: {
+      const auto& http = *reinterpret_cast<const HTTPRecord*>(payload);
+      return std::size_t{http.code_size} + http.url_size + (http.response_omitted ? 0 : http.response_size);
+    }
+    default:
+      return 0;
+  }
+}
+
+} // anonymous namespace
+
+SessionRecorder::SessionRecorder(const std::string& path, SessionRecorderSettings settings)
+    : settings_{settings}, start_{std::chrono::steady_clock::now()},
+      encode_params_{cv::IMWRITE_JPEG_QUALITY, settings_.jpeg_quality},
+      file_{std::fopen(path.c_str(), "wb"), &std::fclose} {
+  if (not file_) {
+    throw std::system_error(errno, std::generic_category(), "creating session log " + path);
+  }
+  std::setvbuf(file_.get(), nullptr, _IOFBF, stdio_buffer_size);
+  const FileHeader header{log_magic, log_version, ToNanoseconds(start_.time_since_epoch()),
+                          ToNanoseconds(std::chrono::system_clock::now().time_since_epoch())};
+  if (std::fwrite(&header, sizeof(header), 1, file_.get()) != 1) {
+    throw std::system_error(errno, std::generic_category(), "writing session log " + path);
+  }
+  written_bytes_ = sizeof(header);
+}
+
+SessionRecorder::~SessionRecorder() {
+  if (std::fflush(file_.get()) != 0) {
+    LOG(ERROR) << "Writing the session log failed: " << std::strerror(errno);
+  }
+}
+
+void SessionRecorder::Append(RecordType type, std::chrono::steady_clock::time_point time, const void* payload,
+                             std::size_t payload_size,
+                             std::initializer_list<std::pair<const void*, std::size_t>> tail) {
+  std::size_t size = payload_size;
+  for (const auto& [data, data_size] : tail) {
+    size += data_size;
+  }
+  const RecordHeader header{type, static_cast<std::uint32_t>(size), ToNanoseconds(time - start_)};
+  static constexpr char padding[record_alignment] = {};
+
+  const auto write = [this](const void* data, std::size_t data_size) {
+    return data_size == 0 or std::fwrite(data, data_size, 1, file_.get()) == 1;
+  };
+
+  std::lock_guard lock(mutex_);
+  if (failed_) {
+    return;
+  }
+  bool written = write(&header, sizeof(header)) and write(payload, payload_size);
+  for (const auto& [data, data_size] : tail) {
+    written = written and write(data, data_size);
+  }
+  if (not written or not write(padding, Padded(size) - size)) {
+    // a partial record can only be the last one, which the reader skips
+    failed_ = true;
+    LOG(ERROR) << "Writing the session log failed, recording stopped: " << std::strerror(errno);
+    return;
+  }
+  written_bytes_ += sizeof(header) + Padded(size);
+}
+
+void SessionRecorder::RecordIntrinsics(const CameraIntrinsics& intrinsics) {
+  IntrinsicsRecord record{};
+  std::copy(intrinsics.K.val, intrinsics.K.val + 9, record.K);
+  record.distortion_count = static_cast<std::uint32_t>(
+      std::min(intrinsics.distortion_coeffs.size(), std::size(record.distortion)));
+  std::copy_n(intrinsics.distortion_coeffs.begin(), record.distortion_count, record.distortion);
+  Append(RecordType::intrinsics, std::chrono::steady_clock::now(), &record, sizeof(record));
+}
+
+void SessionRecorder::RecordFrame(const Frame& frame) {
+  FrameRecord record{};
+  record.sequence = frame.sequence;
+  record.horizontal_angle = frame.position.horizontal_angle;
+  record.vertical_angle = frame.position.vertical_angle;
+  record.zoom_multiple = frame.zoom_multiple;
+  record.camera_moving = frame.camera_moving;
+  record.width = frame.image.cols;
+  record.height = frame.image.rows;
+  if (not settings_.record_images or frame.image.empty()) {
+    Append(RecordType::frame, frame.capture_time, &record, sizeof(record));
+    return;
+  }
+
+  std::lock_guard lock(encode_mutex_);
+  const cv::Mat* source = &frame.image;
+  if (frame.image.cols > settings_.frame_width) {
+    const double scale = static_cast<double>(settings_.frame_width) / frame.image.cols;
+    cv::resize(frame.image, resized_, cv::Size(), scale, scale, cv::INTER_AREA);
+    source = &resized_;
+  }
+  cv::imencode(".jpg", *source, jpeg_, encode_params_);
+  record.encoding = ImageEncoding::jpeg;
+  record.image_size = static_cast<std::uint32_t>(jpeg_.size());
+  Append(RecordType::frame, frame.capture_time, &record, sizeof(record), {{jpeg_.data(), jpeg_.size()}});
+}
+
+void SessionRecorder::RecordPose(const PTZCameraPosition& position, std::uint16_t zoom_multiple) {
+  PoseRecord record{};
+  record.horizontal_angle = position.horizontal_angle;
+  record.vertical_angle = position.vertical_angle;
+  record.zoom_multiple = zoom_multiple;
+  Append(RecordType::pose, std::chrono::steady_clock::now(), &record, sizeof(record));
+}
+
+void SessionRecorder::RecordClick(const cv::Rect& region, const cv::Size& frame_size,
+                                  const CameraIntrinsics& intrinsics, const PTZCameraPosition& current_position,
+                                  std::uint16_t current_zoom_multiple, std::uint16_t max_zoom_multiple,
+                                  const PTZTarget& target) {
+  ClickRecord record{};
+  record.x = region.x;
+  record.y = region.y;
+  record.width = region.width;
+  record.height = region.height;
+  record.frame_width = frame_size.width;
+  record.frame_height = frame_size.height;
+  record.current_horizontal_angle = current_position.horizontal_angle;
+  record.current_vertical_angle = current_position.vertical_angle;
+  record.current_zoom_multiple = current_zoom_multiple;
+  record.max_zoom_multiple = max_zoom_multiple;
+  record.target_horizontal_angle = target.euler_angles_in_degrees[1];
+  record.target_vertical_angle = target.euler_angles_in_degrees[0];
+  record.target_zoom_multiple = target.zoom_multiple;
+  record.fx = intrinsics.K(0, 0);
+  record.fy = intrinsics.K(1, 1);
+  record.cx = intrinsics.K(0, 2);
+  record.cy = intrinsics.K(1, 2);
+  Append(RecordType::click, std::chrono::steady_clock::now(), &record, sizeof(record));
+}
+
+void SessionRecorder::RecordHTTP(const dahua::HTTPExchange& exchange) {
+  HTTPRecord record{};
+  record.duration_ns = ToNanoseconds(exchange.duration);
+  record.connect_us = exchange.timing.connect.count();
+  record.first_byte_us = exchange.timing.first_byte.count();
+  record.total_us = exchange.timing.total.count();
+  record.error_value = exchange.error.value();
+  record.error_category = ToErrorCategory(exchange.error);
+  const auto code_size = std::strlen(exchange.code);
+  record.code_size = static_cast<std::uint16_t>(code_size);
+  record.url_size = static_cast<std::uint32_t>(exchange.url.size());
+  record.response_size = static_cast<std::uint32_t>(exchange.response.size());
+  record.response_omitted = exchange.binary_response;
+  // a snapshot would cost hundreds of kilobytes per request, the frame records hold the images when wanted
+  const auto written_response_size = exchange.binary_response ? 0 : exchange.response.size();
+  Append(RecordType::http, exchange.start + exchange.duration, &record, sizeof(record),
+         {{exchange.code, code_size}, {exchange.url.data(), exchange.url.size()},
+          {exchange.response.data(), written_response_size}});
+}
+
+std::uint64_t SessionRecorder::GetWrittenBytes() const {
+  std::lock_guard lock(mutex_);
+  return written_bytes_;
+}
+
+bool SessionRecorder::HasFailed() const {
+  std::lock_guard lock(mutex_);
+  return failed_;
+}
+
+SessionLog::SessionLog(const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "opening session log " + path);
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    const auto error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "fstat " + path);
+  }
+  size_ = static_cast<std::size_t>(st.st_size);
+  if (size_ < sizeof(FileHeader)) {
+    close(fd);
+    throw std::runtime_error("not a session log: " + path);
+  }
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data_ == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "mmap " + path);
+  }
+  if (GetHeader().magic != log_magic or GetHeader().version != log_version) {
+    munmap(data_, size_);
+    throw std::runtime_error("not a session log: " + path);
+  }
+  madvise(data_, size_, MADV_SEQUENTIAL);
+  try {
+    Index();
+  } catch (...) {
+    munmap(data_, size_);
+    throw;
+  }
+}
+
+SessionLog::~SessionLog() { munmap(data_, size_); }
+
+void SessionLog::Index() {
+  static const std::size_t payload_sizes[] = {0, sizeof(IntrinsicsRecord), sizeof(FrameRecord), sizeof(PoseRecord),
+                                              sizeof(ClickRecord), sizeof(HTTPRecord)};
+  const auto data = static_cast<const unsigned char*>(data_);
+  std::size_t offset = sizeof(FileHeader);
+  while (offset + sizeof(RecordHeader) <= size_) {
+    const auto& header = *reinterpret_cast<const RecordHeader*>(data + offset);
+    if (offset + sizeof(RecordHeader) + header.size > size_) {
+      LOG(WARNING) << "Session log cut short after " << records_.size() << " records";
+      return;
+    }
+    const auto type = static_cast<std::uint32_t>(header.type);
+    const auto payload = data + offset + sizeof(RecordHeader);
+    if (type == 0 or type >= std::size(payload_sizes) or header.size < payload_sizes[type] or
+        payload_sizes[type] + GetTailSize(header.type, payload) > header.size) {
+      throw std::runtime_error("malformed session log record at offset " + std::to_string(offset));
+    }
+    records_.push_back({header.type, std::chrono::nanoseconds{header.time_ns}, payload, header.size});
+    offset += sizeof(RecordHeader) + Padded(header.size);
+  }
+}
+
+CameraIntrinsics ToIntrinsics(const IntrinsicsRecord& record) {
+  CameraIntrinsics intrinsics;
+  std::copy(record.K, record.K + 9, intrinsics.K.val);
+  const auto count = std::min<std::size_t>(record.distortion_count, std::size(record.distortion));
+  intrinsics.distortion_coeffs.assign(record.distortion, record.distortion + count);
+  return intrinsics;
+}
+
+} // namespace tpxai::session
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "camera_intrinsics.h"
+#include "frame.h"
+#include "http_interface.h"
+#include "position_calculator.h"
+
+namespace tpxai::session {
+
+// Binary session log: a FileHeader followed by records, each a RecordHeader, a fixed size payload struct and its
+// variable size tail, padded to 8 bytes. All structs are plain native endian data, so a memory mapped log is read in
+// place without parsing.
+
+constexpr std::uint32_t log_magic = 0x4c535054; // "TPSL"
+constexpr std::uint32_t log_version = 2;
+
+struct FileHeader {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::int64_t start_steady_ns; // steady clock time of the session start, the records are relative to it
+  std::int64_t start_system_ns;
+};
+
+enum class RecordType : std::uint32_t { intrinsics = 1, frame = 2, pose = 3, click = 4, http = 5 };
+
+struct RecordHeader {
+  RecordType type;
+  std::uint32_t size; // of the payload, without padding
+  std::int64_t time_ns;
+};
+
+struct IntrinsicsRecord {
+  double K[9];
+  std::uint32_t distortion_count;
+  std::uint32_t reserved;
+  double distortion[8];
+};
+
+enum class ImageEncoding : std::uint8_t { none, jpeg };
+
+// followed by image_size bytes of the encoded image
+struct FrameRecord {
+  std::uint64_t sequence;
+  float horizontal_angle;
+  float vertical_angle;
+  std::uint16_t zoom_multiple;
+  std::uint8_t camera_moving;
+  ImageEncoding encoding;
+  std::int32_t width; // of the decoded frame, also when the image is not recorded
+  std::int32_t height;
+  std::uint32_t image_size;
+};
+
+// the camera state after an accepted move command
+struct PoseRecord {
+  float horizontal_angle;
+  float vertical_angle;
+  std::uint16_t zoom_multiple;
+  std::uint16_t reserved[3];
+};
+
+// A double click (zero sized region) or a dragged region in preview coordinates, the pose it started from, the
+// intrinsics at the widest zoom it was calculated with and the target the position calculator chose, so a replay
+// can check the calculation against it. The intrinsics follow the stream resolution, which may change during the
+// session, so they are recorded with every click.
+struct ClickRecord {
+  std::int32_t x;
+  std::int32_t y;
+  std::int32_t width;
+  std::int32_t height;
+  std::int32_t frame_width;
+  std::int32_t frame_height;
+  float current_horizontal_angle;
+  float current_vertical_angle;
+  float target_horizontal_angle;
+  float target_vertical_angle;
+  std::uint16_t current_zoom_multiple;
+  std::uint16_t max_zoom_multiple;
+  std::uint16_t target_zoom_multiple;
+  std::uint16_t reserved;
+  double fx;
+  double fy;
+  double cx;
+  double cy;
+};
+
+enum class ErrorCategory : std::uint8_t { none, curl, dahua, other };
+
+// followed by the CGI code, the URL and the response, binary responses like snapshots are left out and only their size
+// is kept
+struct HTTPRecord {
+  std::int64_t duration_ns; // as seen by the caller, including retries
+  std::int64_t connect_us;
+  std::int64_t first_byte_us;
+  std::int64_t total_us;
+  std::int32_t error_value;
+  ErrorCategory error_category;
+  std::uint8_t response_omitted; // 1 when the response is binary, response_size is then its size but not written
+  std::uint16_t code_size;
+  std::uint32_t url_size;
+  std::uint32_t response_size;
+};
+
+struct SessionRecorderSettings {
+  bool record_images = false;
+  int frame_width = 640; // recorded images are downscaled to this width
+  int jpeg_quality = 75;
+};
+
+// Appends a session to a log file. Thread safe; frames are encoded on the calling thread, which should be a
+// dedicated frame consumer, the other records are small and only copied into the stdio buffer. A failed write, e.g. on
+// a full disk, is logged and stops the recording, so the log stays readable up to the last complete record.
+class SessionRecorder {
+public:
+  // Throws std::system_error when the file cannot be created.
+  explicit SessionRecorder(const std::string& path, SessionRecorderSettings settings = {});
+  ~SessionRecorder();
+
+  SessionRecorder(const SessionRecorder&) = delete;
+  SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+  void RecordIntrinsics(const CameraIntrinsics& intrinsics);
+  void RecordFrame(const Frame& frame);
+  void RecordPose(const PTZCameraPosition& position, std::uint16_t zoom_multiple);
+  // an empty region stands for a double click at its top left corner
+  void RecordClick(const cv::Rect& region, const cv::Size& frame_size, const CameraIntrinsics& intrinsics,
+                   const PTZCameraPosition& current_position, std::uint16_t current_zoom_multiple,
+                   std::uint16_t max_zoom_multiple, const PTZTarget& target);
+  void RecordHTTP(const dahua::HTTPExchange& exchange);
+
+  std::uint64_t GetWrittenBytes() const;
+  bool HasFailed() const;
+
+private:
+  void Append(RecordType type, std::chrono::steady_clock::time_point time, const void* payload,
+              std::size_t payload_size, std::initializer_list<std::pair<const void*, std::size_t>> tail = {});
+
+  const SessionRecorderSettings settings_;
+  const std::chrono::steady_clock::time_point start_;
+  std::vector<int> encode_params_;
+  std::mutex encode_mutex_;
+  cv::Mat resized_;
+  std::vector<unsigned char> jpeg_;
+  mutable std::mutex mutex_;
+  std::unique_ptr<std::FILE, decltype(&std::fclose)> file_;
+  std::uint64_t written_bytes_ = 0;
+  bool failed_ = false;
+};
+
+// A record of a mapped log, valid as long as the log.
+struct Record {
+  RecordType type;
+  std::chrono::nanoseconds time; // since the session start
+  const unsigned char* payload;
+  std::uint32_t size;
+
+  template <typename T>
+  const T& As() const {
+    return *reinterpret_cast<const T*>(payload);
+  }
+  // the variable size data behind the payload struct
+  template <typename T>
+  const unsigned char* Tail() const {
+    return payload + sizeof(T);
+  }
+};
+
+// Memory maps a session log and indexes its records. A log cut short by a crash is read up to its last complete
+// record. Throws std::system_error when the file cannot be mapped and std::runtime_error when it is not a session
+// log or a record is malformed.
+class SessionLog {
+public:
+  explicit SessionLog(const std::string& path);
+  ~SessionLog();
+
+  SessionLog(const SessionLog&) = delete;
+  SessionLog& operator=(const SessionLog&) = delete;
+
+  const FileHeader& GetHeader() const { return *static_cast<const FileHeader*>(data_); }
+  const std::vector<Record>& GetRecords() const { return records_; }
+
+private:
+  void Index();
+
+  void* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::vector<Record> records_;
+};
+
+CameraIntrinsics ToIntrinsics(const IntrinsicsRecord& record);
+
+} // namespace tpxai::session
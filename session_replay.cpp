@@ -0,0 +1,121 @@
+#include "session_replay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <thread>
+
+#include <glog/logging.h>
+#include <opencv2/imgcodecs.hpp>
+
+#include "position_calculator.h"
+
+namespace tpxai::session {
+
+SessionReplay::SessionReplay(const SessionLog& log, FrameBus& bus, ReplaySpeed speed)
+    : log_{log}, bus_{bus}, speed_{speed} {}
+
+void SessionReplay::Run(ReplayStats& stats) {
+  // records are appended by several threads, frames typically some milliseconds after their capture time
+  std::vector<const Record*> records;
+  records.reserve(log_.GetRecords().size());
+  for (const auto& record : log_.GetRecords()) {
+    records.push_back(&record);
+  }
+  std::stable_sort(records.begin(), records.end(), [](auto lhs, auto rhs) { return lhs->time < rhs->time; });
+  if (records.empty()) {
+    return;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto first_record_time = records.front()->time;
+  for (const auto* record : records) {
+    if (speed_ == ReplaySpeed::recorded) {
+      std::this_thread::sleep_until(start + (record->time - first_record_time));
+    }
+    switch (record->type) {
+      case RecordType::intrinsics:
+        intrinsics_ = ToIntrinsics(record->As<IntrinsicsRecord>());
+        break;
+      case RecordType::frame:
+        ReplayFrame(*record, stats);
+        break;
+      case RecordType::click:
+        ReplayClick(*record, stats);
+        break;
+      case RecordType::http:
+        ReplayHTTP(*record, stats);
+        break;
+      case RecordType::pose:
+        break;
+    }
+  }
+  stats.recorded_duration = records.back()->time - first_record_time;
+  stats.replay_duration = std::chrono::steady_clock::now() - start;
+}
+
+void SessionReplay::ReplayFrame(const Record& record, ReplayStats& stats) {
+  const auto& frame_record = record.As<FrameRecord>();
+  auto frame = std::make_shared<Frame>();
+  if (frame_record.encoding == ImageEncoding::jpeg) {
+    const cv::Mat encoded(1, static_cast<int>(frame_record.image_size), CV_8UC1,
+                          const_cast<unsigned char*>(record.Tail<FrameRecord>()));
+    frame->image = cv::imdecode(encoded, cv::IMREAD_COLOR);
+  } else {
+    // consumers must not write into frames, so all of them can share a single blank image
+    const cv::Size size{frame_record.width, frame_record.height};
+    if (blank_frame_.size() != size) {
+      blank_frame_ = cv::Mat::zeros(size, CV_8UC3);
+    }
+    frame->image = blank_frame_;
+  }
+  frame->sequence = frame_record.sequence;
+  frame->capture_time = std::chrono::steady_clock::now();
+  frame->position = PTZCameraPosition{frame_record.horizontal_angle, frame_record.vertical_angle};
+  frame->zoom_multiple = frame_record.zoom_multiple;
+  frame->camera_moving = frame_record.camera_moving;
+  bus_.Publish(std::move(frame));
+  stats.frames++;
+}
+
+void SessionReplay::ReplayClick(const Record& record, ReplayStats& stats) {
+  stats.clicks++;
+  const auto& click = record.As<ClickRecord>();
+  CameraIntrinsics intrinsics = intrinsics_;
+  intrinsics.K = cv::Matx33d{click.fx, 0., click.cx, 0., click.fy, click.cy, 0., 0., 1.};
+  const Eigen::Vector3f current{click.current_vertical_angle, click.current_horizontal_angle, 0};
+  PTZTarget target;
+  {
+    metrics::ScopedTimer timer(stats.calculation_duration);
+    if (click.width == 0 and click.height == 0) {
+      target.euler_angles_in_degrees = CalculateAbsolutePosition(
+          cv::Point{click.x, click.y}, intrinsics.ForZoom(click.current_zoom_multiple).K, current);
+      target.zoom_multiple = click.target_zoom_multiple;
+    } else {
+      target = CalculateAbsolutePositionForRegion(cv::Rect{click.x, click.y, click.width, click.height}, intrinsics,
+                                                  cv::Size{click.frame_width, click.frame_height}, current,
+                                                  click.current_zoom_multiple, click.max_zoom_multiple);
+    }
+  }
+  if (std::abs(target.euler_angles_in_degrees[1] - click.target_horizontal_angle) > angle_tolerance or
+      std::abs(target.euler_angles_in_degrees[0] - click.target_vertical_angle) > angle_tolerance or
+      target.zoom_multiple != click.target_zoom_multiple) {
+    stats.click_mismatches++;
+    LOG(WARNING) << "Click at " << click.x << "x" << click.y << " now targets (" << target.euler_angles_in_degrees[1]
+                 << ", " << target.euler_angles_in_degrees[0] << ", x" << target.zoom_multiple << "), recorded ("
+                 << click.target_horizontal_angle << ", " << click.target_vertical_angle << ", x"
+                 << click.target_zoom_multiple << ")";
+  }
+}
+
+void SessionReplay::ReplayHTTP(const Record& record, ReplayStats& stats) {
+  const auto& http = record.As<HTTPRecord>();
+  const std::string code(reinterpret_cast<const char*>(record.Tail<HTTPRecord>()), http.code_size);
+  stats.http_duration[code].Record(std::chrono::nanoseconds{http.duration_ns});
+  stats.http_requests++;
+  if (http.error_category != ErrorCategory::none) {
+    stats.http_failures++;
+  }
+}
+
+} // namespace tpxai::session
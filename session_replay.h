@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "frame_bus.h"
+#include "metrics.h"
+#include "session_log.h"
+
+namespace tpxai::session {
+
+enum class ReplaySpeed {
+  recorded, // records are replayed with their recorded spacing
+  fastest   // without waiting, to measure throughput
+};
+
+struct ReplayStats {
+  std::uint64_t frames = 0;
+  std::uint64_t clicks = 0;
+  std::uint64_t click_mismatches = 0; // recalculated targets which differ from the recorded ones
+  std::uint64_t http_requests = 0;
+  std::uint64_t http_failures = 0;
+  std::chrono::nanoseconds recorded_duration{0};
+  std::chrono::nanoseconds replay_duration{0};
+  metrics::Histogram calculation_duration;
+  std::map<std::string, metrics::Histogram> http_duration; // recorded, per CGI code
+};
+
+// Feeds a recorded session back through the frame consumers and the position calculator without a camera. Frames
+// are published on the bus, decoded from the log when it holds their images and blank frames of the recorded size
+// otherwise, stamped with the recorded camera state. Clicks are recalculated from their recorded starting pose and
+// compared with the recorded targets. HTTP requests are not sent again, their recorded durations are summarized.
+class SessionReplay {
+public:
+  SessionReplay(const SessionLog& log, FrameBus& bus, ReplaySpeed speed);
+
+  // Replays the whole log on the calling thread, does not close the bus.
+  void Run(ReplayStats& stats);
+
+  static constexpr float angle_tolerance = 1e-3F; // degrees
+
+private:
+  void ReplayFrame(const Record& record, ReplayStats& stats);
+  void ReplayClick(const Record& record, ReplayStats& stats);
+  void ReplayHTTP(const Record& record, ReplayStats& stats);
+
+  const SessionLog& log_;
+  FrameBus& bus_;
+  const ReplaySpeed speed_;
+  CameraIntrinsics intrinsics_; // the distortion of the last intrinsics record, the clicks hold their own pinhole
+  cv::Mat blank_frame_;
+};
+
+} // namespace tpxai::session
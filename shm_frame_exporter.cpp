@@ -0,0 +1,108 @@
+#include "shm_frame_exporter.h"
+
+#include <cstring>
+#include <new>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+namespace tpxai {
+
+ShmFrameExporter::ShmFrameExporter(std::string name, std::size_t slot_count, std::size_t max_image_bytes)
+    : name_{std::move(name)}, segment_size_{shm::SegmentSize(slot_count, max_image_bytes)} {
+  CHECK(slot_count > 0);
+  // a segment left behind by a crashed exporter is replaced, readers still mapping it keep their stale copy; the new
+  // segment is created exclusively, so its header is never initialized while another exporter writes to it
+  shm_unlink(name_.c_str());
+  const int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name_);
+  }
+  if (ftruncate(fd, static_cast<off_t>(segment_size_)) != 0) {
+    const auto error = errno;
+    close(fd);
+    shm_unlink(name_.c_str());
+    throw std::system_error(error, std::generic_category(), "ftruncate " + name_);
+  }
+  segment_ = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment_ == MAP_FAILED) {
+    const auto error = errno;
+    shm_unlink(name_.c_str());
+    throw std::system_error(error, std::generic_category(), "mmap " + name_);
+  }
+
+  // readers check the magic first, so publish it only when the rest of the header is in place
+  header_ = new (segment_) shm::RingHeader{};
+  header_->version = shm::ring_version;
+  header_->slot_count = static_cast<std::uint32_t>(slot_count);
+  header_->slot_size = shm::SlotSize(max_image_bytes);
+  header_->max_image_bytes = max_image_bytes;
+  header_->write_count.store(0, std::memory_order_relaxed);
+  for (std::size_t i = 0; i < slot_count; i++) {
+    new (GetSlot(i)) shm::SlotHeader{};
+  }
+  header_->magic.store(shm::ring_magic, std::memory_order_release);
+
+  LOG(INFO) << "Exporting frames to shared memory " << name_ << ": " << slot_count << " slots, " << segment_size_
+            << " bytes";
+}
+
+ShmFrameExporter::~ShmFrameExporter() {
+  munmap(segment_, segment_size_);
+  shm_unlink(name_.c_str());
+}
+
+shm::SlotHeader* ShmFrameExporter::GetSlot(std::size_t index) const {
+  return reinterpret_cast<shm::SlotHeader*>(static_cast<char*>(segment_) + shm::RingHeaderSize() +
+                                            index * header_->slot_size);
+}
+
+void ShmFrameExporter::Export(const Frame& frame) {
+  const auto& image = frame.image;
+  const std::size_t row_bytes = image.cols * image.elemSize();
+  const std::size_t image_bytes = row_bytes * image.rows;
+  if (image_bytes > header_->max_image_bytes) {
+    LOG_EVERY_N(WARNING, 100) << "Frame of " << image_bytes << " bytes does not fit the shared memory slot";
+    skipped_frames_++;
+    return;
+  }
+
+  const auto write_count = header_->write_count.load(std::memory_order_relaxed);
+  auto slot = GetSlot(write_count % header_->slot_count);
+
+  const auto generation = slot->generation.load(std::memory_order_relaxed);
+  slot->generation.store(generation + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot->frame_sequence = frame.sequence;
+  slot->capture_time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(frame.capture_time.time_since_epoch()).count();
+  slot->horizontal_angle = frame.position.horizontal_angle;
+  slot->vertical_angle = frame.position.vertical_angle;
+  slot->zoom_multiple = frame.zoom_multiple;
+  slot->camera_moving = frame.camera_moving;
+  slot->width = image.cols;
+  slot->height = image.rows;
+  slot->type = image.type();
+  slot->step = row_bytes;
+  slot->image_bytes = image_bytes;
+
+  auto pixels = reinterpret_cast<unsigned char*>(slot + 1);
+  if (image.isContinuous()) {
+    std::memcpy(pixels, image.data, image_bytes);
+  } else {
+    for (int row = 0; row < image.rows; row++) {
+      std::memcpy(pixels + row * row_bytes, image.ptr(row), row_bytes);
+    }
+  }
+
+  slot->generation.store(generation + 2, std::memory_order_release);
+  header_->write_count.store(write_count + 1, std::memory_order_release);
+}
+
+} // namespace tpxai
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "frame.h"
+#include "shm_frame_ring.h"
+
+namespace tpxai {
+
+// Publishes frames into a POSIX shared-memory ring (see shm_frame_ring.h) for consumers running in other processes.
+// The segment is created on construction and unlinked on destruction.
+class ShmFrameExporter {
+public:
+  ShmFrameExporter(std::string name, std::size_t slot_count, std::size_t max_image_bytes);
+  ~ShmFrameExporter();
+
+  ShmFrameExporter(const ShmFrameExporter&) = delete;
+  ShmFrameExporter& operator=(const ShmFrameExporter&) = delete;
+
+  // Frames bigger than the slot are skipped and counted.
+  void Export(const Frame& frame);
+
+  std::uint64_t GetSkippedFrames() const { return skipped_frames_; }
+  std::size_t GetMaxImageBytes() const { return header_->max_image_bytes; }
+
+private:
+  shm::SlotHeader* GetSlot(std::size_t index) const;
+
+  std::string name_;
+  std::size_t segment_size_ = 0;
+  void* segment_ = nullptr;
+  shm::RingHeader* header_ = nullptr;
+  std::uint64_t skipped_frames_ = 0;
+};
+
+} // namespace tpxai
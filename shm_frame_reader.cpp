@@ -0,0 +1,102 @@
+#include "shm_frame_reader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tpxai {
+
+namespace {
+
+// The header comes from another process, every size in it is checked against the mapped segment before it is used,
+// without letting a corrupted value overflow the arithmetic.
+bool IsValidRing(const shm::RingHeader& header, std::size_t segment_size) {
+  if (segment_size < shm::RingHeaderSize() or header.magic.load(std::memory_order_acquire) != shm::ring_magic or
+      header.version != shm::ring_version) {
+    return false;
+  }
+  const auto slots_size = segment_size - shm::RingHeaderSize();
+  return header.slot_count > 0 and header.max_image_bytes <= slots_size and
+         header.slot_size >= shm::SlotSize(header.max_image_bytes) and header.slot_size <= slots_size and
+         header.slot_count <= slots_size / header.slot_size;
+}
+
+} // anonymous namespace
+
+ShmFrameReader::ShmFrameReader(std::string name) : name_{std::move(name)} {
+  const int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "shm_open " + name_);
+  }
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    const auto error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "fstat " + name_);
+  }
+  segment_size_ = static_cast<std::size_t>(st.st_size);
+  segment_ = mmap(nullptr, segment_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment_ == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "mmap " + name_);
+  }
+
+  header_ = static_cast<const shm::RingHeader*>(segment_);
+  if (not IsValidRing(*header_, segment_size_)) {
+    munmap(const_cast<void*>(segment_), segment_size_);
+    throw std::runtime_error("not a frame ring: " + name_);
+  }
+}
+
+ShmFrameReader::~ShmFrameReader() { munmap(const_cast<void*>(segment_), segment_size_); }
+
+const shm::SlotHeader* ShmFrameReader::GetSlot(std::size_t index) const {
+  return reinterpret_cast<const shm::SlotHeader*>(static_cast<const char*>(segment_) + shm::RingHeaderSize() +
+                                                  index * header_->slot_size);
+}
+
+ShmFrameReader::Status ShmFrameReader::ReadLatest(ShmFrame& frame, int max_attempts) {
+  for (int attempt = 0; attempt < max_attempts; attempt++) {
+    const auto write_count = header_->write_count.load(std::memory_order_acquire);
+    if (write_count == last_write_count_) {
+      return Status::no_new_frame;
+    }
+    const auto slot = GetSlot((write_count - 1) % header_->slot_count);
+
+    const auto generation = slot->generation.load(std::memory_order_acquire);
+    if (generation % 2 == 0) {
+      frame.sequence = slot->frame_sequence;
+      frame.capture_time_ns = slot->capture_time_ns;
+      frame.horizontal_angle = slot->horizontal_angle;
+      frame.vertical_angle = slot->vertical_angle;
+      frame.zoom_multiple = slot->zoom_multiple;
+      frame.camera_moving = slot->camera_moving != 0;
+      frame.width = slot->width;
+      frame.height = slot->height;
+      frame.type = slot->type;
+      frame.step = slot->step;
+      const auto image_bytes = std::min<std::uint64_t>(slot->image_bytes, header_->max_image_bytes);
+      frame.pixels.resize(image_bytes);
+      std::memcpy(frame.pixels.data(), slot + 1, image_bytes);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->generation.load(std::memory_order_relaxed) == generation) {
+        if (last_write_count_ != 0 and write_count > last_write_count_ + 1) {
+          missed_frames_ += write_count - last_write_count_ - 1;
+        }
+        last_write_count_ = write_count;
+        return Status::ok;
+      }
+    }
+    torn_reads_++;
+  }
+  return Status::torn;
+}
+
+} // namespace tpxai
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shm_frame_ring.h"
+
+namespace tpxai {
+
+// Frame copied out of the shared-memory ring. The pixel buffer is reused between reads.
+struct ShmFrame {
+  std::uint64_t sequence = 0;
+  std::int64_t capture_time_ns = 0;
+  float horizontal_angle = 0;
+  float vertical_angle = 0;
+  std::uint16_t zoom_multiple = 0;
+  bool camera_moving = false;
+  int width = 0;
+  int height = 0;
+  int type = 0;
+  std::size_t step = 0;
+  std::vector<std::uint8_t> pixels;
+};
+
+// Lock-free reader of the ring written by ShmFrameExporter. Readers never block the writer: a read racing with the
+// writer is detected by the slot generation and retried on the newest slot.
+class ShmFrameReader {
+public:
+  explicit ShmFrameReader(std::string name);
+  ~ShmFrameReader();
+
+  ShmFrameReader(const ShmFrameReader&) = delete;
+  ShmFrameReader& operator=(const ShmFrameReader&) = delete;
+
+  enum class Status { ok, no_new_frame, torn };
+
+  // Copies the newest frame if it is newer than the previously read one.
+  Status ReadLatest(ShmFrame& frame, int max_attempts = 3);
+
+  std::uint64_t GetTornReads() const { return torn_reads_; }
+  // Frames written but never returned because the reader was slower than the writer.
+  std::uint64_t GetMissedFrames() const { return missed_frames_; }
+
+private:
+  const shm::SlotHeader* GetSlot(std::size_t index) const;
+
+  std::string name_;
+  std::size_t segment_size_ = 0;
+  const void* segment_ = nullptr;
+  const shm::RingHeader* header_ = nullptr;
+  std::uint64_t last_write_count_ = 0;
+  std::uint64_t torn_reads_ = 0;
+  std::uint64_t missed_frames_ = 0;
+};
+
+} // namespace tpxai
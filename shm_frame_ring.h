@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of the shared-memory frame ring written by ShmFrameExporter and read by ShmFrameReader. It is a plain
+// header shared with out-of-process consumers, so it depends on nothing but the standard library.
+//
+// The segment starts with a RingHeader followed by slot_count slots of slot_size bytes. Each slot is a SlotHeader
+// followed by the pixels. The writer never waits for readers: it bumps the slot generation to an odd value before
+// touching the slot and to the next even value when done, so a reader which sees the same even generation before and
+// after copying has a consistent frame, otherwise the copy was torn and is discarded.
+
+namespace tpxai::shm {
+
+constexpr std::uint32_t ring_magic = 0x52465054; // "TPFR"
+constexpr std::uint32_t ring_version = 1;
+
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "the ring requires address-free 32-bit atomics");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the ring requires address-free 64-bit atomics");
+
+struct RingHeader {
+  std::atomic<std::uint32_t> magic; // stored last with release semantics, readers load it with acquire semantics
+  std::uint32_t version;
+  std::uint32_t slot_count;
+  std::uint32_t reserved;
+  std::uint64_t slot_size;
+  std::uint64_t max_image_bytes;
+  alignas(64) std::atomic<std::uint64_t> write_count; // frames written so far, the newest is in (write_count-1) % slots
+};
+
+struct alignas(64) SlotHeader {
+  std::atomic<std::uint64_t> generation;
+  std::uint64_t frame_sequence;
+  std::int64_t capture_time_ns; // CLOCK_MONOTONIC, comparable between processes
+  float horizontal_angle;
+  float vertical_angle;
+  std::uint16_t zoom_multiple;
+  std::uint8_t camera_moving;
+  std::uint8_t reserved;
+  std::int32_t width;
+  std::int32_t height;
+  std::int32_t type;  // OpenCV matrix type, e.g. CV_8UC3
+  std::uint64_t step; // bytes per row, rows are stored without padding
+  std::uint64_t image_bytes;
+};
+
+constexpr std::size_t ring_alignment = 64;
+
+constexpr std::size_t RingHeaderSize() {
+  return (sizeof(RingHeader) + ring_alignment - 1) / ring_alignment * ring_alignment;
+}
+
+constexpr std::size_t SlotSize(std::size_t max_image_bytes) {
+  return (sizeof(SlotHeader) + max_image_bytes + ring_alignment - 1) / ring_alignment * ring_alignment;
+}
+
+constexpr std::size_t SegmentSize(std::size_t slot_count, std::size_t max_image_bytes) {
+  return RingHeaderSize() + slot_count * SlotSize(max_image_bytes);
+}
+
+} // namespace tpxai::shm
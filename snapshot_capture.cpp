@@ -0,0 +1,150 @@
+#include "snapshot_capture.h"
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "trace.h"
+
+namespace tpxai {
+
+SnapshotScheduler::SnapshotScheduler(std::size_t max_concurrent_tasks)
+    : delay_{metrics::GetRegistry().GetHistogram("goto_point_snapshot_delay_seconds",
+                                                 "Time snapshots waited past their due time for a free worker")} {
+  const auto worker_count = std::max<std::size_t>(max_concurrent_tasks, 1);
+  workers_.reserve(worker_count);
+  for (std::size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back(&SnapshotScheduler::Run, this);
+  }
+}
+
+SnapshotScheduler::~SnapshotScheduler() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wakeup_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+SnapshotScheduler::TaskId SnapshotScheduler::Add(std::chrono::milliseconds interval, Task task) {
+  std::lock_guard lock(mutex_);
+  const auto id = next_id_++;
+  const auto due = Clock::now();
+  tasks_.emplace(id, ScheduledTask{interval, std::move(task), due});
+  queue_.emplace(due, id);
+  wakeup_.notify_one();
+  return id;
+}
+
+void SnapshotScheduler::Remove(TaskId id) {
+  std::unique_lock lock(mutex_);
+  const auto task = tasks_.find(id);
+  if (task == tasks_.end()) {
+    return;
+  }
+  if (task->second.running) {
+    // the worker drops the task once the run is over
+    task->second.removed = true;
+    finished_.wait(lock, [this, id] { return tasks_.count(id) == 0; });
+  } else {
+    queue_.erase({task->second.due, id});
+    tasks_.erase(task);
+  }
+}
+
+void SnapshotScheduler::Run() {
+  trace::SetThreadName("snapshot worker");
+  std::unique_lock lock(mutex_);
+  while (true) {
+    if (stopping_) {
+      return;
+    }
+    if (queue_.empty()) {
+      wakeup_.wait(lock);
+      continue;
+    }
+    const auto [due, id] = *queue_.begin();
+    if (Clock::now() < due) {
+      // a task added or rescheduled meanwhile may be due earlier, so the queue is looked at again after waking up
+      wakeup_.wait_until(lock, due);
+      continue;
+    }
+    queue_.erase(queue_.begin());
+    auto& scheduled = tasks_.at(id);
+    scheduled.running = true;
+    const auto start = Clock::now();
+    delay_.Record(start - due);
+
+    lock.unlock();
+    try {
+      scheduled.task();
+    } catch (std::exception& e) {
+      LOG(ERROR) << "Snapshot task failed: " << e.what();
+    }
+    lock.lock();
+
+    // std::map nodes are stable, so the reference survived the unlocked run
+    scheduled.running = false;
+    if (scheduled.removed) {
+      tasks_.erase(id);
+      finished_.notify_all();
+    } else {
+      scheduled.due = std::max(due + scheduled.interval, Clock::now());
+      queue_.emplace(scheduled.due, id);
+      // another worker may be waiting for a later task
+      wakeup_.notify_one();
+    }
+  }
+}
+
+SnapshotCapture::SnapshotCapture(dahua::DahuaPTZCamera& camera, FrameBus& bus, SnapshotScheduler& scheduler,
+                                 SnapshotSettings settings)
+    : camera_{camera}, bus_{bus}, scheduler_{scheduler}, settings_{settings},
+      snapshot_duration_{metrics::GetRegistry().GetHistogram("goto_point_snapshot_duration_seconds",
+                                                             "Time to fetch and decode a JPEG snapshot")},
+      captured_frames_{metrics::GetRegistry().GetCounter("goto_point_captured_frames_total", "Decoded frames")},
+      failed_snapshots_{metrics::GetRegistry().GetCounter("goto_point_failed_snapshots_total",
+                                                          "Snapshots which could not be fetched or decoded")},
+      task_{scheduler_.Add(settings_.interval, [this] { Capture(); })} {}
+
+SnapshotCapture::~SnapshotCapture() {
+  scheduler_.Remove(task_);
+  bus_.Close();
+}
+
+void SnapshotCapture::Capture() {
+  const auto cpu_time = GetThreadCPUTime();
+  auto frame = std::make_shared<Frame>();
+  try {
+    metrics::ScopedTimer timer(snapshot_duration_);
+    frame->image = camera_.GetSnapshot(settings_.min_width);
+  } catch (std::exception& e) {
+    failed_snapshots_.Add();
+    LOG(WARNING) << "Snapshot failed: " << e.what();
+    return;
+  }
+  captured_frames_.Add();
+  frame->sequence = sequence_++;
+  frame->capture_time = std::chrono::steady_clock::now();
+  frame->position = camera_.GetCurrentPosition();
+  frame->zoom_multiple = camera_.GetCurrentZoom();
+  frame->camera_moving = camera_.IsMoving(frame->capture_time);
+  const auto pixels = frame->image.total();
+  {
+    trace::Span span("capture", "Publish");
+    bus_.Publish(std::move(frame));
+  }
+  cpu_time_ns_.fetch_add((GetThreadCPUTime() - cpu_time).count(), std::memory_order_relaxed);
+  pixels_.fetch_add(pixels, std::memory_order_relaxed);
+  frames_.fetch_add(1, std::memory_order_relaxed);
+}
+
+StreamLoad SnapshotCapture::GetLoad() const {
+  return {frames_.load(std::memory_order_relaxed), pixels_.load(std::memory_order_relaxed),
+          std::chrono::nanoseconds{cpu_time_ns_.load(std::memory_order_relaxed)}};
+}
+
+} // namespace tpxai
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "camera_capture.h"
+#include "dahua_ptz_camera.h"
+#include "frame_bus.h"
+#include "metrics.h"
+
+namespace tpxai {
+
+// Runs periodic tasks, the snapshot requests of many cameras, on a fixed number of worker threads, so that no more
+// than that many requests are in flight at once however many cameras are added. A task runs as soon as a worker is
+// free and then every interval, measured from when its previous run was due. A task which runs late, or for longer
+// than its interval, is not followed by catch-up runs, and a task never runs on two workers at once.
+class SnapshotScheduler {
+public:
+  using Task = std::function<void()>;
+  using TaskId = std::uint64_t;
+
+  explicit SnapshotScheduler(std::size_t max_concurrent_tasks = 4);
+  // waits for the runs in flight
+  ~SnapshotScheduler();
+
+  SnapshotScheduler(const SnapshotScheduler&) = delete;
+  SnapshotScheduler& operator=(const SnapshotScheduler&) = delete;
+
+  TaskId Add(std::chrono::milliseconds interval, Task task);
+  // Waits for a run of the task in flight, afterwards the task is not run again. Must not be called from the task.
+  void Remove(TaskId id);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct ScheduledTask {
+    std::chrono::milliseconds interval;
+    Task task;
+    Clock::time_point due;
+    bool running = false;
+    bool removed = false;
+  };
+
+  void Run();
+
+  metrics::Histogram& delay_;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;   // of the workers
+  std::condition_variable finished_; // of the callers of Remove
+  bool stopping_ = false;
+  TaskId next_id_ = 0;
+  std::map<TaskId, ScheduledTask> tasks_;
+  std::set<std::pair<Clock::time_point, TaskId>> queue_; // of the tasks which are not running, earliest due first
+  std::vector<std::thread> workers_;
+};
+
+struct SnapshotSettings {
+  std::chrono::milliseconds interval{5000};
+  int min_width = 0; // snapshots are decoded at the smallest JPEG scale at least this wide, 0 for full resolution
+};
+
+// Acquires frames as JPEG snapshots instead of from the RTSP stream, for cameras which only need a frame now and
+// then: between two snapshots the camera costs neither a decoder thread nor stream bandwidth. Frames are stamped and
+// published to the frame bus like those of CameraCapture, so the same consumers work with both. A failed snapshot is
+// logged and skipped, the bus is only closed when the capture is destroyed. The camera should be created with
+// StreamOpening::none, and it and the scheduler must outlive the capture.
+class SnapshotCapture {
+public:
+  SnapshotCapture(dahua::DahuaPTZCamera& camera, FrameBus& bus, SnapshotScheduler& scheduler,
+                  SnapshotSettings settings = {});
+  ~SnapshotCapture();
+
+  SnapshotCapture(const SnapshotCapture&) = delete;
+  SnapshotCapture& operator=(const SnapshotCapture&) = delete;
+
+  StreamLoad GetLoad() const;
+
+private:
+  void Capture();
+
+  dahua::DahuaPTZCamera& camera_;
+  FrameBus& bus_;
+  SnapshotScheduler& scheduler_;
+  const SnapshotSettings settings_;
+  metrics::Histogram& snapshot_duration_;
+  metrics::Counter& captured_frames_;
+  metrics::Counter& failed_snapshots_;
+  std::uint64_t sequence_ = 0; // the scheduler never runs Capture concurrently
+  std::atomic<std::uint64_t> frames_{0};
+  std::atomic<std::uint64_t> pixels_{0};
+  std::atomic<std::int64_t> cpu_time_ns_{0};
+  SnapshotScheduler::TaskId task_; // last, so the task is added once the rest is initialized
+};
+
+} // namespace tpxai
@@ -0,0 +1,199 @@
+#include "stream_tuner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <utility>
+
+#include <time.h>
+
+#include <glog/logging.h>
+
+#include "trace.h"
+
+namespace tpxai {
+
+namespace {
+
+std::chrono::nanoseconds GetProcessCPUTime() {
+  timespec time{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+  return std::chrono::seconds{time.tv_sec} + std::chrono::nanoseconds{time.tv_nsec};
+}
+
+StreamLoad Difference(const StreamLoad& end, const StreamLoad& start) {
+  return {end.frames - start.frames, end.pixels - start.pixels, end.cpu_time - start.cpu_time};
+}
+
+double GetPixelRate(const dahua::StreamConfig& config) {
+  return static_cast<double>(config.resolution.area()) * config.frame_rate;
+}
+
+std::ostream& operator<<(std::ostream& os, const dahua::StreamConfig& config) {
+  return os << config.resolution.width << "x" << config.resolution.height << "@" << config.frame_rate << " GOP "
+            << config.gop;
+}
+
+} // anonymous namespace
+
+double EstimateCPUCostPerMegapixel(const StreamLoad& camera, const StreamLoad& all_cameras,
+                                   std::chrono::nanoseconds process_cpu_time) {
+  if (camera.pixels == 0 or all_cameras.pixels == 0) {
+    return 0;
+  }
+  const auto rest_of_process = std::max(process_cpu_time - all_cameras.cpu_time, std::chrono::nanoseconds{0});
+  const double pixel_share = static_cast<double>(camera.pixels) / all_cameras.pixels;
+  const double cpu_seconds = std::chrono::duration<double>(camera.cpu_time).count() +
+                             std::chrono::duration<double>(rest_of_process).count() * pixel_share;
+  return cpu_seconds / (static_cast<double>(camera.pixels) / 1e6);
+}
+
+dahua::StreamConfig ChooseStreamConfig(double cpu_cost_per_megapixel, double cpu_budget,
+                                       const StreamTunerSettings& settings) {
+  CHECK(not settings.resolutions.empty());
+  const auto make_config = [&settings](const cv::Size& resolution, std::uint16_t frame_rate) {
+    const auto gop = std::max<std::int64_t>(1, frame_rate * settings.key_frame_interval.count());
+    return dahua::StreamConfig{resolution, frame_rate, static_cast<std::uint16_t>(gop)};
+  };
+  for (const auto& resolution : settings.resolutions) {
+    const double cost_per_frame = cpu_cost_per_megapixel * resolution.area() / 1e6;
+    const double affordable_frame_rate =
+        cost_per_frame > 0 ? cpu_budget / cost_per_frame : static_cast<double>(settings.max_frame_rate);
+    if (affordable_frame_rate >= settings.min_frame_rate) {
+      const auto frame_rate = std::min(std::floor(affordable_frame_rate), static_cast<double>(settings.max_frame_rate));
+      return make_config(resolution, static_cast<std::uint16_t>(frame_rate));
+    }
+  }
+  return make_config(settings.resolutions.back(), settings.min_frame_rate);
+}
+
+StreamBudget::StreamBudget(StreamTunerSettings settings, unsigned cores)
+    : settings_{std::move(settings)}, cores_{std::max(1U, cores)} {}
+
+StreamBudget::StreamId StreamBudget::Add(Stream stream) {
+  streams_.push_back({next_id_, std::move(stream), {}, std::nullopt, {}});
+  return next_id_++;
+}
+
+void StreamBudget::Remove(StreamId id) {
+  streams_.erase(std::remove_if(streams_.begin(), streams_.end(),
+                                [id](const TunedStream& tuned) { return tuned.id == id; }),
+                 streams_.end());
+}
+
+void StreamBudget::StartWindow(std::chrono::nanoseconds process_cpu_time) {
+  window_start_cpu_time_ = process_cpu_time;
+  for (auto& tuned : streams_) {
+    tuned.window_start = tuned.stream.get_load();
+  }
+}
+
+void StreamBudget::Tune(std::chrono::nanoseconds process_cpu_time, std::chrono::steady_clock::time_point now) {
+  const auto window_cpu_time = process_cpu_time - window_start_cpu_time_;
+  std::vector<StreamLoad> loads;
+  StreamLoad all_streams;
+  std::size_t active_streams = 0;
+  for (const auto& tuned : streams_) {
+    const auto& load = loads.emplace_back(Difference(tuned.stream.get_load(), tuned.window_start));
+    all_streams.frames += load.frames;
+    all_streams.pixels += load.pixels;
+    all_streams.cpu_time += load.cpu_time;
+    if (load.frames) {
+      active_streams++;
+    }
+  }
+  // streams which are not open yet take no share of the budget
+  if (active_streams == 0) {
+    return;
+  }
+  const double cpu_budget = settings_.cpu_budget * cores_ / active_streams;
+  for (std::size_t i = 0; i < streams_.size(); i++) {
+    if (loads[i].frames and now >= streams_[i].measure_after) {
+      Tune(streams_[i], loads[i], all_streams, window_cpu_time, cpu_budget, now);
+    }
+  }
+}
+
+void StreamBudget::Tune(TunedStream& tuned, const StreamLoad& load, const StreamLoad& all_streams,
+                        std::chrono::nanoseconds process_cpu_time, double cpu_budget,
+                        std::chrono::steady_clock::time_point now) {
+  try {
+    if (not tuned.config) {
+      tuned.config = tuned.stream.get_config();
+    }
+    const auto& current = *tuned.config;
+    const double cost = EstimateCPUCostPerMegapixel(load, all_streams, process_cpu_time);
+    const auto chosen = ChooseStreamConfig(cost, cpu_budget, settings_);
+    if (chosen.resolution == current.resolution and chosen.frame_rate == current.frame_rate and
+        chosen.gop == current.gop) {
+      return;
+    }
+    const double current_pixel_rate = GetPixelRate(current);
+    const bool over_budget = cost * current_pixel_rate / 1e6 > cpu_budget;
+    const double change =
+        current_pixel_rate > 0 ? std::abs(GetPixelRate(chosen) - current_pixel_rate) / current_pixel_rate : 1;
+    if (not over_budget and change < settings_.hysteresis) {
+      return;
+    }
+    LOG(INFO) << "Stream " << current << " costs " << cost << " CPU s/MP, budget " << cpu_budget
+              << " cores, reconfiguring to " << chosen;
+    // measured again only once the new stream runs, also when the change failed so as not to retry every interval
+    tuned.measure_after = now + settings_.settle_time;
+    tuned.stream.set_config(chosen);
+    tuned.config = chosen;
+  } catch (std::exception& e) {
+    LOG(WARNING) << "Stream tuning failed: " << e.what();
+  }
+}
+
+StreamTuner::StreamTuner(StreamTunerSettings settings)
+    : settings_{settings}, budget_{std::move(settings), std::thread::hardware_concurrency()},
+      thread_{&StreamTuner::Run, this} {}
+
+StreamTuner::~StreamTuner() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wakeup_.notify_all();
+  thread_.join();
+}
+
+void StreamTuner::AddCamera(dahua::DahuaPTZCamera& camera, const CameraCapture& capture) {
+  {
+    std::lock_guard lock(mutex_);
+    cameras_[&camera] = budget_.Add({[&capture] { return capture.GetLoad(); },
+                                     [&camera] { return camera.GetStreamConfig(); },
+                                     [&camera](const dahua::StreamConfig& config) { camera.SetStreamConfig(config); }});
+    cameras_changed_ = true;
+  }
+  wakeup_.notify_all();
+}
+
+void StreamTuner::RemoveCamera(const dahua::DahuaPTZCamera& camera) {
+  {
+    std::lock_guard lock(mutex_);
+    if (const auto it = cameras_.find(&camera); it != cameras_.end()) {
+      budget_.Remove(it->second);
+      cameras_.erase(it);
+    }
+    cameras_changed_ = true;
+  }
+  wakeup_.notify_all();
+}
+
+void StreamTuner::Run() {
+  trace::SetThreadName("stream tuner");
+  std::unique_lock lock(mutex_);
+  budget_.StartWindow(GetProcessCPUTime());
+  while (not stopping_) {
+    // the cameras are reconfigured with the lock held, so a removed camera is never touched afterwards
+    if (not wakeup_.wait_for(lock, settings_.interval, [this] { return stopping_ or cameras_changed_; })) {
+      budget_.Tune(GetProcessCPUTime(), std::chrono::steady_clock::now());
+    }
+    cameras_changed_ = false;
+    budget_.StartWindow(GetProcessCPUTime());
+  }
+}
+
+} // namespace tpxai
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+#include "camera_capture.h"
+#include "dahua_ptz_camera.h"
+
+namespace tpxai {
+
+struct StreamTunerSettings {
+  double cpu_budget = 0.5; // share of all cores the streams and their processing may use together
+  std::chrono::seconds interval{10};
+  std::chrono::seconds settle_time{30}; // after a reconfiguration, before the camera's load is measured again
+  double hysteresis = 0.2;              // relative pixel rate change needed to reconfigure a camera within budget
+  std::vector<cv::Size> resolutions = {{2592, 1520}, {1920, 1080}, {1280, 720}}; // largest first
+  std::uint16_t max_frame_rate = 25;
+  std::uint16_t min_frame_rate = 8; // below that a smaller resolution is chosen
+  std::chrono::seconds key_frame_interval{2};
+};
+
+// CPU seconds the process spends per decoded megapixel of one camera in a measurement window: the time of its own
+// capture thread plus a share of everything else the process did (decoder worker threads, frame consumers, the UI),
+// proportional to the camera's share of all decoded pixels.
+double EstimateCPUCostPerMegapixel(const StreamLoad& camera, const StreamLoad& all_cameras,
+                                   std::chrono::nanoseconds process_cpu_time);
+
+// The largest resolution which fits the budget (in cores) at min_frame_rate or more, at the highest frame rate the
+// budget allows. The smallest resolution at min_frame_rate when none fits.
+dahua::StreamConfig ChooseStreamConfig(double cpu_cost_per_megapixel, double cpu_budget,
+                                       const StreamTunerSettings& settings);
+
+// The decisions of StreamTuner over one measurement window at a time, without its thread and clocks. The budget is
+// split evenly between the streams which decoded frames in the window, and a stream which no longer fits its share,
+// or could use notably more of it, is reconfigured. A reconfigured stream is left alone for the settle time. Not
+// thread safe.
+class StreamBudget {
+public:
+  // A camera stream as seen by the tuner. The load is the total since the stream started, the configuration is read
+  // once, when the stream is first tuned. Failures are reported by exceptions.
+  struct Stream {
+    std::function<StreamLoad()> get_load;
+    std::function<dahua::StreamConfig()> get_config;
+    std::function<void(const dahua::StreamConfig&)> set_config;
+  };
+  using StreamId = std::uint64_t;
+
+  StreamBudget(StreamTunerSettings settings, unsigned cores);
+
+  // A stream joins the budget split at the next window.
+  StreamId Add(Stream stream);
+  void Remove(StreamId id);
+
+  // The process CPU time is the total since the process started.
+  void StartWindow(std::chrono::nanoseconds process_cpu_time);
+  // Ends the window started last and tunes the streams to their share of the budget.
+  void Tune(std::chrono::nanoseconds process_cpu_time, std::chrono::steady_clock::time_point now);
+
+private:
+  struct TunedStream {
+    StreamId id;
+    Stream stream;
+    StreamLoad window_start;
+    std::optional<dahua::StreamConfig> config;
+    std::chrono::steady_clock::time_point measure_after;
+  };
+
+  void Tune(TunedStream& tuned, const StreamLoad& load, const StreamLoad& all_streams,
+            std::chrono::nanoseconds process_cpu_time, double cpu_budget, std::chrono::steady_clock::time_point now);
+
+  const StreamTunerSettings settings_;
+  const unsigned cores_;
+  StreamId next_id_ = 0;
+  std::vector<TunedStream> streams_;
+  std::chrono::nanoseconds window_start_cpu_time_{0};
+};
+
+// Keeps the encoding of the cameras' main streams inside the CPU budget of the host. Every interval the decode and
+// processing cost of each streaming camera is measured and the cameras are tuned to their share of the budget, see
+// StreamBudget, over configManager.cgi. Adding or removing a camera starts a new measurement window, so the remaining
+// cameras are tuned to the new split.
+class StreamTuner {
+public:
+  explicit StreamTuner(StreamTunerSettings settings = {});
+  ~StreamTuner();
+
+  StreamTuner(const StreamTuner&) = delete;
+  StreamTuner& operator=(const StreamTuner&) = delete;
+
+  // Both must outlive their removal.
+  void AddCamera(dahua::DahuaPTZCamera& camera, const CameraCapture& capture);
+  // Waits for a reconfiguration in flight, afterwards the tuner no longer touches the camera.
+  void RemoveCamera(const dahua::DahuaPTZCamera& camera);
+
+private:
+  void Run();
+
+  const StreamTunerSettings settings_;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+  bool stopping_ = false;
+  bool cameras_changed_ = false;
+  StreamBudget budget_;
+  std::map<const dahua::DahuaPTZCamera*, StreamBudget::StreamId> cameras_;
+  std::thread thread_;
+};
+
+} // namespace tpxai
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+
+#include "autofocus.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+cv::Mat MakeTexture() {
+  cv::Mat texture(480, 640, CV_8UC3);
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> gray(0, 255);
+  for (int row = 0; row < texture.rows; row++) {
+    for (int col = 0; col < texture.cols; col++) {
+      const auto value = static_cast<unsigned char>(gray(rng));
+      texture.at<cv::Vec3b>(row, col) = cv::Vec3b(value, value, value);
+    }
+  }
+  return texture;
+}
+
+cv::Mat Blur(const cv::Mat& image) {
+  cv::Mat blurred;
+  cv::GaussianBlur(image, blurred, cv::Size(15, 15), 0);
+  return blurred;
+}
+
+TEST(FocusMeter, sharp_frame_scores_higher_than_blurred) {
+  const auto sharp = MakeTexture();
+  tpxai::FocusMeter meter;
+  const auto sharp_metric = meter.Measure(sharp);
+  const auto blurred_metric = meter.Measure(Blur(sharp));
+  EXPECT_GT(sharp_metric, 10 * blurred_metric);
+  // the buffers are reused, measuring again gives the same result
+  EXPECT_DOUBLE_EQ(meter.Measure(sharp), sharp_metric);
+}
+
+// A lens whose focus is moved by the motor pulses, its frames get blurrier the further it is from the sharp position.
+class FakeLens {
+public:
+  explicit FakeLens(int sharp_position_ms) : sharp_position_ms_{sharp_position_ms} {}
+
+  void Pulse(tpxai::Autofocus::Direction direction, std::chrono::milliseconds pulse) {
+    position_ms_ += direction == tpxai::Autofocus::Direction::far ? pulse.count() : -pulse.count();
+    pulses_++;
+  }
+
+  cv::Mat NextFrame() const {
+    // blending keeps the sharpness falling smoothly with the distance from the sharp position
+    const double blur = std::min(std::abs(position_ms_ - sharp_position_ms_) / 1000.0, 1.0);
+    cv::Mat frame;
+    cv::addWeighted(sharp_, 1 - blur, blurred_, blur, 0, frame);
+    return frame;
+  }
+
+  long GetPosition() const { return position_ms_; }
+  int GetPulses() const { return pulses_; }
+
+private:
+  const cv::Mat sharp_ = MakeTexture();
+  const cv::Mat blurred_ = Blur(sharp_);
+  const long sharp_position_ms_;
+  long position_ms_ = 0;
+  int pulses_ = 0;
+};
+
+tpxai::AutofocusSettings FastSettings() {
+  tpxai::AutofocusSettings settings;
+  settings.settle_frames = 0;
+  settings.averaged_frames = 1;
+  return settings;
+}
+
+void ExpectConvergesTo(int sharp_position_ms) {
+  FakeLens lens(sharp_position_ms);
+  const auto settings = FastSettings();
+  tpxai::Autofocus autofocus(
+      [&lens](tpxai::Autofocus::Direction direction, std::chrono::milliseconds pulse) { lens.Pulse(direction, pulse); },
+      [&lens] { return lens.NextFrame(); }, settings);
+  const auto result = autofocus.Run();
+
+  EXPECT_TRUE(result.converged);
+  EXPECT_LT(result.iterations, settings.max_iterations);
+  EXPECT_GT(result.final_metric, result.initial_metric);
+  EXPECT_NEAR(lens.GetPosition(), sharp_position_ms, 2 * settings.min_pulse.count());
+}
+
+TEST(Autofocus, climbs_to_the_sharp_position) { ExpectConvergesTo(700); }
+
+TEST(Autofocus, reverses_towards_a_sharp_position_on_the_near_side) {
+  // the climb starts towards far
+  ExpectConvergesTo(-500);
+}
+
+TEST(Autofocus, stays_within_the_iteration_limit) {
+  // no frame ever gets sharper, each iteration is followed by a step back
+  FakeLens lens(0);
+  auto settings = FastSettings();
+  settings.max_iterations = 3;
+  settings.min_pulse = 1ms;
+  tpxai::Autofocus autofocus(
+      [&lens](tpxai::Autofocus::Direction direction, std::chrono::milliseconds pulse) { lens.Pulse(direction, pulse); },
+      [&lens] { return lens.NextFrame(); }, settings);
+  const auto result = autofocus.Run();
+  EXPECT_FALSE(result.converged);
+  EXPECT_EQ(result.iterations, 3);
+  EXPECT_EQ(lens.GetPulses(), 6);
+  EXPECT_EQ(lens.GetPosition(), 0);
+}
+
+TEST(Autofocus, passes_frame_source_failures_on) {
+  tpxai::Autofocus autofocus([](tpxai::Autofocus::Direction, std::chrono::milliseconds) {},
+                             []() -> cv::Mat { throw std::runtime_error("camera capture stopped"); }, FastSettings());
+  EXPECT_THROW(autofocus.Run(), std::runtime_error);
+}
+
+} // anonymous namespace
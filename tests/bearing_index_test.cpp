@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "bearing_index.h"
+#include "dahua_ptz_camera.h"
+
+using namespace ::testing;
+using tpxai::Bearing;
+using tpxai::BearingIndex;
+
+namespace {
+
+double Distance(const Bearing& a, const Bearing& b) {
+  const auto cosine = tpxai::geometry::PoseToDirection(a.tilt, a.pan).dot(
+      tpxai::geometry::PoseToDirection(b.tilt, b.pan));
+  return tpxai::geometry::RadiansToDegrees(std::acos(std::clamp(cosine, -1.0, 1.0)));
+}
+
+std::vector<Bearing> MakeBearings(std::size_t count, unsigned seed) {
+  std::mt19937 generator(seed);
+  std::uniform_real_distribution<double> z(-1, 1);
+  std::uniform_real_distribution<double> pan(0, 360);
+  std::vector<Bearing> bearings(count);
+  for (auto& bearing : bearings) {
+    // uniform on the sphere, so that the poles are covered as well
+    bearing = {tpxai::geometry::RadiansToDegrees(std::asin(z(generator))), pan(generator)};
+  }
+  return bearings;
+}
+
+std::vector<BearingIndex::Id> Ids(const std::vector<BearingIndex::Neighbour>& neighbours) {
+  std::vector<BearingIndex::Id> ids;
+  for (const auto& neighbour : neighbours) {
+    ids.push_back(neighbour.id);
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+TEST(BearingIndex, nearest_wraps_around_the_pan_seam) {
+  BearingIndex index;
+  index.Insert(1, {10, 0.5});
+  index.Insert(2, {10, 355});
+  const auto nearest = index.Nearest({10, 359.5});
+  ASSERT_TRUE(nearest);
+  EXPECT_EQ(nearest->id, 1U);
+  EXPECT_NEAR(nearest->distance, 1 * std::cos(tpxai::geometry::DegreesToRadians(10.0)), 1e-3);
+  EXPECT_THAT(Ids(index.WithinRadius({10, 359.9}, 1)), ElementsAre(1));
+}
+
+TEST(BearingIndex, nearest_respects_the_max_distance) {
+  BearingIndex index;
+  index.Insert(1, {0, 90});
+  EXPECT_FALSE(index.Nearest({0, 0}, 45));
+  EXPECT_FALSE(BearingIndex().Nearest({0, 0}));
+  ASSERT_TRUE(index.Nearest({0, 0}));
+  EXPECT_NEAR(index.Nearest({0, 0})->distance, 90, 1e-9);
+}
+
+TEST(BearingIndex, queries_match_a_linear_scan) {
+  const auto bearings = MakeBearings(3000, 1);
+  BearingIndex index(3);
+  for (std::size_t i = 0; i < bearings.size(); ++i) {
+    index.Insert(i, bearings[i]);
+  }
+  ASSERT_EQ(index.Size(), bearings.size());
+
+  for (const auto& query : MakeBearings(300, 2)) {
+    std::vector<BearingIndex::Id> expected;
+    BearingIndex::Id nearest = 0;
+    for (std::size_t i = 0; i < bearings.size(); ++i) {
+      if (Distance(query, bearings[i]) <= 7) {
+        expected.push_back(i);
+      }
+      if (Distance(query, bearings[i]) < Distance(query, bearings[nearest])) {
+        nearest = i;
+      }
+    }
+    EXPECT_EQ(Ids(index.WithinRadius(query, 7)), expected);
+    ASSERT_TRUE(index.Nearest(query));
+    EXPECT_EQ(index.Nearest(query)->id, nearest);
+  }
+}
+
+TEST(BearingIndex, within_radius_is_sorted_by_distance) {
+  BearingIndex index;
+  index.Insert(1, {0, 3});
+  index.Insert(2, {0, 1});
+  index.Insert(3, {0, 2});
+  const auto neighbours = index.WithinRadius({0, 0}, 5);
+  ASSERT_EQ(neighbours.size(), 3U);
+  EXPECT_EQ(neighbours[0].id, 2U);
+  EXPECT_EQ(neighbours[1].id, 3U);
+  EXPECT_EQ(neighbours[2].id, 1U);
+  EXPECT_NEAR(neighbours[2].distance, 3, 1e-6);
+}
+
+TEST(BearingIndex, insert_moves_and_remove_erases) {
+  BearingIndex index;
+  index.Insert(1, {0, 10});
+  index.Insert(2, {0, 10.5});
+  index.Insert(1, {45, -90});
+  EXPECT_EQ(index.Size(), 2U);
+  ASSERT_TRUE(index.Get(1));
+  EXPECT_DOUBLE_EQ(index.Get(1)->pan, 270);
+  EXPECT_EQ(index.Nearest({0, 10})->id, 2U);
+
+  EXPECT_TRUE(index.Remove(2));
+  EXPECT_FALSE(index.Remove(2));
+  EXPECT_FALSE(index.Get(2));
+  EXPECT_EQ(index.Nearest({0, 10})->id, 1U);
+  EXPECT_TRUE(index.Remove(1));
+  EXPECT_EQ(index.Size(), 0U);
+}
+
+TEST(BearingIndex, remove_keeps_the_other_entries_of_a_cell) {
+  BearingIndex index(10);
+  for (BearingIndex::Id id = 0; id < 10; ++id) {
+    index.Insert(id, {1, 1 + 0.1 * static_cast<double>(id)});
+  }
+  index.Remove(0);
+  index.Remove(5);
+  EXPECT_THAT(Ids(index.WithinRadius({1, 1}, 5)), ElementsAre(1, 2, 3, 4, 6, 7, 8, 9));
+  EXPECT_DOUBLE_EQ(index.Get(9)->pan, 1.9);
+}
+
+TEST(BearingIndex, in_view_matches_the_projection) {
+  using Calibration = tpxai::dahua::Calibration;
+  const cv::Matx33d K{Calibration::fx, 0., Calibration::cx, 0., Calibration::fy, Calibration::cy, 0., 0., 1.};
+  const cv::Size frame_size(Calibration::width, Calibration::height);
+  const auto bearings = MakeBearings(20000, 3);
+  BearingIndex index;
+  for (std::size_t i = 0; i < bearings.size(); ++i) {
+    index.Insert(i, bearings[i]);
+  }
+
+  for (const Bearing pose : {Bearing{0, 0}, Bearing{20, 359}, Bearing{85, 100}, Bearing{-10, 181}}) {
+    const tpxai::geometry::PoseProjector<double> projector(tpxai::geometry::Pinhole<double>(K), pose.tilt, pose.pan);
+    const tpxai::geometry::Matrix3<double> world_to_camera = projector.GetCameraToWorld().transpose();
+    std::vector<BearingIndex::Id> expected;
+    for (std::size_t i = 0; i < bearings.size(); ++i) {
+      const tpxai::geometry::Vector3<double> ray =
+          world_to_camera * tpxai::geometry::PoseToDirection(bearings[i].tilt, bearings[i].pan);
+      const double u = K(0, 0) * ray[0] / ray[2] + K(0, 2);
+      const double v = K(1, 1) * ray[1] / ray[2] + K(1, 2);
+      if (ray[2] > 0 and u >= 0 and u < frame_size.width and v >= 0 and v < frame_size.height) {
+        expected.push_back(i);
+      }
+    }
+    ASSERT_FALSE(expected.empty());
+
+    std::vector<BearingIndex::Id> ids;
+    for (const auto& visible : index.InView(K, frame_size, pose)) {
+      ids.push_back(visible.id);
+      // the pixel leads back to the bearing
+      const auto target = projector.Target(visible.pixel.x, visible.pixel.y);
+      EXPECT_LT(Distance({target[0], target[1]}, bearings[visible.id]), 1e-4);
+    }
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, expected);
+  }
+}
+
+TEST(BearingIndex, rejects_an_invalid_cell_size) {
+  EXPECT_THROW(BearingIndex(0), std::invalid_argument);
+  EXPECT_THROW(BearingIndex(-1), std::invalid_argument);
+}
+
+} // anonymous namespace
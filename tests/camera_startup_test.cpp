@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+#include "camera_startup.h"
+#include "closed_port.h"
+
+using namespace ::testing;
+
+namespace {
+
+tpxai::CameraConfig MakeConfig(const std::string& name, unsigned short port) {
+  tpxai::CameraConfig config;
+  config.name = name;
+  config.host = "127.0.0.1";
+  config.port = port;
+  config.user = "admin";
+  config.password = "admin";
+  config.max_zoom = 25;
+  return config;
+}
+
+tpxai::StartupOptions StreamOnly(tpxai::dahua::StreamOpening stream_opening) {
+  tpxai::StartupOptions options;
+  options.stream_opening = stream_opening;
+  options.probe_device = false;
+  options.go_home = false;
+  return options;
+}
+
+TEST(StartCamera, lazy_stream_is_not_opened_during_startup) {
+  const auto started =
+      tpxai::StartCamera(MakeConfig("front", GetClosedPort()), StreamOnly(tpxai::dahua::StreamOpening::lazy));
+  ASSERT_TRUE(started.camera);
+  EXPECT_THAT(started.error, IsEmpty());
+  EXPECT_EQ(started.config.name, "front");
+  EXPECT_EQ(started.camera->GetMaxZoom(), 25);
+  EXPECT_EQ(started.report.stream_duration.count(), 0);
+  EXPECT_FALSE(started.report.probe_error);
+  EXPECT_FALSE(started.report.home_error);
+}
+
+TEST(StartCamera, failed_stream_fails_the_startup) {
+  for (const auto stream_opening : {tpxai::dahua::StreamOpening::eager, tpxai::dahua::StreamOpening::background}) {
+    const auto started = tpxai::StartCamera(MakeConfig("front", GetClosedPort()), StreamOnly(stream_opening));
+    EXPECT_FALSE(started.camera);
+    EXPECT_THAT(started.error, HasSubstr("unable to start camera capture"));
+    EXPECT_EQ(started.config.name, "front");
+  }
+}
+
+TEST(StartCamera, failed_probe_and_home_move_are_reported_but_not_fatal) {
+  tpxai::StartupOptions options;
+  options.stream_opening = tpxai::dahua::StreamOpening::lazy;
+  const auto started = tpxai::StartCamera(MakeConfig("front", GetClosedPort()), options);
+  ASSERT_TRUE(started.camera);
+  EXPECT_THAT(started.error, IsEmpty());
+  EXPECT_TRUE(started.report.probe_error);
+  EXPECT_TRUE(started.report.home_error);
+  EXPECT_THAT(started.report.device_type, IsEmpty());
+  EXPECT_EQ(started.report.frame_rate, 0);
+  EXPECT_GE(started.report.total_duration, started.report.home_duration);
+}
+
+TEST(StartCameras, reports_every_camera_in_configuration_order) {
+  const std::vector<tpxai::CameraConfig> configs = {MakeConfig("front", GetClosedPort()),
+                                                    MakeConfig("gate", GetClosedPort()),
+                                                    MakeConfig("yard", GetClosedPort())};
+
+  const auto failed = tpxai::StartCameras(configs, StreamOnly(tpxai::dahua::StreamOpening::background));
+  ASSERT_EQ(failed.size(), configs.size());
+  for (std::size_t i = 0; i < configs.size(); i++) {
+    EXPECT_EQ(failed[i].config.name, configs[i].name);
+    EXPECT_FALSE(failed[i].camera);
+    EXPECT_THAT(failed[i].error, HasSubstr("unable to start camera capture"));
+  }
+
+  const auto started = tpxai::StartCameras(configs, StreamOnly(tpxai::dahua::StreamOpening::lazy));
+  ASSERT_EQ(started.size(), configs.size());
+  for (std::size_t i = 0; i < configs.size(); i++) {
+    EXPECT_EQ(started[i].config.name, configs[i].name);
+    EXPECT_TRUE(started[i].camera);
+    EXPECT_THAT(started[i].error, IsEmpty());
+  }
+  EXPECT_TRUE(tpxai::StartCameras({}).empty());
+}
+
+} // anonymous namespace
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A local port nobody listens on, so every request and stream is refused right away instead of timing out.
+inline unsigned short GetClosedPort() {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  if (fd < 0 or bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 or
+      getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+    ADD_FAILURE() << "no free local port";
+  }
+  // the port was only bound to have the kernel pick a free one, nobody listens on it
+  close(fd);
+  return ntohs(address.sin_port);
+}
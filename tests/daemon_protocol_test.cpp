@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "command_server.h"
+#include "daemon_config.h"
+
+using namespace ::testing;
+
+namespace {
+
+TEST(DaemonProtocol, parses_click) {
+  const auto [error, command] = tpxai::ParseCommand("17 front click 1297 743");
+  ASSERT_FALSE(error);
+  EXPECT_EQ(command.id, "17");
+  EXPECT_EQ(command.camera, "front");
+  EXPECT_EQ(command.type, tpxai::Command::Type::click);
+  EXPECT_EQ(command.point.x, 1297);
+  EXPECT_EQ(command.point.y, 743);
+}
+
+TEST(DaemonProtocol, parses_move_with_optional_zoom) {
+  {
+    const auto [error, command] = tpxai::ParseCommand("a front  move\t335.5 -5");
+    ASSERT_FALSE(error);
+    EXPECT_EQ(command.type, tpxai::Command::Type::move);
+    EXPECT_THAT(command.position.horizontal_angle, FloatEq(335.5));
+    EXPECT_THAT(command.position.vertical_angle, FloatEq(-5));
+    EXPECT_FALSE(command.zoom_multiple);
+  }
+  {
+    const auto [error, command] = tpxai::ParseCommand("b front move 12 10 4");
+    ASSERT_FALSE(error);
+    ASSERT_TRUE(command.zoom_multiple);
+    EXPECT_EQ(*command.zoom_multiple, 4);
+  }
+}
+
+TEST(DaemonProtocol, parses_zoom_and_focus) {
+  {
+    const auto [error, command] = tpxai::ParseCommand("1 back zoom 8");
+    ASSERT_FALSE(error);
+    EXPECT_EQ(command.type, tpxai::Command::Type::zoom);
+    EXPECT_EQ(*command.zoom_multiple, 8);
+  }
+  {
+    const auto [error, command] = tpxai::ParseCommand("2 back focus far 3 50");
+    ASSERT_FALSE(error);
+    EXPECT_EQ(command.type, tpxai::Command::Type::focus_far);
+    EXPECT_EQ(command.speed, 3);
+    EXPECT_EQ(command.pulse_duration, std::chrono::milliseconds{50});
+  }
+}
+
+TEST(DaemonProtocol, rejects_malformed_commands) {
+  EXPECT_TRUE(tpxai::ParseCommand("").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front click 10").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front click 10 x").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front move 1.5.2 3").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front zoom 70000").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front focus sideways 1").first);
+  EXPECT_TRUE(tpxai::ParseCommand("1 front fly 1 2").first);
+}
+
+std::vector<tpxai::Command> ParseCommands(std::initializer_list<const char*> lines) {
+  std::vector<tpxai::Command> commands;
+  for (const auto* line : lines) {
+    commands.push_back(tpxai::ParseCommand(line).second);
+  }
+  return commands;
+}
+
+TEST(DaemonProtocol, supersedes_consecutive_moves_only) {
+  auto commands = ParseCommands({"1 a move 1 1", "2 a zoom 4", "3 a move 2 2", "4 a move 3 3", "5 a focus far 1"});
+  EXPECT_THAT(tpxai::SupersedeMoves(commands), ElementsAre(false, false, true, false, false));
+}
+
+TEST(DaemonProtocol, superseded_zoom_is_carried_into_the_following_move) {
+  auto commands = ParseCommands({"1 a move 10 5 8", "2 a move 12 5", "3 a move 14 5", "4 a move 16 5 2"});
+  EXPECT_THAT(tpxai::SupersedeMoves(commands), ElementsAre(true, true, true, false));
+  EXPECT_THAT(commands[2].zoom_multiple, Optional(8));
+  // a move with a zoom of its own keeps it
+  EXPECT_THAT(commands[3].zoom_multiple, Optional(2));
+  EXPECT_THAT(commands[3].position.horizontal_angle, FloatEq(16));
+
+  auto without_zoom = ParseCommands({"1 a move 10 5", "2 a move 12 5"});
+  tpxai::SupersedeMoves(without_zoom);
+  EXPECT_FALSE(without_zoom[1].zoom_multiple);
+}
+
+// A server without cameras, which answers every well-formed command with "ERR unknown camera".
+class CommandServerTest : public Test {
+protected:
+  void SetUp() override {
+    server_ = std::make_unique<tpxai::CommandServer>(path_, std::map<std::string, tpxai::dahua::DahuaPTZCamera*>{});
+    thread_ = std::thread([this] { server_->Run(); });
+  }
+
+  void TearDown() override {
+    server_->Stop();
+    thread_.join();
+    server_.reset();
+  }
+
+  int Connect() const {
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strcpy(address.sun_path, path_.c_str());
+    EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    const timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+  }
+
+  static bool Send(int fd, const std::string& data) {
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+  }
+
+  static std::string ReadLine(int fd) {
+    std::string line;
+    char c = 0;
+    while (read(fd, &c, 1) == 1 and c != '\n') {
+      line += c;
+    }
+    return line;
+  }
+
+  const std::string path_ = "/tmp/goto_point_test_" + std::to_string(getpid()) + ".sock";
+  std::unique_ptr<tpxai::CommandServer> server_;
+  std::thread thread_;
+};
+
+TEST_F(CommandServerTest, answers_commands) {
+  const int fd = Connect();
+  ASSERT_TRUE(Send(fd, "1 front zoom 2\n2 front\n"));
+  EXPECT_EQ(ReadLine(fd), "1 ERR unknown camera");
+  EXPECT_EQ(ReadLine(fd), "2 ERR malformed command");
+  close(fd);
+}
+
+TEST_F(CommandServerTest, client_not_reading_its_answers_does_not_stall_the_others) {
+  const int stalled = Connect();
+  // several megabytes of answers, far more than the socket buffers hold
+  std::thread flood([stalled] {
+    std::string commands;
+    for (int i = 0; i < 10000; i++) {
+      commands += "1 front zoom 2\n";
+    }
+    for (int i = 0; i < 50 and Send(stalled, commands); i++) {
+    }
+  });
+
+  const int fd = Connect();
+  ASSERT_TRUE(Send(fd, "7 front zoom 2\n"));
+  EXPECT_EQ(ReadLine(fd), "7 ERR unknown camera");
+  close(fd);
+
+  // the stalled client is disconnected once its answers pile up, which also ends its sends
+  flood.join();
+  close(stalled);
+}
+
+TEST_F(CommandServerTest, disconnects_a_client_sending_an_overlong_line) {
+  const int fd = Connect();
+  ASSERT_TRUE(Send(fd, std::string(10000, 'x')));
+  char c = 0;
+  EXPECT_EQ(read(fd, &c, 1), 0);
+  close(fd);
+}
+
+TEST(DaemonConfig, parses_cameras) {
+  std::istringstream input(R"(
+# comment
+socket = /run/goto_point.sock
+metrics_file = /tmp/goto_point.prom
+
+[camera front]
+host = 192.168.1.102
+user = admin
+password = secret
+
+[camera back]
+host=192.168.1.103
+port=8080
+max_zoom=25
+)");
+  const auto config = tpxai::ParseDaemonConfig(input);
+  EXPECT_EQ(config.socket_path, "/run/goto_point.sock");
+  EXPECT_EQ(config.metrics_file, "/tmp/goto_point.prom");
+  ASSERT_EQ(config.cameras.size(), 2U);
+  EXPECT_EQ(config.cameras[0].name, "front");
+  EXPECT_EQ(config.cameras[0].host, "192.168.1.102");
+  EXPECT_EQ(config.cameras[0].port, 80);
+  EXPECT_EQ(config.cameras[0].user, "admin");
+  EXPECT_EQ(config.cameras[0].password, "secret");
+  EXPECT_EQ(config.cameras[0].max_zoom, 32);
+  EXPECT_EQ(config.cameras[1].name, "back");
+  EXPECT_EQ(config.cameras[1].port, 8080);
+  EXPECT_EQ(config.cameras[1].max_zoom, 25);
+}
+
+TEST(DaemonConfig, rejects_invalid_config) {
+  for (const auto* text : {"[camera front]\nport = 80\n", "[camera a]\nhost = x\n[camera a]\nhost = y\n",
+                           "[camera a]\nhost = x\nport = 99999\n", "[camera a]\nhost = x\nmax_zoom = 0\n", "[lens]\n",
+                           "colour = red\n", "host\n"}) {
+    std::istringstream input(text);
+    EXPECT_THROW(tpxai::ParseDaemonConfig(input), std::runtime_error) << text;
+  }
+}
+
+} // anonymous namespace
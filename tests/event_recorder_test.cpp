@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "event_recorder.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+class EventRecorderTest : public Test {
+protected:
+  void SetUp() override {
+    char directory[] = "/tmp/event_recorder_test_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory));
+    directory_ = directory;
+    settings_.output_directory = directory_;
+    settings_.pre_roll = 1000ms;
+    settings_.post_roll = 500ms;
+    // every frame is the same image, so every recorded frame has the same size
+    std::vector<unsigned char> jpeg;
+    cv::imencode(".jpg", image_, jpeg, {cv::IMWRITE_JPEG_QUALITY, settings_.jpeg_quality});
+    jpeg_size_ = jpeg.size();
+  }
+
+  void TearDown() override {
+    for (const auto& path : ListRecordings()) {
+      std::remove(path.c_str());
+    }
+    rmdir(directory_.c_str());
+  }
+
+  // a frame captured the given time after the start of the test
+  tpxai::Frame MakeFrame(std::chrono::milliseconds time) const {
+    tpxai::Frame frame;
+    frame.image = image_;
+    frame.capture_time = std::chrono::steady_clock::time_point{} + 1h + time;
+    return frame;
+  }
+
+  // frames every 100 ms from the first to the last time, both included
+  void Feed(tpxai::EventRecorder& recorder, std::chrono::milliseconds first, std::chrono::milliseconds last) const {
+    for (auto time = first; time <= last; time += 100ms) {
+      recorder.OnFrame(MakeFrame(time));
+    }
+  }
+
+  std::vector<std::string> ListRecordings() const {
+    std::vector<std::string> paths;
+    if (auto directory = opendir(directory_.c_str())) {
+      while (const auto entry = readdir(directory)) {
+        const std::string name = entry->d_name;
+        if (name.rfind("event_", 0) == 0) {
+          paths.push_back(directory_ + "/" + name);
+        }
+      }
+      closedir(directory);
+    }
+    return paths;
+  }
+
+  // frames in the only recording, or -1 when its size is not a whole number of frames
+  long CountRecordedFrames() const {
+    const auto paths = ListRecordings();
+    EXPECT_EQ(paths.size(), 1U);
+    if (paths.empty()) {
+      return 0;
+    }
+    std::ifstream file(paths.front(), std::ios::binary | std::ios::ate);
+    const auto size = static_cast<std::size_t>(file.tellg());
+    return size % jpeg_size_ == 0 ? static_cast<long>(size / jpeg_size_) : -1;
+  }
+
+  static void WaitForRecordings(const tpxai::EventRecorder& recorder, std::uint64_t recordings) {
+    for (auto deadline = std::chrono::steady_clock::now() + 5s;
+         recorder.GetStats().recordings < recordings and std::chrono::steady_clock::now() < deadline;) {
+      std::this_thread::sleep_for(1ms);
+    }
+  }
+
+  const cv::Mat image_ = cv::Mat(240, 320, CV_8UC3, cv::Scalar(40, 120, 200));
+  std::string directory_;
+  tpxai::EventRecorderSettings settings_;
+  std::size_t jpeg_size_ = 0;
+};
+
+TEST_F(EventRecorderTest, records_the_pre_roll_and_the_post_roll) {
+  tpxai::EventRecorder recorder(settings_);
+  Feed(recorder, 0ms, 1900ms);
+  // the ring holds the frames of the last second
+  EXPECT_EQ(recorder.GetStats().ring_frames, 11U);
+  EXPECT_EQ(recorder.GetStats().ring_bytes, 11 * jpeg_size_);
+
+  // applied to the next frame, at 2000 ms: the pre-roll from 1000 ms and the post-roll up to 2500 ms
+  recorder.Trigger("test");
+  Feed(recorder, 2000ms, 3000ms);
+  WaitForRecordings(recorder, 1);
+  const auto stats = recorder.GetStats();
+  EXPECT_EQ(stats.recordings, 1U);
+  EXPECT_EQ(stats.dropped_frames, 0U);
+  EXPECT_EQ(stats.pending_bytes, 0U);
+  EXPECT_EQ(stats.written_bytes, 16 * jpeg_size_);
+  EXPECT_EQ(CountRecordedFrames(), 16);
+}
+
+TEST_F(EventRecorderTest, ring_stays_within_the_memory_limit) {
+  settings_.memory_limit = 3 * jpeg_size_;
+  tpxai::EventRecorder recorder(settings_);
+  Feed(recorder, 0ms, 1900ms);
+  EXPECT_EQ(recorder.GetStats().ring_frames, 3U);
+  EXPECT_EQ(recorder.GetStats().ring_bytes, 3 * jpeg_size_);
+
+  recorder.Trigger("test");
+  Feed(recorder, 2000ms, 3000ms);
+  WaitForRecordings(recorder, 1);
+  // the pre-roll is cut to the frames which fit the ring
+  EXPECT_EQ(CountRecordedFrames(), 3 + 5);
+}
+
+TEST_F(EventRecorderTest, trigger_during_a_recording_extends_it) {
+  tpxai::EventRecorder recorder(settings_);
+  Feed(recorder, 0ms, 1900ms);
+  recorder.Trigger("first");
+  Feed(recorder, 2000ms, 2300ms);
+  // applied at 2400 ms, the recording now lasts until 2900 ms
+  recorder.Trigger("second");
+  Feed(recorder, 2400ms, 3500ms);
+  WaitForRecordings(recorder, 1);
+  EXPECT_EQ(recorder.GetStats().recordings, 1U);
+  EXPECT_EQ(CountRecordedFrames(), 11 + 9);
+}
+
+TEST_F(EventRecorderTest, drops_frames_the_writer_cannot_take) {
+  // less than the pre-roll, which is therefore dropped as a whole
+  settings_.max_pending_bytes = 5 * jpeg_size_;
+  tpxai::EventRecorder recorder(settings_);
+  Feed(recorder, 0ms, 1900ms);
+  recorder.Trigger("test");
+  Feed(recorder, 2000ms, 3000ms);
+  WaitForRecordings(recorder, 1);
+
+  // the post-roll frames are dropped too when the writer is behind, every frame is either written or dropped
+  const auto stats = recorder.GetStats();
+  EXPECT_EQ(stats.recordings, 1U);
+  EXPECT_GE(stats.dropped_frames, 11U);
+  EXPECT_EQ(stats.pending_bytes, 0U);
+  const auto written_frames = stats.written_bytes / jpeg_size_;
+  EXPECT_EQ(written_frames + stats.dropped_frames, 16U);
+  EXPECT_EQ(CountRecordedFrames(), static_cast<long>(written_frames));
+}
+
+} // anonymous namespace
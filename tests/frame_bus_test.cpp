@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <future>
+
+#include "frame_bus.h"
+
+using namespace ::testing;
+
+namespace {
+
+tpxai::SharedFrame MakeFrame(std::uint64_t sequence) {
+  auto frame = std::make_shared<tpxai::Frame>();
+  frame->sequence = sequence;
+  return frame;
+}
+
+TEST(FrameBus, every_subscriber_gets_the_same_frame) {
+  tpxai::FrameBus bus;
+  auto first = bus.Subscribe(4, tpxai::BackpressurePolicy::drop_oldest);
+  auto second = bus.Subscribe(4, tpxai::BackpressurePolicy::drop_newest);
+
+  const auto frame = MakeFrame(7);
+  bus.Publish(frame);
+
+  EXPECT_EQ(first->Pop(), frame);
+  EXPECT_EQ(second->Pop(), frame);
+  EXPECT_EQ(bus.GetPublishedFrames(), 1U);
+}
+
+TEST(FrameBus, drop_oldest_keeps_the_newest_frames) {
+  tpxai::FrameBus bus;
+  auto subscription = bus.Subscribe(2, tpxai::BackpressurePolicy::drop_oldest);
+  for (std::uint64_t i = 0; i < 5; i++) {
+    bus.Publish(MakeFrame(i));
+  }
+  EXPECT_EQ(subscription->Pop()->sequence, 3U);
+  EXPECT_EQ(subscription->Pop()->sequence, 4U);
+  EXPECT_EQ(subscription->TryPop(), nullptr);
+  EXPECT_EQ(subscription->GetDroppedFrames(), 3U);
+}
+
+TEST(FrameBus, drop_newest_keeps_the_oldest_frames) {
+  tpxai::FrameBus bus;
+  auto subscription = bus.Subscribe(2, tpxai::BackpressurePolicy::drop_newest);
+  for (std::uint64_t i = 0; i < 5; i++) {
+    bus.Publish(MakeFrame(i));
+  }
+  EXPECT_EQ(subscription->Pop()->sequence, 0U);
+  EXPECT_EQ(subscription->Pop()->sequence, 1U);
+  EXPECT_EQ(subscription->TryPop(), nullptr);
+  EXPECT_EQ(subscription->GetDroppedFrames(), 3U);
+}
+
+TEST(FrameBus, block_stalls_the_publisher_until_consumed) {
+  tpxai::FrameBus bus;
+  auto subscription = bus.Subscribe(1, tpxai::BackpressurePolicy::block);
+  bus.Publish(MakeFrame(0));
+
+  auto publisher = std::async(std::launch::async, [&bus] { bus.Publish(MakeFrame(1)); });
+  EXPECT_EQ(publisher.wait_for(std::chrono::milliseconds{50}), std::future_status::timeout);
+
+  EXPECT_EQ(subscription->Pop()->sequence, 0U);
+  EXPECT_EQ(publisher.wait_for(std::chrono::seconds{5}), std::future_status::ready);
+  EXPECT_EQ(subscription->Pop()->sequence, 1U);
+  EXPECT_EQ(subscription->GetDroppedFrames(), 0U);
+}
+
+TEST(FrameBus, close_wakes_waiting_consumers) {
+  tpxai::FrameBus bus;
+  auto subscription = bus.Subscribe(1, tpxai::BackpressurePolicy::drop_oldest);
+  auto consumer = std::async(std::launch::async, [&subscription] { return subscription->Pop(); });
+  bus.Close();
+  EXPECT_EQ(consumer.get(), nullptr);
+}
+
+TEST(FrameBus, unsubscribed_consumer_stops_receiving) {
+  tpxai::FrameBus bus;
+  auto subscription = bus.Subscribe(4, tpxai::BackpressurePolicy::drop_oldest);
+  bus.Publish(MakeFrame(0));
+  bus.Unsubscribe(subscription);
+  bus.Publish(MakeFrame(1));
+  EXPECT_EQ(subscription->Pop()->sequence, 0U);
+  EXPECT_EQ(subscription->Pop(), nullptr);
+}
+
+TEST(FrameBus, consumer_runs_callback_for_each_frame) {
+  tpxai::FrameBus bus;
+  std::promise<std::uint64_t> last_sequence;
+  {
+    tpxai::FrameConsumer consumer(bus, 8, tpxai::BackpressurePolicy::block, [&](const tpxai::SharedFrame& frame) {
+      if (frame->sequence == 2) {
+        last_sequence.set_value(frame->sequence);
+      }
+    });
+    for (std::uint64_t i = 0; i < 3; i++) {
+      bus.Publish(MakeFrame(i));
+    }
+    EXPECT_EQ(last_sequence.get_future().get(), 2U);
+  }
+}
+
+} // anonymous namespace
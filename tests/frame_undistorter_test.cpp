@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <opencv2/imgproc.hpp>
+
+#include "frame_undistorter.h"
+
+using namespace ::testing;
+
+namespace {
+
+const tpxai::CameraIntrinsics intrinsics{cv::Matx33d{500., 0., 320., 0., 500., 240., 0., 0., 1.},
+                                         {0.03, 0.2, -0.0007, -0.002}};
+
+TEST(FrameUndistorter, reuses_the_maps_of_the_same_geometry) {
+  tpxai::FrameUndistorter undistorter;
+  const cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(10, 20, 30));
+  undistorter.Undistort(frame, intrinsics, 1);
+  undistorter.Undistort(frame, intrinsics, 1);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 1U);
+  // every zoom level and output size has its own maps
+  undistorter.Undistort(frame, intrinsics, 2);
+  undistorter.Undistort(frame, intrinsics, 1, cv::Size(320, 240));
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 3U);
+  undistorter.Undistort(frame, intrinsics, 2);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 3U);
+}
+
+TEST(FrameUndistorter, evicts_the_least_recently_used_maps) {
+  tpxai::FrameUndistorter undistorter(2);
+  const cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(10, 20, 30));
+  undistorter.Undistort(frame, intrinsics, 1);
+  undistorter.Undistort(frame, intrinsics, 2);
+  undistorter.Undistort(frame, intrinsics, 1);
+  // evicts zoom 2, which was used less recently than zoom 1
+  undistorter.Undistort(frame, intrinsics, 3);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 3U);
+  undistorter.Undistort(frame, intrinsics, 1);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 3U);
+  undistorter.Undistort(frame, intrinsics, 2);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 4U);
+}
+
+TEST(FrameUndistorter, flushes_the_cache_when_the_calibration_changes) {
+  tpxai::FrameUndistorter undistorter;
+  const cv::Mat frame(480, 640, CV_8UC3, cv::Scalar(10, 20, 30));
+  undistorter.Undistort(frame, intrinsics, 1);
+  undistorter.Undistort(frame, intrinsics, 2);
+  // the stream resolution changed, and with it the camera matrix
+  const auto scaled = intrinsics.ForResolution(cv::Size(640, 480), cv::Size(1280, 960));
+  undistorter.Undistort(frame, scaled, 1);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 3U);
+  undistorter.Undistort(frame, intrinsics, 1);
+  undistorter.Undistort(frame, intrinsics, 2);
+  EXPECT_EQ(undistorter.GetBuiltMaps(), 5U);
+}
+
+TEST(FrameUndistorter, scales_the_output_in_the_same_pass) {
+  // without distortion the remap only scales, so a bright spot moves with the size ratio
+  const tpxai::CameraIntrinsics pinhole{intrinsics.K, {}};
+  cv::Mat frame = cv::Mat::zeros(480, 640, CV_8UC1);
+  cv::rectangle(frame, cv::Rect(396, 296, 8, 8), cv::Scalar(255), cv::FILLED);
+  tpxai::FrameUndistorter undistorter;
+
+  const auto output = undistorter.Undistort(frame, pinhole, 1, cv::Size(320, 240));
+  ASSERT_EQ(output.size(), cv::Size(320, 240));
+  EXPECT_EQ(output.type(), frame.type());
+  EXPECT_GT(output.at<unsigned char>(150, 200), 200);
+  EXPECT_EQ(output.at<unsigned char>(120, 160), 0);
+
+  const auto full = undistorter.Undistort(frame, pinhole, 1);
+  ASSERT_EQ(full.size(), frame.size());
+  EXPECT_GT(full.at<unsigned char>(300, 400), 200);
+  EXPECT_EQ(full.at<unsigned char>(150, 200), 0);
+}
+
+} // anonymous namespace
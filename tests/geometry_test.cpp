@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "dahua_ptz_camera.h"
+#include "geometry.h"
+#include "legacy_position_calculator.h"
+
+using namespace ::testing;
+
+namespace {
+
+static_assert(tpxai::geometry::DegreesToRadians(180.0) == tpxai::geometry::pi<double>);
+static_assert(tpxai::geometry::RadiansToDegrees(tpxai::geometry::pi<float>) == 180.F);
+
+const cv::Matx33d K{tpxai::dahua::Calibration::fx, 0., tpxai::dahua::Calibration::cx,
+                    0., tpxai::dahua::Calibration::fy, tpxai::dahua::Calibration::cy,
+                    0., 0., 1.};
+
+// great-circle distance in degrees between the optical axes of two poses, well defined also near the zenith where
+// the pan of a pose is not
+double PoseDistance(double tilt_a, double pan_a, double tilt_b, double pan_b) {
+  using tpxai::geometry::DegreesToRadians;
+  const auto direction = [](double tilt, double pan) {
+    return Eigen::Vector3d{std::cos(DegreesToRadians(tilt)) * std::sin(DegreesToRadians(pan)),
+                           std::sin(DegreesToRadians(tilt)),
+                           std::cos(DegreesToRadians(tilt)) * std::cos(DegreesToRadians(pan))};
+  };
+  const double cosine = std::clamp(direction(tilt_a, pan_a).dot(direction(tilt_b, pan_b)), -1.0, 1.0);
+  return tpxai::geometry::RadiansToDegrees(std::acos(cosine));
+}
+
+struct Sample {
+  float tilt;
+  float pan;
+  int u;
+  int v;
+};
+
+std::vector<Sample> MakeSamples(std::size_t count) {
+  std::mt19937 generator(7);
+  std::uniform_real_distribution<float> tilt(-15, 90);
+  std::uniform_real_distribution<float> pan(0, 360);
+  std::uniform_int_distribution<int> u(0, tpxai::dahua::Calibration::width - 1);
+  std::uniform_int_distribution<int> v(0, tpxai::dahua::Calibration::height - 1);
+  std::vector<Sample> samples(count);
+  for (auto& sample : samples) {
+    sample = {tilt(generator), pan(generator), u(generator), v(generator)};
+  }
+  return samples;
+}
+
+template <typename Scalar>
+double MaxErrorAgainstLegacy(const std::vector<Sample>& samples) {
+  double max_error = 0;
+  for (const auto& sample : samples) {
+    const auto legacy = tpxai::legacy::CalculateAbsolutePosition({sample.u, sample.v}, K, {sample.tilt, sample.pan, 0});
+    const tpxai::geometry::PoseProjector<Scalar> projector(tpxai::geometry::Pinhole<Scalar>(K), sample.tilt,
+                                                           sample.pan);
+    const auto target = projector.Target(sample.u, sample.v);
+    max_error = std::max(max_error, PoseDistance(legacy[0], legacy[1], target[0], target[1]));
+  }
+  return max_error;
+}
+
+TEST(Geometry, float_path_matches_the_legacy_calculation) {
+  EXPECT_LT(MaxErrorAgainstLegacy<float>(MakeSamples(20000)), 2e-3);
+}
+
+TEST(Geometry, double_path_matches_the_legacy_calculation) {
+  // the difference is the rounding error of the legacy float calculation
+  EXPECT_LT(MaxErrorAgainstLegacy<double>(MakeSamples(20000)), 2e-3);
+}
+
+TEST(Geometry, pan_stays_in_one_turn_across_the_seam) {
+  const tpxai::geometry::PoseProjector<double> projector(tpxai::geometry::Pinhole<double>(K), 0, 359.5);
+  const auto right = projector.Target(tpxai::dahua::Calibration::cx + 100, tpxai::dahua::Calibration::cy);
+  const auto left = projector.Target(tpxai::dahua::Calibration::cx - 100, tpxai::dahua::Calibration::cy);
+  EXPECT_THAT(right[1], AllOf(Ge(0.), Lt(360.)));
+  EXPECT_THAT(left[1], AllOf(Ge(0.), Lt(360.)));
+  // like PositionABS, the pan grows to the left
+  EXPECT_NEAR(left[1], 359.5 + 2.45 - 360, 0.05);
+  EXPECT_NEAR(right[1], 359.5 - 2.45, 0.05);
+}
+
+TEST(Geometry, principal_point_keeps_the_pose) {
+  const tpxai::geometry::PoseProjector<double> projector(tpxai::geometry::Pinhole<double>(K), 30, 120);
+  const auto target = projector.Target(tpxai::dahua::Calibration::cx, tpxai::dahua::Calibration::cy);
+  EXPECT_NEAR(target[0], 30, 1e-9);
+  EXPECT_NEAR(target[1], 120, 1e-9);
+}
+
+TEST(Geometry, fixed_intrinsics_give_the_same_result) {
+  using Fixed = tpxai::geometry::FixedPinhole<float, tpxai::dahua::Calibration>;
+  for (const auto& sample : MakeSamples(1000)) {
+    const tpxai::geometry::PoseProjector<float> runtime(tpxai::geometry::Pinhole<float>(K), sample.tilt, sample.pan);
+    const tpxai::geometry::PoseProjector<float, Fixed> fixed(Fixed{}, sample.tilt, sample.pan);
+    EXPECT_EQ(runtime.Target(sample.u, sample.v), fixed.Target(sample.u, sample.v));
+  }
+}
+
+} // anonymous namespace
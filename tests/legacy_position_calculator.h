@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cmath>
+
+#include <Eigen/Geometry>
+#include <opencv2/core.hpp>
+
+namespace tpxai::legacy {
+
+// The position calculation as it was before the templated geometry core, kept as the reference for its error bounds
+// and its benchmark.
+
+inline Eigen::Vector3f DegreesToRadians(Eigen::Vector3f degrees) noexcept { return degrees * CV_PI / 180; }
+
+inline Eigen::Vector3f RadiansToDegrees(Eigen::Vector3f radians) noexcept { return radians * 180 / CV_PI; }
+
+inline Eigen::Matrix3f EulerAnglesToRotationMatrix(const Eigen::Vector3f& theta) {
+  const Eigen::AngleAxisf x_angle_rot(theta[0], Eigen::Vector3f::UnitX());
+  const Eigen::AngleAxisf y_angle_rot(theta[1], Eigen::Vector3f::UnitY());
+
+  Eigen::Matrix3f m;
+  m = y_angle_rot * x_angle_rot;
+  return m;
+}
+
+inline Eigen::Vector3f CalculatePointInScreenCoords(const cv::Point& point, const cv::Matx33d& K) {
+  const auto cx = K(0, 2);
+  const auto cy = K(1, 2);
+  const auto fx = K(0, 0);
+  const auto fy = K(1, 1);
+  float x = (point.x - cx) / fx;
+  float y = (point.y - cy) / fy;
+  return {x, y, 1};
+}
+
+inline Eigen::Vector3f ComputeAnglesFromPoint(const Eigen::Vector3f& point) {
+  const Eigen::Vector2f projection_XZ {point[0], point[2]};
+  const Eigen::Vector2f projection_YZ {point[1], projection_XZ.norm()};
+
+  auto x_angle = std::atan2(projection_YZ[0], projection_YZ[1]);
+  auto y_angle = -std::atan2(projection_XZ[0], projection_XZ[1]);
+
+  y_angle = y_angle >= 0 ? y_angle : CV_2PI + y_angle;
+
+  return {x_angle, y_angle, 0.f};
+}
+
+inline Eigen::Vector3f CalculateAbsolutePosition(const cv::Point& point, const cv::Matx33d& K,
+                                                 const Eigen::Vector3f& current_euler_angles) {
+  auto current_euler_angles_in_radians = DegreesToRadians(-current_euler_angles);
+  const Eigen::Matrix3f current_to_global_rotation = EulerAnglesToRotationMatrix(current_euler_angles_in_radians);
+  const Eigen::Vector3f point_in_camera_coords = CalculatePointInScreenCoords(point, K);
+  auto point_in_global = current_to_global_rotation * point_in_camera_coords;
+  return RadiansToDegrees(ComputeAnglesFromPoint(point_in_global));
+}
+
+} // namespace tpxai::legacy
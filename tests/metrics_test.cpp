@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+using tpxai::metrics::Histogram;
+
+TEST(Histogram, buckets_are_contiguous_with_bounded_relative_error) {
+  EXPECT_EQ(Histogram::GetBucket(0), 0U);
+  EXPECT_EQ(Histogram::GetBucket(7), 7U);
+  EXPECT_EQ(Histogram::GetBucket(8), 8U);
+  for (std::uint64_t value : {8ULL, 9ULL, 100ULL, 1000ULL, 123456789ULL, 1ULL << 40}) {
+    const auto bucket = Histogram::GetBucket(value);
+    const auto upper = Histogram::GetBucketUpperBound(bucket);
+    const auto lower = Histogram::GetBucketUpperBound(bucket - 1);
+    EXPECT_LE(lower, value);
+    EXPECT_LT(value, upper);
+    EXPECT_LE(static_cast<double>(upper - lower) / lower, 0.125);
+    EXPECT_EQ(Histogram::GetBucket(upper), bucket + 1);
+  }
+  EXPECT_EQ(Histogram::GetBucket(~0ULL), Histogram::bucket_count - 1);
+}
+
+TEST(Histogram, snapshot_merges_all_threads) {
+  Histogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&histogram] {
+      for (int i = 0; i < 1000; i++) {
+        histogram.Record(1ms);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  histogram.Record(-1ms);
+
+  const auto snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(snapshot.count, 4001U);
+  EXPECT_EQ(snapshot.sum, 4000ms);
+  EXPECT_EQ(snapshot.CountBelow(1), 1U);
+  EXPECT_EQ(snapshot.CountBelow(1ULL << 20), 4001U);
+  EXPECT_THAT(snapshot.GetPercentile(0.5).count(), AllOf(Gt(1000000), Le(1125000)));
+  EXPECT_EQ(snapshot.GetPercentile(0.0), 1ns);
+}
+
+TEST(Registry, same_name_and_labels_give_the_same_metric) {
+  tpxai::metrics::Registry registry;
+  auto& first = registry.GetCounter("frames_total", "Frames", {{"stage", "capture"}});
+  auto& second = registry.GetCounter("frames_total", "Frames", {{"stage", "capture"}});
+  auto& other = registry.GetCounter("frames_total", "Frames", {{"stage", "display"}});
+  EXPECT_EQ(&first, &second);
+  EXPECT_NE(&first, &other);
+}
+
+TEST(Registry, writes_prometheus_text) {
+  tpxai::metrics::Registry registry;
+  registry.GetCounter("dropped_frames_total", "Dropped frames", {{"consumer", "preview"}}).Add(3);
+  registry.GetCounter("dropped_frames_total", "Dropped frames", {{"consumer", "say \"hi\""}}).Add();
+  auto& latency = registry.GetHistogram("request_seconds", "Request latency", {{"code", "PositionABS"}});
+  latency.Record(1500us);
+  latency.Record(3s);
+
+  std::ostringstream output;
+  registry.WritePrometheusText(output);
+  const auto text = output.str();
+  EXPECT_THAT(text, HasSubstr("# TYPE dropped_frames_total counter\n"
+                              "dropped_frames_total{consumer=\"preview\"} 3\n"
+                              "dropped_frames_total{consumer=\"say \\\"hi\\\"\"} 1\n"));
+  EXPECT_THAT(text, HasSubstr("# TYPE request_seconds histogram\n"));
+  EXPECT_THAT(text, HasSubstr("request_seconds_bucket{code=\"PositionABS\",le=\"0.001048576\"} 0\n"));
+  EXPECT_THAT(text, HasSubstr("request_seconds_bucket{code=\"PositionABS\",le=\"0.002097152\"} 1\n"));
+  EXPECT_THAT(text, HasSubstr("request_seconds_bucket{code=\"PositionABS\",le=\"+Inf\"} 2\n"));
+  EXPECT_THAT(text, HasSubstr("request_seconds_sum{code=\"PositionABS\"} 3.0015\n"));
+  EXPECT_THAT(text, HasSubstr("request_seconds_count{code=\"PositionABS\"} 2\n"));
+}
+
+} // anonymous namespace
@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <opencv2/imgproc.hpp>
+
+#include "motion_detector.h"
+
+using namespace ::testing;
+
+namespace {
+
+// a uniform gray frame with an optional bright square
+tpxai::Frame MakeFrame(cv::Size size, std::optional<cv::Rect> object = std::nullopt) {
+  tpxai::Frame frame;
+  frame.image = cv::Mat(size, CV_8UC3, cv::Scalar(60, 60, 60));
+  if (object) {
+    cv::rectangle(frame.image, *object, cv::Scalar(230, 230, 230), cv::FILLED);
+  }
+  frame.zoom_multiple = 1;
+  return frame;
+}
+
+tpxai::MotionDetectorSettings ShortWarmup() {
+  tpxai::MotionDetectorSettings settings;
+  settings.warmup_frames = 3;
+  return settings;
+}
+
+// processes frames of a static scene until the background is built
+void WarmUp(tpxai::MotionDetector& detector, const tpxai::Frame& frame) {
+  for (int i = 0; i < 3; i++) {
+    EXPECT_FALSE(detector.Process(frame));
+  }
+}
+
+TEST(MotionDetector, finds_the_largest_moving_blob) {
+  tpxai::MotionDetector detector(ShortWarmup());
+  const cv::Size size(1280, 720);
+  WarmUp(detector, MakeFrame(size));
+
+  auto frame = MakeFrame(size, cv::Rect(800, 200, 160, 120));
+  // a single pixel once downscaled by 8, smaller than the minimal blob area even when dilated
+  cv::rectangle(frame.image, cv::Rect(96, 496, 8, 8), cv::Scalar(230, 230, 230), cv::FILLED);
+  const auto detection = detector.Process(frame);
+  ASSERT_TRUE(detection);
+  EXPECT_NEAR(detection->centroid.x, 880, 16);
+  EXPECT_NEAR(detection->centroid.y, 260, 16);
+  // the mask is dilated by a pixel of the downscaled frame on each side
+  EXPECT_NEAR(detection->bounding_box.x, 800, 16);
+  EXPECT_NEAR(detection->bounding_box.y, 200, 16);
+  EXPECT_NEAR(detection->bounding_box.width, 160, 24);
+  EXPECT_NEAR(detection->bounding_box.height, 120, 24);
+  EXPECT_NEAR(detection->area, 20 * 15, 80);
+}
+
+TEST(MotionDetector, ignores_small_blobs_and_static_scenes) {
+  tpxai::MotionDetector detector(ShortWarmup());
+  const cv::Size size(1280, 720);
+  WarmUp(detector, MakeFrame(size));
+  EXPECT_FALSE(detector.Process(MakeFrame(size)));
+  EXPECT_FALSE(detector.Process(MakeFrame(size, cv::Rect(96, 496, 8, 8))));
+}
+
+TEST(MotionDetector, reports_nothing_while_building_the_background) {
+  tpxai::MotionDetector detector(ShortWarmup());
+  const cv::Size size(1280, 720);
+  EXPECT_FALSE(detector.Process(MakeFrame(size)));
+  // the second and third frames only build the background, whatever they show
+  EXPECT_FALSE(detector.Process(MakeFrame(size, cv::Rect(800, 200, 160, 120))));
+  EXPECT_FALSE(detector.Process(MakeFrame(size)));
+  EXPECT_TRUE(detector.Process(MakeFrame(size, cv::Rect(800, 200, 160, 120))));
+}
+
+TEST(MotionDetector, resets_the_background_while_the_camera_moves) {
+  tpxai::MotionDetector detector(ShortWarmup());
+  const cv::Size size(1280, 720);
+  WarmUp(detector, MakeFrame(size));
+  auto moving = MakeFrame(size, cv::Rect(800, 200, 160, 120));
+  moving.camera_moving = true;
+  EXPECT_FALSE(detector.Process(moving));
+  // the warmup starts over
+  EXPECT_FALSE(detector.Process(MakeFrame(size)));
+  EXPECT_FALSE(detector.Process(MakeFrame(size, cv::Rect(800, 200, 160, 120))));
+}
+
+TEST(MotionDetector, resets_the_background_when_the_pose_changes) {
+  tpxai::MotionDetector detector(ShortWarmup());
+  const cv::Size size(1280, 720);
+  WarmUp(detector, MakeFrame(size));
+
+  // the camera has turned, the object is part of the new scene and must not be reported as motion
+  auto turned = MakeFrame(size, cv::Rect(800, 200, 160, 120));
+  turned.position.horizontal_angle = 15;
+  WarmUp(detector, turned);
+  EXPECT_FALSE(detector.Process(turned));
+  cv::rectangle(turned.image, cv::Rect(200, 400, 160, 120), cv::Scalar(230, 230, 230), cv::FILLED);
+  const auto detection = detector.Process(turned);
+  ASSERT_TRUE(detection);
+  EXPECT_NEAR(detection->centroid.x, 280, 16);
+
+  auto zoomed = turned;
+  zoomed.zoom_multiple = 4;
+  EXPECT_FALSE(detector.Process(zoomed));
+}
+
+TEST(MotionDetector, resets_the_background_when_the_frame_size_changes) {
+  tpxai::MotionDetector detector(ShortWarmup());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_FALSE(detector.Process(MakeFrame(cv::Size(1280, 720))));
+  }
+  // the stream tuner switched to another aspect ratio, the old background must not be compared with the new frames
+  const cv::Size size(1280, 960);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_FALSE(detector.Process(MakeFrame(size)));
+  }
+  const cv::Rect object(600, 400, 120, 120);
+  const auto detection = detector.Process(MakeFrame(size, object));
+  ASSERT_TRUE(detection);
+  EXPECT_NEAR(detection->centroid.x, 660, 16);
+  EXPECT_NEAR(detection->centroid.y, 460, 16);
+}
+
+TEST(MotionDetector, follows_a_slow_change_of_brightness) {
+  // a slow background, which an 8-bit average would leave stuck up to 50 gray levels behind the scene
+  auto settings = ShortWarmup();
+  settings.background_rate = 0.01;
+  tpxai::MotionDetector detector(settings);
+  const cv::Size size(320, 180);
+  // the scene brightens by one gray level every 8 frames, as at dawn, and the background is expected to keep up
+  auto frame = MakeFrame(size);
+  for (int i = 0; i < 400; i++) {
+    frame.image.setTo(cv::Scalar::all(60 + i / 8));
+    EXPECT_FALSE(detector.Process(frame)) << "frame " << i;
+  }
+  cv::rectangle(frame.image, cv::Rect(120, 60, 80, 60), cv::Scalar(230, 230, 230), cv::FILLED);
+  const auto detection = detector.Process(frame);
+  ASSERT_TRUE(detection);
+  EXPECT_NEAR(detection->centroid.x, 160, 8);
+  EXPECT_NEAR(detection->centroid.y, 90, 8);
+}
+
+} // anonymous namespace
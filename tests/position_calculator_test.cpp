@@ -95,4 +95,45 @@ TEST(PositionCalculator, troubles) {
   EXPECT_THAT(result[2], FloatNear(expected_xyz_euler_angles_in_degrees[2], very_big_eps));
 }
 
+const cv::Size dahua_frame_size{2592, 1520};
+
+TEST(PositionCalculator, whole_frame_region_keeps_position_and_zoom) {
+  const tpxai::PTZTarget result = tpxai::CalculateAbsolutePositionForRegion(
+      {0, 0, dahua_frame_size.width, dahua_frame_size.height}, dahua_intrinsics, dahua_frame_size, {0, 0, 0}, 1, 32);
+  EXPECT_THAT(result.euler_angles_in_degrees[0], FloatNear(0, very_big_eps));
+  EXPECT_THAT(result.euler_angles_in_degrees[1], FloatNear(0, very_big_eps));
+  EXPECT_EQ(result.zoom_multiple, 1);
+}
+
+TEST(PositionCalculator, centered_region_zooms_by_size_ratio) {
+  const cv::Rect quarter{dahua_frame_size.width * 3 / 8, dahua_frame_size.height * 3 / 8,
+                         dahua_frame_size.width / 4, dahua_frame_size.height / 4};
+  const tpxai::PTZTarget result =
+      tpxai::CalculateAbsolutePositionForRegion(quarter, dahua_intrinsics, dahua_frame_size, {0, 0, 0}, 1, 32);
+  EXPECT_THAT(result.euler_angles_in_degrees[0], FloatNear(0, very_big_eps));
+  EXPECT_THAT(result.euler_angles_in_degrees[1], FloatNear(0, very_big_eps));
+  EXPECT_EQ(result.zoom_multiple, 4);
+
+  const tpxai::PTZTarget zoomed =
+      tpxai::CalculateAbsolutePositionForRegion(quarter, dahua_intrinsics, dahua_frame_size, {0, 0, 0}, 2, 32);
+  EXPECT_EQ(zoomed.zoom_multiple, 8);
+}
+
+TEST(PositionCalculator, region_zoom_fits_the_longer_side) {
+  const cv::Rect wide{0, 700, dahua_frame_size.width / 2, 40};
+  const tpxai::PTZTarget result =
+      tpxai::CalculateAbsolutePositionForRegion(wide, dahua_intrinsics, dahua_frame_size, {0, 0, 0}, 1, 32);
+  EXPECT_EQ(result.zoom_multiple, 2);
+  const Eigen::Vector3f expected =
+      tpxai::CalculateAbsolutePosition({dahua_frame_size.width / 4, 720}, dahua_intrinsics.K, {0, 0, 0});
+  EXPECT_THAT(result.euler_angles_in_degrees[0], FloatNear(expected[0], 0.01));
+  EXPECT_THAT(result.euler_angles_in_degrees[1], FloatNear(expected[1], 0.01));
+}
+
+TEST(PositionCalculator, region_zoom_is_clamped_to_max) {
+  const tpxai::PTZTarget result =
+      tpxai::CalculateAbsolutePositionForRegion({1290, 740, 8, 8}, dahua_intrinsics, dahua_frame_size, {0, 0, 0}, 1, 20);
+  EXPECT_EQ(result.zoom_multiple, 20);
+}
+
 } // anonymous namespace
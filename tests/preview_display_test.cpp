@@ -0,0 +1,24 @@
+#include <gtest/gtest.h>
+
+#include "preview_display.h"
+
+namespace {
+
+TEST(Preview, maps_clicks_back_to_full_resolution) {
+  tpxai::Preview preview;
+  preview.image = cv::Mat(760, 1296, CV_8UC3);
+  preview.frame_size = cv::Size(2592, 1520);
+  EXPECT_EQ(preview.ToFrame(cv::Point(0, 0)), cv::Point(0, 0));
+  EXPECT_EQ(preview.ToFrame(cv::Point(648, 380)), cv::Point(1296, 760));
+  EXPECT_EQ(preview.ToFrame(cv::Point(1296, 760)), cv::Point(2592, 1520));
+  EXPECT_EQ(preview.ToFrame(cv::Rect(100, 50, 200, 100)), cv::Rect(200, 100, 400, 200));
+}
+
+TEST(Preview, at_full_resolution_maps_to_itself) {
+  tpxai::Preview preview;
+  preview.image = cv::Mat(1520, 2592, CV_8UC3);
+  preview.frame_size = cv::Size(2592, 1520);
+  EXPECT_EQ(preview.ToFrame(cv::Point(1234, 567)), cv::Point(1234, 567));
+}
+
+} // anonymous namespace
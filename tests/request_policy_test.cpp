@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+
+#include "closed_port.h"
+#include "curl_error_category.h"
+#include "dahua_error_category.h"
+#include "http_interface.h"
+#include "request_policy.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+tpxai::dahua::RequestTiming MakeTiming(std::chrono::microseconds total) {
+  tpxai::dahua::RequestTiming timing;
+  timing.first_byte = total / 2;
+  timing.total = total;
+  return timing;
+}
+
+TEST(LatencyWindow, percentile_uses_nearest_rank_over_the_latest_samples) {
+  tpxai::dahua::LatencyWindow window(4);
+  EXPECT_EQ(window.GetPercentile(0.99), 0us);
+  for (auto sample : {100us, 1us, 2us, 3us, 4us}) {
+    window.Add(sample);
+  }
+  EXPECT_EQ(window.GetSampleCount(), 4U);
+  EXPECT_EQ(window.GetPercentile(0.0), 1us);
+  EXPECT_EQ(window.GetPercentile(0.5), 2us);
+  EXPECT_EQ(window.GetPercentile(1.0), 4us);
+}
+
+TEST(LatencyTracker, uses_maximal_timeouts_until_enough_samples) {
+  tpxai::dahua::TimeoutSettings settings;
+  settings.min_samples = 4;
+  tpxai::dahua::LatencyTracker tracker(settings);
+  for (int i = 0; i < 3; i++) {
+    tracker.Record(MakeTiming(10ms));
+  }
+  EXPECT_EQ(tracker.GetTimeouts().total, settings.max_timeout);
+  EXPECT_EQ(tracker.GetTimeouts().connect, settings.max_timeout);
+}
+
+TEST(LatencyTracker, derives_timeout_from_high_percentile) {
+  tpxai::dahua::TimeoutSettings settings;
+  settings.min_samples = 4;
+  settings.multiplier = 3.0;
+  tpxai::dahua::LatencyTracker tracker(settings);
+  for (int i = 0; i < 99; i++) {
+    tracker.Record(MakeTiming(100ms));
+  }
+  tracker.Record(MakeTiming(400ms));
+  EXPECT_EQ(tracker.GetTimeouts().total, 300ms);
+  // reused connections report no connect time, so the connect timeout stays bounded by the total one
+  EXPECT_EQ(tracker.GetTimeouts().connect, 300ms);
+
+  tracker.Record(MakeTiming(1ms));
+  EXPECT_EQ(tracker.GetTimeouts().total, 300ms);
+}
+
+TEST(LatencyTracker, timeouts_are_clamped_and_widen_after_timeouts) {
+  tpxai::dahua::TimeoutSettings settings;
+  settings.min_samples = 4;
+  tpxai::dahua::LatencyTracker tracker(settings);
+  for (int i = 0; i < 4; i++) {
+    tracker.Record(MakeTiming(1ms));
+  }
+  EXPECT_EQ(tracker.GetTimeouts().total, settings.min_timeout);
+
+  tracker.RecordTimeout(settings.min_timeout);
+  EXPECT_EQ(tracker.GetTimeouts().total, 3 * settings.min_timeout);
+  tracker.RecordTimeout(3 * settings.min_timeout);
+  tracker.RecordTimeout(9 * settings.min_timeout);
+  EXPECT_EQ(tracker.GetTimeouts().total, settings.max_timeout);
+}
+
+TEST(BackoffDelay, stays_within_jittered_exponential_bounds) {
+  tpxai::dahua::RetrySettings settings;
+  settings.base_backoff = 50ms;
+  settings.max_backoff = 300ms;
+  std::minstd_rand rng(42);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_THAT(tpxai::dahua::BackoffDelay(settings, 0, rng).count(), AllOf(Ge(25), Le(50)));
+    EXPECT_THAT(tpxai::dahua::BackoffDelay(settings, 1, rng).count(), AllOf(Ge(50), Le(100)));
+    EXPECT_THAT(tpxai::dahua::BackoffDelay(settings, 10, rng).count(), AllOf(Ge(150), Le(300)));
+  }
+}
+
+TEST(CircuitBreaker, opens_after_consecutive_failures_and_closes_on_success) {
+  tpxai::dahua::CircuitBreakerSettings settings;
+  settings.failure_threshold = 3;
+  tpxai::dahua::CircuitBreaker breaker(settings);
+
+  EXPECT_FALSE(breaker.RecordFailure());
+  EXPECT_FALSE(breaker.RecordFailure());
+  EXPECT_FALSE(breaker.RecordSuccess());
+  EXPECT_FALSE(breaker.RecordFailure());
+  EXPECT_FALSE(breaker.RecordFailure());
+  EXPECT_TRUE(breaker.AllowRequest());
+
+  EXPECT_TRUE(breaker.RecordFailure());
+  EXPECT_FALSE(breaker.AllowRequest());
+  EXPECT_FALSE(breaker.RecordFailure());
+
+  EXPECT_TRUE(breaker.RecordSuccess());
+  EXPECT_TRUE(breaker.AllowRequest());
+  EXPECT_EQ(breaker.GetConsecutiveFailures(), 0U);
+}
+
+TEST(CircuitBreaker, probe_delay_doubles_up_to_the_maximum) {
+  tpxai::dahua::CircuitBreakerSettings settings;
+  settings.probe_interval = 500ms;
+  settings.max_probe_interval = 3000ms;
+  tpxai::dahua::CircuitBreaker breaker(settings);
+  EXPECT_EQ(breaker.GetProbeDelay(0), 500ms);
+  EXPECT_EQ(breaker.GetProbeDelay(1), 1000ms);
+  EXPECT_EQ(breaker.GetProbeDelay(2), 2000ms);
+  EXPECT_EQ(breaker.GetProbeDelay(3), 3000ms);
+  EXPECT_EQ(breaker.GetProbeDelay(100), 3000ms);
+}
+
+TEST(IsTransientFailure, distinguishes_transport_from_request_errors) {
+  EXPECT_TRUE(tpxai::dahua::IsTransientFailure(CURLE_OPERATION_TIMEDOUT));
+  EXPECT_TRUE(tpxai::dahua::IsTransientFailure(CURLE_COULDNT_CONNECT));
+  EXPECT_FALSE(tpxai::dahua::IsTransientFailure(CURLE_LOGIN_DENIED));
+  EXPECT_FALSE(tpxai::dahua::IsTransientFailure(CURLE_URL_MALFORMAT));
+}
+
+TEST(IsConnectFailure, tells_an_unreachable_camera_from_a_slow_transfer) {
+  EXPECT_TRUE(tpxai::dahua::IsConnectFailure(CURLE_COULDNT_CONNECT, false));
+  EXPECT_TRUE(tpxai::dahua::IsConnectFailure(CURLE_COULDNT_RESOLVE_HOST, false));
+  EXPECT_TRUE(tpxai::dahua::IsConnectFailure(CURLE_OPERATION_TIMEDOUT, false));
+  EXPECT_FALSE(tpxai::dahua::IsConnectFailure(CURLE_OPERATION_TIMEDOUT, true));
+  EXPECT_FALSE(tpxai::dahua::IsConnectFailure(CURLE_RECV_ERROR, true));
+}
+
+TEST(HTTPInterface, refused_snapshots_open_the_circuit) {
+  tpxai::dahua::HTTPInterface http_iface("admin", "admin", "127.0.0.1", GetClosedPort());
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(http_iface.GetSnapshot().first, tpxai::dahua::make_error_code(CURLE_COULDNT_CONNECT));
+  }
+  EXPECT_FALSE(http_iface.IsReachable());
+  EXPECT_EQ(http_iface.GetSnapshot().first, tpxai::dahua::make_error_code(tpxai::dahua::DahuaErrorCode::camera_unreachable));
+}
+
+} // anonymous namespace
@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <unistd.h>
+
+#include "dahua_error_category.h"
+#include "session_replay.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+const tpxai::CameraIntrinsics intrinsics{
+    cv::Matx33d{2338.9, 0., 1297.5, 0., 2338.5, 743.3, 0., 0., 1.}, {0.034, 0.206, -0.0007, -0.002}};
+
+class SessionLog : public Test {
+protected:
+  void SetUp() override {
+    path_ = "/tmp/session_log_test_" + std::to_string(getpid()) + ".bin";
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  tpxai::SharedFrame MakeFrame(std::uint64_t sequence) const {
+    auto frame = std::make_shared<tpxai::Frame>();
+    frame->image = cv::Mat(480, 800, CV_8UC3, cv::Scalar(40, 80, 120));
+    frame->sequence = sequence;
+    frame->capture_time = std::chrono::steady_clock::now();
+    frame->position = tpxai::PTZCameraPosition{10.5F, -3.25F};
+    frame->zoom_multiple = 2;
+    frame->camera_moving = sequence % 2;
+    return frame;
+  }
+
+  void RecordClicks(tpxai::session::SessionRecorder& recorder) const {
+    const cv::Size frame_size{2560, 1440};
+    const Eigen::Vector3f current{-3.25F, 10.5F, 0};
+    const cv::Point point{1800, 400};
+    recorder.RecordClick(cv::Rect(point, point), frame_size, intrinsics, tpxai::PTZCameraPosition{10.5F, -3.25F}, 1,
+                         32, {tpxai::CalculateAbsolutePosition(point, intrinsics.K, current), 1});
+    const cv::Rect region{1200, 600, 200, 120};
+    recorder.RecordClick(region, frame_size, intrinsics, tpxai::PTZCameraPosition{10.5F, -3.25F}, 1, 32,
+                         tpxai::CalculateAbsolutePositionForRegion(region, intrinsics, frame_size, current, 1, 32));
+    // the tuner lowered the stream resolution, the click is calculated with the scaled intrinsics
+    const auto scaled = intrinsics.ForResolution(cv::Size(2592, 1520), cv::Size(1280, 720));
+    const cv::Point scaled_point{900, 200};
+    recorder.RecordClick(cv::Rect(scaled_point, scaled_point), cv::Size(1280, 720), scaled,
+                         tpxai::PTZCameraPosition{10.5F, -3.25F}, 1, 32,
+                         {tpxai::CalculateAbsolutePosition(scaled_point, scaled.K, current), 1});
+  }
+
+  std::string path_;
+};
+
+TEST_F(SessionLog, reads_back_what_was_recorded) {
+  {
+    tpxai::session::SessionRecorderSettings settings;
+    settings.record_images = true;
+    tpxai::session::SessionRecorder recorder(path_, settings);
+    recorder.RecordIntrinsics(intrinsics);
+    recorder.RecordFrame(*MakeFrame(5));
+    recorder.RecordPose(tpxai::PTZCameraPosition{20.F, 1.5F}, 4);
+    const std::string url = "http://camera/cgi-bin/ptz.cgi?action=getStatus";
+    const std::string response = "status.Postion[0]=20.0";
+    recorder.RecordHTTP({"getStatus", url, std::chrono::steady_clock::now(), 12ms, {}, {}, response});
+    recorder.RecordHTTP({"start", url, std::chrono::steady_clock::now(), 3ms, {},
+                         tpxai::dahua::make_error_code(tpxai::dahua::DahuaErrorCode::camera_unreachable), {}});
+    EXPECT_GT(recorder.GetWrittenBytes(), sizeof(tpxai::session::FileHeader));
+  }
+
+  const tpxai::session::SessionLog log(path_);
+  const auto& records = log.GetRecords();
+  ASSERT_EQ(records.size(), 5U);
+
+  ASSERT_EQ(records[0].type, tpxai::session::RecordType::intrinsics);
+  const auto read_intrinsics = tpxai::session::ToIntrinsics(records[0].As<tpxai::session::IntrinsicsRecord>());
+  EXPECT_THAT(read_intrinsics.K.val, ElementsAreArray(intrinsics.K.val));
+  EXPECT_EQ(read_intrinsics.distortion_coeffs, intrinsics.distortion_coeffs);
+
+  ASSERT_EQ(records[1].type, tpxai::session::RecordType::frame);
+  const auto& frame = records[1].As<tpxai::session::FrameRecord>();
+  EXPECT_EQ(frame.sequence, 5U);
+  EXPECT_EQ(frame.zoom_multiple, 2);
+  EXPECT_EQ(frame.camera_moving, 1);
+  EXPECT_EQ(frame.width, 800);
+  EXPECT_EQ(frame.encoding, tpxai::session::ImageEncoding::jpeg);
+  const cv::Mat encoded(1, static_cast<int>(frame.image_size), CV_8UC1,
+                        const_cast<unsigned char*>(records[1].Tail<tpxai::session::FrameRecord>()));
+  EXPECT_EQ(cv::imdecode(encoded, cv::IMREAD_COLOR).size(), cv::Size(640, 384));
+
+  ASSERT_EQ(records[2].type, tpxai::session::RecordType::pose);
+  EXPECT_EQ(records[2].As<tpxai::session::PoseRecord>().zoom_multiple, 4);
+
+  ASSERT_EQ(records[3].type, tpxai::session::RecordType::http);
+  const auto& http = records[3].As<tpxai::session::HTTPRecord>();
+  EXPECT_EQ(http.duration_ns, 12'000'000);
+  EXPECT_EQ(http.error_category, tpxai::session::ErrorCategory::none);
+  const auto tail = reinterpret_cast<const char*>(records[3].Tail<tpxai::session::HTTPRecord>());
+  EXPECT_EQ(std::string(tail, http.code_size), "getStatus");
+  EXPECT_EQ(std::string(tail + http.code_size + http.url_size, http.response_size), "status.Postion[0]=20.0");
+  EXPECT_EQ(records[4].As<tpxai::session::HTTPRecord>().error_category, tpxai::session::ErrorCategory::dahua);
+}
+
+TEST_F(SessionLog, binary_responses_are_left_out) {
+  const std::string url = "http://camera/cgi-bin/snapshot.cgi?channel=1";
+  const std::string jpeg(300'000, '\xFF');
+  {
+    tpxai::session::SessionRecorder recorder(path_);
+    recorder.RecordHTTP({"snapshot", url, std::chrono::steady_clock::now(), 80ms, {}, {}, jpeg, true});
+    EXPECT_LT(recorder.GetWrittenBytes(), 1024U);
+  }
+
+  const tpxai::session::SessionLog log(path_);
+  ASSERT_EQ(log.GetRecords().size(), 1U);
+  const auto& http = log.GetRecords()[0].As<tpxai::session::HTTPRecord>();
+  EXPECT_EQ(http.response_omitted, 1);
+  EXPECT_EQ(http.response_size, jpeg.size());
+  EXPECT_EQ(log.GetRecords()[0].size, sizeof(http) + http.code_size + http.url_size);
+}
+
+TEST_F(SessionLog, log_cut_short_is_read_up_to_the_last_complete_record) {
+  {
+    tpxai::session::SessionRecorder recorder(path_);
+    recorder.RecordPose(tpxai::PTZCameraPosition{1.F, 2.F}, 1);
+    recorder.RecordPose(tpxai::PTZCameraPosition{3.F, 4.F}, 1);
+  }
+  std::ifstream input(path_, std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+  std::ofstream(path_, std::ios::binary | std::ios::trunc).write(data.data(), data.size() - 4);
+
+  const tpxai::session::SessionLog log(path_);
+  ASSERT_EQ(log.GetRecords().size(), 1U);
+  EXPECT_EQ(log.GetRecords()[0].As<tpxai::session::PoseRecord>().horizontal_angle, 1.F);
+}
+
+TEST_F(SessionLog, rejects_other_files) {
+  std::ofstream(path_) << "certainly not a session log";
+  EXPECT_THROW(tpxai::session::SessionLog{path_}, std::runtime_error);
+}
+
+TEST_F(SessionLog, rejects_records_whose_data_exceeds_their_size) {
+  {
+    tpxai::session::SessionRecorder recorder(path_);
+    const std::string url = "http://camera/cgi-bin/ptz.cgi?action=getStatus";
+    recorder.RecordHTTP({"getStatus", url, std::chrono::steady_clock::now(), 12ms, {}, {}, "OK"});
+    recorder.RecordFrame(*MakeFrame(1));
+  }
+  std::ifstream input(path_, std::ios::binary);
+  const std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+  const auto http_offset = sizeof(tpxai::session::FileHeader) + sizeof(tpxai::session::RecordHeader);
+  const auto http_size = reinterpret_cast<const tpxai::session::RecordHeader*>(
+                             data.data() + sizeof(tpxai::session::FileHeader))->size;
+  const auto frame_offset = http_offset + (http_size + 7) / 8 * 8 + sizeof(tpxai::session::RecordHeader);
+
+  const auto corrupt = [this, &data](std::size_t offset, std::uint32_t value) {
+    auto corrupted = data;
+    std::memcpy(corrupted.data() + offset, &value, sizeof(value));
+    std::ofstream(path_, std::ios::binary | std::ios::trunc).write(corrupted.data(), corrupted.size());
+  };
+  corrupt(http_offset + offsetof(tpxai::session::HTTPRecord, url_size), 1 << 20);
+  EXPECT_THROW(tpxai::session::SessionLog{path_}, std::runtime_error);
+  corrupt(http_offset + offsetof(tpxai::session::HTTPRecord, response_size), 3);
+  EXPECT_THROW(tpxai::session::SessionLog{path_}, std::runtime_error);
+  corrupt(frame_offset + offsetof(tpxai::session::FrameRecord, image_size), 1);
+  EXPECT_THROW(tpxai::session::SessionLog{path_}, std::runtime_error);
+  corrupt(frame_offset + offsetof(tpxai::session::FrameRecord, image_size), 0);
+  EXPECT_EQ(tpxai::session::SessionLog{path_}.GetRecords().size(), 2U);
+}
+
+TEST_F(SessionLog, write_failure_stops_the_recording) {
+  tpxai::session::SessionRecorder recorder("/dev/full");
+  const std::string url = "http://camera/cgi-bin/ptz.cgi?action=getStatus";
+  const std::string response(64 * 1024, 'x');
+  // enough to overflow the stdio buffer, whose flush fails
+  for (int i = 0; i < 40; i++) {
+    recorder.RecordHTTP({"getStatus", url, std::chrono::steady_clock::now(), 12ms, {}, {}, response});
+  }
+  EXPECT_TRUE(recorder.HasFailed());
+  const auto written_bytes = recorder.GetWrittenBytes();
+  EXPECT_LT(written_bytes, 40 * response.size());
+  recorder.RecordPose(tpxai::PTZCameraPosition{1.F, 2.F}, 1);
+  EXPECT_EQ(recorder.GetWrittenBytes(), written_bytes);
+}
+
+TEST_F(SessionLog, fast_replay_publishes_frames_and_reproduces_click_targets) {
+  {
+    tpxai::session::SessionRecorder recorder(path_);
+    recorder.RecordIntrinsics(intrinsics);
+    for (std::uint64_t i = 0; i < 20; i++) {
+      recorder.RecordFrame(*MakeFrame(i));
+    }
+    RecordClicks(recorder);
+    const std::string url = "http://camera/cgi-bin/ptz.cgi?action=start";
+    recorder.RecordHTTP({"PositionABS", url, std::chrono::steady_clock::now(), 40ms, {}, {}, "OK"});
+  }
+
+  const tpxai::session::SessionLog log(path_);
+  tpxai::FrameBus bus;
+  auto frames = bus.Subscribe(32, tpxai::BackpressurePolicy::block);
+  tpxai::session::ReplayStats stats;
+  tpxai::session::SessionReplay(log, bus, tpxai::session::ReplaySpeed::fastest).Run(stats);
+
+  EXPECT_EQ(stats.frames, 20U);
+  EXPECT_EQ(stats.clicks, 3U);
+  EXPECT_EQ(stats.click_mismatches, 0U);
+  EXPECT_EQ(stats.http_requests, 1U);
+  EXPECT_EQ(stats.calculation_duration.GetSnapshot().count, 3U);
+  EXPECT_EQ(stats.http_duration.at("PositionABS").GetSnapshot().count, 1U);
+  for (std::uint64_t i = 0; i < 20; i++) {
+    const auto frame = frames->Pop();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->sequence, i);
+    EXPECT_EQ(frame->image.size(), cv::Size(800, 480));
+    EXPECT_EQ(frame->zoom_multiple, 2);
+    EXPECT_FLOAT_EQ(frame->position.vertical_angle, -3.25F);
+  }
+}
+
+} // anonymous namespace
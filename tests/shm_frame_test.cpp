@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm_frame_exporter.h"
+#include "shm_frame_reader.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string SegmentName(const std::string& test) { return "/goto_point_test_" + test + "_" + std::to_string(getpid()); }
+
+// every pixel holds the low byte of the sequence
+tpxai::Frame MakeFrame(std::uint64_t sequence, cv::Size size = cv::Size(64, 48)) {
+  tpxai::Frame frame;
+  const auto value = static_cast<double>(sequence & 0xFF);
+  frame.image = cv::Mat(size, CV_8UC3, cv::Scalar(value, value, value));
+  frame.sequence = sequence;
+  frame.position.horizontal_angle = 12.5f;
+  frame.position.vertical_angle = -3.25f;
+  frame.zoom_multiple = 4;
+  frame.camera_moving = true;
+  return frame;
+}
+
+TEST(ShmFrameRing, frames_round_trip_through_the_segment) {
+  const auto name = SegmentName("round_trip");
+  tpxai::ShmFrameExporter exporter(name, 3, 64 * 48 * 3);
+  tpxai::ShmFrameReader reader(name);
+  tpxai::ShmFrame read;
+  EXPECT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::no_new_frame);
+
+  const auto frame = MakeFrame(7);
+  exporter.Export(frame);
+  ASSERT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::ok);
+  EXPECT_EQ(read.sequence, 7U);
+  EXPECT_FLOAT_EQ(read.horizontal_angle, 12.5f);
+  EXPECT_FLOAT_EQ(read.vertical_angle, -3.25f);
+  EXPECT_EQ(read.zoom_multiple, 4);
+  EXPECT_TRUE(read.camera_moving);
+  EXPECT_EQ(read.width, 64);
+  EXPECT_EQ(read.height, 48);
+  EXPECT_EQ(read.type, CV_8UC3);
+  EXPECT_EQ(read.step, 64U * 3);
+  ASSERT_EQ(read.pixels.size(), 64U * 48 * 3);
+  EXPECT_THAT(read.pixels, Each(7));
+  EXPECT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::no_new_frame);
+
+  // the reader only returns the newest frame and counts the ones it missed
+  for (std::uint64_t sequence = 8; sequence < 12; sequence++) {
+    exporter.Export(MakeFrame(sequence));
+  }
+  ASSERT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::ok);
+  EXPECT_EQ(read.sequence, 11U);
+  EXPECT_EQ(reader.GetMissedFrames(), 3U);
+
+  exporter.Export(MakeFrame(12, cv::Size(128, 96)));
+  EXPECT_EQ(exporter.GetSkippedFrames(), 1U);
+  EXPECT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::no_new_frame);
+}
+
+TEST(ShmFrameRing, replaces_a_segment_left_behind) {
+  const auto name = SegmentName("stale");
+  const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0660);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 4096), 0);
+  close(fd);
+  EXPECT_THROW(tpxai::ShmFrameReader{name}, std::runtime_error);
+
+  tpxai::ShmFrameExporter exporter(name, 2, 64 * 48 * 3);
+  tpxai::ShmFrameReader reader(name);
+  exporter.Export(MakeFrame(1));
+  tpxai::ShmFrame read;
+  EXPECT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::ok);
+}
+
+TEST(ShmFrameRing, rejects_a_corrupted_header) {
+  const auto name = SegmentName("corrupted");
+  const std::size_t max_image_bytes = 64 * 48 * 3;
+  tpxai::ShmFrameExporter exporter(name, 2, max_image_bytes);
+
+  const auto segment_size = tpxai::shm::SegmentSize(2, max_image_bytes);
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  void* segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  ASSERT_NE(segment, MAP_FAILED);
+  auto header = static_cast<tpxai::shm::RingHeader*>(segment);
+  const auto valid = std::make_tuple(header->slot_count, header->slot_size, header->max_image_bytes);
+  const auto corrupt = [&](std::uint32_t slot_count, std::uint64_t slot_size, std::uint64_t image_bytes) {
+    header->slot_count = slot_count;
+    header->slot_size = slot_size;
+    header->max_image_bytes = image_bytes;
+  };
+
+  corrupt(0, std::get<1>(valid), std::get<2>(valid));
+  EXPECT_THROW(tpxai::ShmFrameReader{name}, std::runtime_error);
+  // slots too small for the images they claim to hold
+  corrupt(2, tpxai::shm::SlotSize(max_image_bytes / 4), max_image_bytes);
+  EXPECT_THROW(tpxai::ShmFrameReader{name}, std::runtime_error);
+  // sizes whose arithmetic wraps around to fit the segment
+  corrupt(2, std::uint64_t{1} << 63, max_image_bytes);
+  EXPECT_THROW(tpxai::ShmFrameReader{name}, std::runtime_error);
+  corrupt(2, tpxai::shm::SlotSize(max_image_bytes), ~std::uint64_t{0});
+  EXPECT_THROW(tpxai::ShmFrameReader{name}, std::runtime_error);
+
+  corrupt(std::get<0>(valid), std::get<1>(valid), std::get<2>(valid));
+  EXPECT_NO_THROW(tpxai::ShmFrameReader{name});
+  munmap(segment, segment_size);
+}
+
+TEST(ShmFrameRing, discards_a_slot_being_written) {
+  const auto name = SegmentName("torn");
+  const std::size_t max_image_bytes = 64 * 48 * 3;
+  tpxai::ShmFrameExporter exporter(name, 2, max_image_bytes);
+  tpxai::ShmFrameReader reader(name);
+  exporter.Export(MakeFrame(1));
+
+  // map the segment a second time to leave the newest slot as a writer interrupted in the middle of a copy would
+  const auto segment_size = tpxai::shm::SegmentSize(2, max_image_bytes);
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  void* segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  ASSERT_NE(segment, MAP_FAILED);
+  auto slot = reinterpret_cast<tpxai::shm::SlotHeader*>(static_cast<char*>(segment) + tpxai::shm::RingHeaderSize());
+  slot->generation.fetch_add(1);
+
+  tpxai::ShmFrame read;
+  EXPECT_EQ(reader.ReadLatest(read, 3), tpxai::ShmFrameReader::Status::torn);
+  EXPECT_EQ(reader.GetTornReads(), 3U);
+
+  slot->generation.fetch_add(1);
+  EXPECT_EQ(reader.ReadLatest(read), tpxai::ShmFrameReader::Status::ok);
+  EXPECT_EQ(read.sequence, 1U);
+  munmap(segment, segment_size);
+}
+
+TEST(ShmFrameRing, never_returns_a_torn_frame_while_the_writer_runs) {
+  const auto name = SegmentName("concurrent");
+  // two slots, so the writer keeps overwriting the slot being read
+  tpxai::ShmFrameExporter exporter(name, 2, 320 * 240 * 3);
+  tpxai::ShmFrameReader reader(name);
+  // the frames are prepared up front, so the writer does nothing but copy and overtakes the reader often
+  std::vector<tpxai::Frame> frames_to_write;
+  for (std::uint64_t sequence = 0; sequence < 8; sequence++) {
+    frames_to_write.push_back(MakeFrame(sequence, cv::Size(320, 240)));
+  }
+  std::atomic<bool> stop{false};
+  std::thread writer([&] {
+    for (std::uint64_t sequence = 1; not stop; sequence++) {
+      auto& frame = frames_to_write[sequence % frames_to_write.size()];
+      frame.sequence = sequence;
+      exporter.Export(frame);
+    }
+  });
+
+  int frames = 0;
+  std::optional<std::uint64_t> torn_frame;
+  tpxai::ShmFrame read;
+  for (auto deadline = std::chrono::steady_clock::now() + 2s;
+       not torn_frame and frames < 500 and std::chrono::steady_clock::now() < deadline;) {
+    if (reader.ReadLatest(read) != tpxai::ShmFrameReader::Status::ok) {
+      continue;
+    }
+    frames++;
+    const auto expected = static_cast<std::uint8_t>(read.sequence % frames_to_write.size());
+    if (read.pixels.size() != 320U * 240 * 3 or
+        std::any_of(read.pixels.begin(), read.pixels.end(), [&](std::uint8_t pixel) { return pixel != expected; })) {
+      torn_frame = read.sequence;
+    }
+  }
+  // stopped before checking, a failed assertion must not leave the writer running
+  stop = true;
+  writer.join();
+  EXPECT_FALSE(torn_frame) << "frame " << *torn_frame;
+  EXPECT_GT(frames, 0);
+}
+
+} // anonymous namespace
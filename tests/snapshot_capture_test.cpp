@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "jpeg_decoder.h"
+#include "snapshot_capture.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+// the markers up to the frame header of a baseline JPEG, the image data is not needed to read its size
+std::string JPEGHeader(int width, int height) {
+  std::string header = {'\xFF', '\xD8'};
+  // JFIF application segment
+  header += {'\xFF', '\xE0', 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+  // a fill byte and a quantization table segment
+  header += {'\xFF', '\xFF', '\xDB', 0, 4, 0, 0};
+  header += {'\xFF', '\xC0', 0, 17, 8, static_cast<char>(height >> 8), static_cast<char>(height & 0xFF),
+             static_cast<char>(width >> 8), static_cast<char>(width & 0xFF), 3};
+  header += std::string(9, '\x11');
+  header += {'\xFF', '\xDA'};
+  return header;
+}
+
+TEST(JPEGDecoder, reads_the_size_from_the_frame_header) {
+  const auto size = tpxai::ReadJPEGSize(JPEGHeader(2592, 1520));
+  ASSERT_TRUE(size);
+  EXPECT_EQ(size->width, 2592);
+  EXPECT_EQ(size->height, 1520);
+}
+
+TEST(JPEGDecoder, rejects_other_data) {
+  EXPECT_FALSE(tpxai::ReadJPEGSize(""));
+  EXPECT_FALSE(tpxai::ReadJPEGSize("Error: no permission"));
+  const auto header = JPEGHeader(640, 480);
+  EXPECT_FALSE(tpxai::ReadJPEGSize(header.substr(0, header.find('\xC0') + 4)));
+  // the scan starts without a frame header
+  EXPECT_FALSE(tpxai::ReadJPEGSize(std::string{'\xFF', '\xD8', '\xFF', '\xDA', 0, 2}));
+}
+
+TEST(JPEGDecoder, chooses_the_smallest_scale_wide_enough) {
+  const cv::Size size(2592, 1520);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 0), 1);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 3000), 1);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 1297), 1);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 1296), 2);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 1280), 2);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 640), 4);
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(size, 1), 8);
+  // rounded up like libjpeg does
+  EXPECT_EQ(tpxai::ChooseJPEGReduction(cv::Size(641, 480), 321), 2);
+}
+
+TEST(SnapshotScheduler, limits_the_concurrent_tasks) {
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  std::atomic<int> runs{0};
+  {
+    tpxai::SnapshotScheduler scheduler(2);
+    for (int i = 0; i < 8; ++i) {
+      scheduler.Add(1h, [&] {
+        const int now_running = ++running;
+        int expected = max_running;
+        while (now_running > expected and not max_running.compare_exchange_weak(expected, now_running)) {
+        }
+        std::this_thread::sleep_for(20ms);
+        --running;
+        ++runs;
+      });
+    }
+    for (auto deadline = std::chrono::steady_clock::now() + 5s;
+         runs < 8 and std::chrono::steady_clock::now() < deadline;) {
+      std::this_thread::sleep_for(5ms);
+    }
+  }
+  EXPECT_EQ(runs, 8);
+  EXPECT_EQ(max_running, 2);
+}
+
+TEST(SnapshotScheduler, repeats_a_task_every_interval_without_overlapping_runs) {
+  std::atomic<int> running{0};
+  std::atomic<bool> overlapped{false};
+  std::atomic<int> runs{0};
+  tpxai::SnapshotScheduler scheduler(4);
+  const auto id = scheduler.Add(10ms, [&] {
+    if (++running > 1) {
+      overlapped = true;
+    }
+    // longer than the interval, the next run waits for this one
+    std::this_thread::sleep_for(15ms);
+    --running;
+    ++runs;
+  });
+  std::this_thread::sleep_for(200ms);
+  scheduler.Remove(id);
+  EXPECT_FALSE(overlapped);
+  EXPECT_THAT(runs.load(), AllOf(Ge(3), Le(14)));
+}
+
+TEST(SnapshotScheduler, remove_waits_for_the_run_in_flight) {
+  std::atomic<bool> started{false};
+  std::atomic<bool> finished{false};
+  std::atomic<int> runs{0};
+  tpxai::SnapshotScheduler scheduler(1);
+  const auto id = scheduler.Add(1ms, [&] {
+    ++runs;
+    started = true;
+    std::this_thread::sleep_for(50ms);
+    finished = true;
+  });
+  while (not started) {
+    std::this_thread::sleep_for(1ms);
+  }
+  scheduler.Remove(id);
+  EXPECT_TRUE(finished);
+  const int runs_at_removal = runs;
+  std::this_thread::sleep_for(20ms);
+  EXPECT_EQ(runs, runs_at_removal);
+  // removing twice is harmless
+  scheduler.Remove(id);
+}
+
+TEST(SnapshotScheduler, runs_an_earlier_task_while_waiting_for_a_later_one) {
+  std::atomic<bool> ran{false};
+  tpxai::SnapshotScheduler scheduler(1);
+  const auto slow = scheduler.Add(1h, [] {});
+  // the first run of the slow task is immediate, afterwards the worker waits an hour for it
+  std::this_thread::sleep_for(20ms);
+  scheduler.Add(1h, [&] { ran = true; });
+  for (auto deadline = std::chrono::steady_clock::now() + 1s;
+       not ran and std::chrono::steady_clock::now() < deadline;) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_TRUE(ran);
+  scheduler.Remove(slow);
+}
+
+} // anonymous namespace
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "stream_tuner.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+TEST(StreamTuner, cost_includes_a_pixel_share_of_the_rest_of_the_process) {
+  // two cameras decoding 100 and 300 megapixels, 1 s and 3 s on their capture threads, 4 s elsewhere in the process
+  const tpxai::StreamLoad first{100, 100'000'000, 1s};
+  const tpxai::StreamLoad all{400, 400'000'000, 4s};
+  EXPECT_DOUBLE_EQ(tpxai::EstimateCPUCostPerMegapixel(first, all, 8s), (1.0 + 4.0 * 0.25) / 100);
+  // the capture threads cannot have used more than the whole process
+  EXPECT_DOUBLE_EQ(tpxai::EstimateCPUCostPerMegapixel(first, all, 2s), 1.0 / 100);
+  EXPECT_EQ(tpxai::EstimateCPUCostPerMegapixel({}, {}, 1s), 0);
+}
+
+TEST(StreamTuner, keeps_the_largest_resolution_while_its_frame_rate_fits) {
+  const tpxai::StreamTunerSettings settings;
+  // 2592x1520 is 3.94 MP, at 0.01 CPU s/MP one core affords 25.4 frames per second
+  const auto config = tpxai::ChooseStreamConfig(0.01, 1.0, settings);
+  EXPECT_EQ(config.resolution, cv::Size(2592, 1520));
+  EXPECT_EQ(config.frame_rate, 25);
+  EXPECT_EQ(config.gop, 50);
+
+  const auto reduced = tpxai::ChooseStreamConfig(0.01, 0.5, settings);
+  EXPECT_EQ(reduced.resolution, cv::Size(2592, 1520));
+  EXPECT_EQ(reduced.frame_rate, 12);
+  EXPECT_EQ(reduced.gop, 24);
+}
+
+TEST(StreamTuner, lowers_the_resolution_below_the_minimal_frame_rate) {
+  const tpxai::StreamTunerSettings settings;
+  // 6.3 frames per second at 2592x1520, 12.0 at 1920x1080
+  const auto config = tpxai::ChooseStreamConfig(0.01, 0.25, settings);
+  EXPECT_EQ(config.resolution, cv::Size(1920, 1080));
+  EXPECT_EQ(config.frame_rate, 12);
+}
+
+TEST(StreamTuner, falls_back_to_the_smallest_stream) {
+  const tpxai::StreamTunerSettings settings;
+  const auto config = tpxai::ChooseStreamConfig(0.1, 0.1, settings);
+  EXPECT_EQ(config.resolution, cv::Size(1280, 720));
+  EXPECT_EQ(config.frame_rate, settings.min_frame_rate);
+}
+
+TEST(StreamTuner, unmeasured_cost_allows_the_largest_stream) {
+  const tpxai::StreamTunerSettings settings;
+  const auto config = tpxai::ChooseStreamConfig(0, 1.0, settings);
+  EXPECT_EQ(config.resolution, cv::Size(2592, 1520));
+  EXPECT_EQ(config.frame_rate, settings.max_frame_rate);
+}
+
+using StreamConfig = tpxai::dahua::StreamConfig;
+
+// A camera stream whose decode costs a given CPU time per megapixel
+class FakeStream {
+public:
+  FakeStream(StreamConfig config, double cpu_cost_per_megapixel)
+      : config_{config}, cpu_cost_per_megapixel_{cpu_cost_per_megapixel} {}
+
+  tpxai::StreamBudget::Stream GetStream() {
+    return {[this] { return load_; }, [this] { return config_; },
+            [this](const StreamConfig& config) {
+              config_ = config;
+              reconfigurations_++;
+            }};
+  }
+
+  // streams at the current configuration, returns the CPU time it took
+  std::chrono::nanoseconds Run(std::chrono::seconds duration) {
+    const std::uint64_t frames = config_.frame_rate * duration.count();
+    const std::uint64_t pixels = frames * config_.resolution.area();
+    const std::chrono::nanoseconds cpu_time{static_cast<std::int64_t>(cpu_cost_per_megapixel_ * pixels / 1e6 * 1e9)};
+    load_.frames += frames;
+    load_.pixels += pixels;
+    load_.cpu_time += cpu_time;
+    return cpu_time;
+  }
+
+  void SetCPUCostPerMegapixel(double cost) { cpu_cost_per_megapixel_ = cost; }
+  const StreamConfig& GetConfig() const { return config_; }
+  int GetReconfigurations() const { return reconfigurations_; }
+
+private:
+  StreamConfig config_;
+  double cpu_cost_per_megapixel_;
+  tpxai::StreamLoad load_;
+  int reconfigurations_ = 0;
+};
+
+// Drives the streams through measurement windows like the tuner thread, on one core of a process doing nothing but
+// decoding.
+class SimulatedTuner {
+public:
+  explicit SimulatedTuner(const tpxai::StreamTunerSettings& settings) : settings_{settings}, budget_{settings, 1} {}
+
+  tpxai::StreamBudget::StreamId Add(FakeStream& stream) {
+    const auto id = budget_.Add(stream.GetStream());
+    streams_.push_back(&stream);
+    budget_.StartWindow(process_cpu_time_);
+    return id;
+  }
+
+  void Remove(tpxai::StreamBudget::StreamId id, FakeStream& stream) {
+    budget_.Remove(id);
+    streams_.erase(std::find(streams_.begin(), streams_.end(), &stream));
+    budget_.StartWindow(process_cpu_time_);
+  }
+
+  void RunWindow() {
+    for (auto stream : streams_) {
+      process_cpu_time_ += stream->Run(settings_.interval);
+    }
+    now_ += settings_.interval;
+    budget_.Tune(process_cpu_time_, now_);
+    budget_.StartWindow(process_cpu_time_);
+  }
+
+private:
+  const tpxai::StreamTunerSettings settings_;
+  tpxai::StreamBudget budget_;
+  std::vector<FakeStream*> streams_;
+  std::chrono::nanoseconds process_cpu_time_{0};
+  std::chrono::steady_clock::time_point now_;
+};
+
+tpxai::StreamTunerSettings HalfACore() {
+  tpxai::StreamTunerSettings settings;
+  settings.cpu_budget = 0.5;
+  settings.interval = 10s;
+  settings.settle_time = 30s;
+  return settings;
+}
+
+TEST(StreamBudget, reconfigures_only_beyond_the_hysteresis) {
+  // at 0.01 CPU s/MP half a core affords 2592x1520 at 12 frames per second
+  FakeStream close(StreamConfig{{2592, 1520}, 11, 22}, 0.01);
+  FakeStream far(StreamConfig{{2592, 1520}, 9, 18}, 0.01);
+  SimulatedTuner close_tuner(HalfACore());
+  close_tuner.Add(close);
+  SimulatedTuner far_tuner(HalfACore());
+  far_tuner.Add(far);
+  close_tuner.RunWindow();
+  far_tuner.RunWindow();
+
+  // a 9% higher pixel rate is not worth restarting the stream, a 33% higher one is
+  EXPECT_EQ(close.GetReconfigurations(), 0);
+  EXPECT_EQ(close.GetConfig().frame_rate, 11);
+  EXPECT_EQ(far.GetReconfigurations(), 1);
+  EXPECT_EQ(far.GetConfig().resolution, cv::Size(2592, 1520));
+  EXPECT_EQ(far.GetConfig().frame_rate, 12);
+  EXPECT_EQ(far.GetConfig().gop, 24);
+
+  // a stream over its budget is reconfigured however small the change
+  FakeStream over(StreamConfig{{2592, 1520}, 13, 26}, 0.01);
+  SimulatedTuner over_tuner(HalfACore());
+  over_tuner.Add(over);
+  over_tuner.RunWindow();
+  EXPECT_EQ(over.GetReconfigurations(), 1);
+  EXPECT_EQ(over.GetConfig().frame_rate, 12);
+}
+
+TEST(StreamBudget, leaves_a_reconfigured_stream_alone_for_the_settle_time) {
+  FakeStream stream(StreamConfig{{1280, 720}, 8, 16}, 0.01);
+  SimulatedTuner tuner(HalfACore());
+  tuner.Add(stream);
+  tuner.RunWindow();
+  ASSERT_EQ(stream.GetReconfigurations(), 1);
+  EXPECT_EQ(stream.GetConfig().resolution, cv::Size(2592, 1520));
+
+  // the scene got busier, the new stream is now well over budget
+  stream.SetCPUCostPerMegapixel(0.02);
+  tuner.RunWindow();
+  tuner.RunWindow();
+  EXPECT_EQ(stream.GetReconfigurations(), 1);
+  // 30 s after the change
+  tuner.RunWindow();
+  EXPECT_EQ(stream.GetReconfigurations(), 2);
+  EXPECT_EQ(stream.GetConfig().resolution, cv::Size(1920, 1080));
+  EXPECT_EQ(stream.GetConfig().frame_rate, 12);
+}
+
+TEST(StreamBudget, splits_the_budget_between_the_streams) {
+  FakeStream first(StreamConfig{{2592, 1520}, 12, 24}, 0.01);
+  SimulatedTuner tuner(HalfACore());
+  tuner.Add(first);
+  tuner.RunWindow();
+  EXPECT_EQ(first.GetReconfigurations(), 0);
+
+  // a quarter of a core each, 2592x1520 would only run at 6 frames per second
+  FakeStream second(StreamConfig{{2592, 1520}, 12, 24}, 0.01);
+  const auto second_id = tuner.Add(second);
+  tuner.RunWindow();
+  for (const auto* stream : {&first, &second}) {
+    EXPECT_EQ(stream->GetReconfigurations(), 1);
+    EXPECT_EQ(stream->GetConfig().resolution, cv::Size(1920, 1080));
+    EXPECT_EQ(stream->GetConfig().frame_rate, 12);
+  }
+
+  // the first stream gets the whole budget back once it has settled
+  tuner.Remove(second_id, second);
+  tuner.RunWindow();
+  tuner.RunWindow();
+  EXPECT_EQ(first.GetReconfigurations(), 1);
+  tuner.RunWindow();
+  EXPECT_EQ(first.GetReconfigurations(), 2);
+  EXPECT_EQ(first.GetConfig().resolution, cv::Size(2592, 1520));
+  EXPECT_EQ(first.GetConfig().frame_rate, 12);
+  EXPECT_EQ(second.GetReconfigurations(), 1);
+}
+
+TEST(StreamBudget, streams_without_frames_take_no_share) {
+  FakeStream streaming(StreamConfig{{2592, 1520}, 12, 24}, 0.01);
+  FakeStream not_open(StreamConfig{{2592, 1520}, 12, 24}, 0.01);
+  tpxai::StreamBudget budget(HalfACore(), 1);
+  budget.Add(streaming.GetStream());
+  budget.Add(not_open.GetStream());
+  budget.StartWindow(0s);
+  const auto cpu_time = streaming.Run(10s);
+  budget.Tune(cpu_time, std::chrono::steady_clock::time_point{} + 10s);
+  EXPECT_EQ(streaming.GetReconfigurations(), 0);
+  EXPECT_EQ(not_open.GetReconfigurations(), 0);
+}
+
+TEST(CameraIntrinsics, scale_with_the_stream_resolution) {
+  const tpxai::CameraIntrinsics calibration{cv::Matx33d{2000., 0., 1296., 0., 2000., 760., 0., 0., 1.}, {}};
+  const auto scaled = calibration.ForResolution({2592, 1520}, {1296, 760});
+  EXPECT_DOUBLE_EQ(scaled.K(0, 0), 1000.);
+  EXPECT_DOUBLE_EQ(scaled.K(1, 1), 1000.);
+  EXPECT_DOUBLE_EQ(scaled.K(0, 2), 648.);
+  EXPECT_DOUBLE_EQ(scaled.K(1, 2), 380.);
+}
+
+} // anonymous namespace
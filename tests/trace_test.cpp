@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+#include "trace.h"
+
+using namespace ::testing;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string WriteTrace() {
+  std::ostringstream output;
+  tpxai::trace::WriteChromeTrace(output);
+  return output.str();
+}
+
+class Trace : public Test {
+protected:
+  void TearDown() override { tpxai::trace::SetEnabled(false); }
+};
+
+TEST_F(Trace, records_nothing_while_disabled) {
+  tpxai::trace::SetEnabled(false);
+  { tpxai::trace::Span span("test", "disabled span"); }
+  EXPECT_THAT(WriteTrace(), Not(HasSubstr("disabled span")));
+}
+
+TEST_F(Trace, span_started_while_disabled_is_not_recorded) {
+  {
+    tpxai::trace::Span span("test", "half enabled span");
+    tpxai::trace::SetEnabled(true);
+  }
+  EXPECT_THAT(WriteTrace(), Not(HasSubstr("half enabled span")));
+}
+
+TEST_F(Trace, writes_complete_and_async_events_of_all_threads) {
+  tpxai::trace::SetEnabled(true);
+  std::thread worker([] {
+    tpxai::trace::SetThreadName("trace test worker");
+    tpxai::trace::Span span("test", "worker span");
+  });
+  worker.join();
+  const auto start = tpxai::trace::Clock::now();
+  tpxai::trace::RecordComplete("test", "main \"span\"", start, start + 1500us);
+  tpxai::trace::RecordAsync("test", "async span", 42, start, start + 2ms);
+
+  const auto trace = WriteTrace();
+  EXPECT_THAT(trace, StartsWith("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+  EXPECT_THAT(trace, EndsWith("]}\n"));
+  EXPECT_THAT(trace, HasSubstr("\"name\":\"thread_name\""));
+  EXPECT_THAT(trace, HasSubstr("\"args\":{\"name\":\"trace test worker\"}"));
+  EXPECT_THAT(trace, HasSubstr("\"ph\":\"X\",\"cat\":\"test\",\"name\":\"worker span\""));
+  EXPECT_THAT(trace, HasSubstr("\"name\":\"main \\\"span\\\"\""));
+  EXPECT_THAT(trace, HasSubstr(",\"dur\":1500.000}"));
+  EXPECT_THAT(trace, HasSubstr("\"ph\":\"b\",\"cat\":\"test\",\"name\":\"async span\""));
+  EXPECT_THAT(trace, HasSubstr("\"ph\":\"e\",\"cat\":\"test\",\"name\":\"async span\""));
+  EXPECT_THAT(trace, HasSubstr(",\"id\":42}"));
+}
+
+TEST_F(Trace, ring_keeps_the_newest_events) {
+  tpxai::trace::SetEnabled(true);
+  std::thread worker([] {
+    const auto start = tpxai::trace::Clock::now();
+    tpxai::trace::RecordComplete("test", "oldest ring event", start, start);
+    for (int i = 0; i < 20000; i++) {
+      tpxai::trace::RecordComplete("test", "ring event", start, start);
+    }
+    tpxai::trace::RecordComplete("test", "newest ring event", start, start);
+  });
+  worker.join();
+  const auto trace = WriteTrace();
+  EXPECT_THAT(trace, Not(HasSubstr("oldest ring event")));
+  EXPECT_THAT(trace, HasSubstr("newest ring event"));
+  EXPECT_GT(tpxai::trace::GetOverwrittenEvents(), 0U);
+}
+
+TEST_F(Trace, reuses_the_buffers_of_exited_threads_once_written) {
+  tpxai::trace::SetEnabled(true);
+  const auto record_on_new_thread = [](const char* name) {
+    std::thread worker([name] {
+      const auto start = tpxai::trace::Clock::now();
+      tpxai::trace::RecordComplete("test", name, start, start);
+    });
+    worker.join();
+  };
+  record_on_new_thread("first thread event");
+  const auto allocated = tpxai::trace::GetAllocatedThreadBuffers();
+  EXPECT_THAT(WriteTrace(), HasSubstr("first thread event"));
+
+  const char* names[] = {"second thread event", "third thread event", "fourth thread event"};
+  const char* previous = "first thread event";
+  for (const char* name : names) {
+    record_on_new_thread(name);
+    EXPECT_EQ(tpxai::trace::GetAllocatedThreadBuffers(), allocated);
+    // the events of exited threads are written once, a reused buffer holds only the events of its new thread
+    const auto trace = WriteTrace();
+    EXPECT_THAT(trace, HasSubstr(name));
+    EXPECT_THAT(trace, Not(HasSubstr(previous)));
+    previous = name;
+  }
+}
+
+} // anonymous namespace
@@ -0,0 +1,303 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+namespace tpxai::trace {
+
+namespace detail {
+std::atomic<bool> enabled{false};
+} // namespace detail
+
+namespace {
+
+constexpr std::size_t events_per_thread = 16384;
+
+struct Event {
+  const char* category;
+  const char* name;
+  std::int64_t timestamp_ns;
+  std::int64_t duration_ns;
+  std::uint64_t id;
+  char phase;
+};
+
+// Single writer ring, every slot is guarded by a sequence number like a seqlock: odd while the owning thread writes
+// it, so a concurrent reader can tell a consistent event from one being overwritten. The fields are relaxed atomics,
+// which compile to plain stores.
+class ThreadBuffer {
+public:
+  ThreadBuffer(std::uint32_t thread_id, const char* name) : thread_id_{thread_id}, name_{name} {}
+
+  // Hands the buffer of an exited thread to a new one. The events are numbered on instead of from zero, so a reader
+  // still holding the buffer skips the old events rather than mistaking them for new ones.
+  void Reuse(std::uint32_t thread_id, const char* name) {
+    thread_id_.store(thread_id, std::memory_order_relaxed);
+    name_.store(name, std::memory_order_relaxed);
+    first_index_.store(write_count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    exited_.store(false, std::memory_order_relaxed);
+  }
+
+  void Add(const Event& event) {
+    const auto index = write_count_.load(std::memory_order_relaxed);
+    auto& slot = slots_[index % events_per_thread];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.category.store(event.category, std::memory_order_relaxed);
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.timestamp_ns.store(event.timestamp_ns, std::memory_order_relaxed);
+    slot.duration_ns.store(event.duration_ns, std::memory_order_relaxed);
+    slot.id.store(event.id, std::memory_order_relaxed);
+    slot.phase.store(event.phase, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    write_count_.store(index + 1, std::memory_order_release);
+  }
+
+  template <typename Visitor>
+  void ForEach(Visitor&& visitor) const {
+    const auto count = write_count_.load(std::memory_order_acquire);
+    const auto first = std::max(first_index_.load(std::memory_order_relaxed),
+                                count > events_per_thread ? count - events_per_thread : 0);
+    for (auto index = first; index < count; index++) {
+      const auto& slot = slots_[index % events_per_thread];
+      const auto sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != 2 * index + 2) {
+        continue;
+      }
+      const Event event{slot.category.load(std::memory_order_relaxed), slot.name.load(std::memory_order_relaxed),
+                        slot.timestamp_ns.load(std::memory_order_relaxed),
+                        slot.duration_ns.load(std::memory_order_relaxed), slot.id.load(std::memory_order_relaxed),
+                        slot.phase.load(std::memory_order_relaxed)};
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+        visitor(event);
+      }
+    }
+  }
+
+  std::uint64_t GetOverwrittenEvents() const {
+    const auto count = write_count_.load(std::memory_order_relaxed) - first_index_.load(std::memory_order_relaxed);
+    return count > events_per_thread ? count - events_per_thread : 0;
+  }
+
+  std::uint32_t GetThreadId() const { return thread_id_.load(std::memory_order_relaxed); }
+  const char* GetName() const { return name_.load(std::memory_order_relaxed); }
+  void SetName(const char* name) { name_.store(name, std::memory_order_relaxed); }
+  // the owning thread has exited, its last event was added before
+  bool HasExited() const { return exited_.load(std::memory_order_acquire); }
+  void SetExited() { exited_.store(true, std::memory_order_release); }
+
+private:
+  struct Slot {
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<const char*> category{nullptr};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<std::int64_t> timestamp_ns{0};
+    std::atomic<std::int64_t> duration_ns{0};
+    std::atomic<std::uint64_t> id{0};
+    std::atomic<char> phase{0};
+  };
+
+  std::atomic<std::uint32_t> thread_id_;
+  std::atomic<const char*> name_;
+  std::atomic<bool> exited_{false};
+  std::atomic<std::uint64_t> first_index_{0};
+  std::atomic<std::uint64_t> write_count_{0};
+  Slot slots_[events_per_thread];
+};
+
+// Buffers outlive their threads, so events of threads which have already finished are written as well. Once such a
+// buffer has been written it moves to the free list and is reused by the next new thread, so threads started over and
+// over do not each leave a ring behind.
+struct Buffers {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::vector<std::shared_ptr<ThreadBuffer>> free;
+  std::uint32_t last_thread_id = 0;
+  std::uint64_t overwritten_events = 0; // of the buffers moved to the free list
+};
+
+Buffers& GetBuffers() {
+  static Buffers buffers;
+  return buffers;
+}
+
+// Marks the buffer of the thread as exited when the thread ends. Kept apart from thread_buffer, which has no
+// destructor and is therefore accessed without the initialization check of thread_local objects.
+struct ThreadExit {
+  ThreadBuffer* buffer = nullptr;
+  ~ThreadExit() {
+    if (buffer) {
+      buffer->SetExited();
+    }
+  }
+};
+
+thread_local const char* thread_name = nullptr;
+thread_local ThreadBuffer* thread_buffer = nullptr;
+thread_local ThreadExit thread_exit;
+
+ThreadBuffer& GetThreadBuffer() {
+  if (not thread_buffer) {
+    auto& buffers = GetBuffers();
+    std::lock_guard lock(buffers.mutex);
+    const auto thread_id = ++buffers.last_thread_id;
+    if (buffers.free.empty()) {
+      buffers.buffers.push_back(std::make_shared<ThreadBuffer>(thread_id, thread_name));
+    } else {
+      buffers.buffers.push_back(std::move(buffers.free.back()));
+      buffers.free.pop_back();
+      buffers.buffers.back()->Reuse(thread_id, thread_name);
+    }
+    thread_buffer = buffers.buffers.back().get();
+    thread_exit.buffer = thread_buffer;
+  }
+  return *thread_buffer;
+}
+
+// Moves the written buffers of exited threads to the free list.
+void RecycleBuffers(const std::vector<std::shared_ptr<ThreadBuffer>>& written) {
+  auto& all = GetBuffers();
+  std::lock_guard lock(all.mutex);
+  for (const auto& buffer : written) {
+    // a concurrent writer may have recycled it already
+    const auto it = std::find(all.buffers.begin(), all.buffers.end(), buffer);
+    if (it != all.buffers.end()) {
+      all.overwritten_events += buffer->GetOverwrittenEvents();
+      all.free.push_back(std::move(*it));
+      all.buffers.erase(it);
+    }
+  }
+}
+
+std::int64_t ToNanoseconds(Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+void WriteString(std::ostream& output, const char* text) {
+  output << '"';
+  for (const char* c = text ? text : ""; *c; c++) {
+    if (*c == '"' or *c == '\\') {
+      output << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) >= 0x20) {
+      output << *c;
+    }
+  }
+  output << '"';
+}
+
+// trace-event timestamps are in microseconds, the fraction keeps the nanoseconds
+void WriteMicroseconds(std::ostream& output, std::int64_t nanoseconds) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.3f", nanoseconds / 1000.0);
+  output << text;
+}
+
+} // anonymous namespace
+
+void SetEnabled(bool enabled) {
+  detail::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void SetThreadName(const char* name) {
+  thread_name = name;
+  if (thread_buffer) {
+    thread_buffer->SetName(name);
+  }
+}
+
+void RecordComplete(const char* category, const char* name, Clock::time_point start, Clock::time_point end) {
+  if (not IsEnabled()) {
+    return;
+  }
+  GetThreadBuffer().Add({category, name, ToNanoseconds(start), ToNanoseconds(end) - ToNanoseconds(start), 0, 'X'});
+}
+
+void RecordAsync(const char* category, const char* name, std::uint64_t id, Clock::time_point start,
+                 Clock::time_point end) {
+  if (not IsEnabled()) {
+    return;
+  }
+  auto& buffer = GetThreadBuffer();
+  buffer.Add({category, name, ToNanoseconds(start), 0, id, 'b'});
+  buffer.Add({category, name, ToNanoseconds(end), 0, id, 'e'});
+}
+
+void WriteChromeTrace(std::ostream& output) {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    auto& all = GetBuffers();
+    std::lock_guard lock(all.mutex);
+    buffers = all.buffers;
+  }
+  std::vector<std::shared_ptr<ThreadBuffer>> exited;
+  const auto pid = getpid();
+  const char* separator = "\n";
+  output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (const auto& buffer : buffers) {
+    // checked before reading, so all the events of an exited thread are in this trace
+    if (buffer->HasExited()) {
+      exited.push_back(buffer);
+    }
+    if (buffer->GetName()) {
+      output << separator << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+             << ",\"tid\":" << buffer->GetThreadId() << ",\"args\":{\"name\":";
+      WriteString(output, buffer->GetName());
+      output << "}}";
+      separator = ",\n";
+    }
+    buffer->ForEach([&](const Event& event) {
+      output << separator << "{\"ph\":\"" << event.phase << "\",\"cat\":";
+      WriteString(output, event.category);
+      output << ",\"name\":";
+      WriteString(output, event.name);
+      output << ",\"pid\":" << pid << ",\"tid\":" << buffer->GetThreadId() << ",\"ts\":";
+      WriteMicroseconds(output, event.timestamp_ns);
+      if (event.phase == 'X') {
+        output << ",\"dur\":";
+        WriteMicroseconds(output, event.duration_ns);
+      } else {
+        output << ",\"id\":" << event.id;
+      }
+      output << '}';
+      separator = ",\n";
+    });
+  }
+  output << "\n]}\n";
+  RecycleBuffers(exited);
+}
+
+void WriteChromeTrace(const std::string& path) {
+  std::ofstream output(path, std::ios::trunc);
+  WriteChromeTrace(output);
+  output.close();
+  if (not output) {
+    throw std::system_error(errno, std::generic_category(), "writing trace " + path);
+  }
+}
+
+std::uint64_t GetOverwrittenEvents() {
+  auto& all = GetBuffers();
+  std::lock_guard lock(all.mutex);
+  auto overwritten = all.overwritten_events;
+  for (const auto& buffer : all.buffers) {
+    overwritten += buffer->GetOverwrittenEvents();
+  }
+  return overwritten;
+}
+
+std::size_t GetAllocatedThreadBuffers() {
+  auto& all = GetBuffers();
+  std::lock_guard lock(all.mutex);
+  return all.buffers.size() + all.free.size();
+}
+
+} // namespace tpxai::trace
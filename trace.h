@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace tpxai::trace {
+
+// Spans are recorded into per-thread rings of the most recent events and written out as Chrome trace-event JSON,
+// viewable in chrome://tracing or ui.perfetto.dev. Recording is off by default and can be switched at runtime; while
+// off, a span costs a single relaxed load. Names and categories must be string literals (or otherwise outlive the
+// trace), only their pointers are recorded.
+
+namespace detail {
+extern std::atomic<bool> enabled;
+} // namespace detail
+
+inline bool IsEnabled() { return detail::enabled.load(std::memory_order_relaxed); }
+void SetEnabled(bool enabled);
+
+// Names the calling thread in the trace.
+void SetThreadName(const char* name);
+
+using Clock = std::chrono::steady_clock;
+
+void RecordComplete(const char* category, const char* name, Clock::time_point start, Clock::time_point end);
+// An interval which may overlap others on the same thread, shown on a track of its own per category and name.
+void RecordAsync(const char* category, const char* name, std::uint64_t id, Clock::time_point start,
+                 Clock::time_point end);
+
+// Records its lifetime as a complete event, if tracing was enabled when it started.
+class Span {
+public:
+  Span(const char* category, const char* name) : category_{category}, name_{name} {
+    if (IsEnabled()) {
+      start_ = Clock::now();
+      active_ = true;
+    }
+  }
+  ~Span() {
+    if (active_) {
+      RecordComplete(category_, name_, start_, Clock::now());
+    }
+  }
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+private:
+  const char* category_;
+  const char* name_;
+  Clock::time_point start_;
+  bool active_ = false;
+};
+
+// Writes the events currently held by all threads, recording may continue meanwhile. The events of threads which
+// have exited are written once, afterwards their buffers are reused by new threads.
+void WriteChromeTrace(std::ostream& output);
+// Throws std::system_error when the file cannot be written.
+void WriteChromeTrace(const std::string& path);
+
+// Number of events overwritten because a thread recorded more than its ring holds between two writes.
+std::uint64_t GetOverwrittenEvents();
+
+// Number of per-thread rings allocated so far, about 900 KB each.
+std::size_t GetAllocatedThreadBuffers();
+
+} // namespace tpxai::trace